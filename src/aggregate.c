@@ -0,0 +1,519 @@
+/**
+ * @file aggregate.c
+ * @brief Grouped aggregates computed on the raw record data.
+ *
+ * The records are grouped by the raw bytes of their key fields in a hash
+ * table, so keys are neither decoded nor converted to strings for every
+ * record: that happens once per group, when the result is made. The
+ * measures are decoded block by block with `px_decode_column()` and added
+ * to the sums, minimums and maximums of their groups.
+ *
+ * Each thread of a parallel scan fills a table of its own, taken from a pool
+ * with one table per thread when a block is handed to it. The tables are
+ * merged once all blocks are done. Only plain C is used during the scan.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <R.h>
+#include <Rinternals.h>
+#include "paradox.h"
+#include "decode.h"
+#include "parallel.h"
+#include "aggregate.h"
+
+typedef struct {
+  int offset;         // Byte offset of the field within a record.
+  int len;            // Length of the field in bytes.
+  int ftype;          // Paradox field type.
+  int fdc;            // Number of decimal places of the field.
+} px_agg_field_t;
+
+struct px_aggregate {
+  int num_keys;
+  px_agg_field_t* keys;
+  int key_size;       // Sum of the lengths of the key fields.
+  int num_measures;
+  px_agg_field_t* measures;
+  px_agg_op_t* ops;
+  int capacity;       // Maximum number of records of a data block.
+};
+
+struct px_groups {
+  const px_aggregate_t* agg;
+  int num_groups;
+  int capacity;       // Number of groups the arrays below can hold.
+  char* keys;         // The key of each group, `key_size` bytes.
+  unsigned int* hashes;
+  int* counts;        // The number of records of each group.
+  double* values;     // The value of each measure of each group.
+  int* seen;          // The number of non-NA values of each measure of each group.
+  int* table;         // Open addressing hash table of group indices + 1, 0 if empty.
+  int table_size;     // A power of 2.
+  int* rows;          // The group of each record of a block.
+  char* key;          // The key of one record.
+  int* ibuf;          // Scratch buffers for decoded values.
+  double* dbuf;
+};
+
+static const char* op_names[] = {"sum", "min", "max"};
+#define PX_AGG_NUM_OPS 3
+
+static int is_int_type(int ftype) {
+  return ftype == pxfShort || ftype == pxfLong || ftype == pxfAutoInc || ftype == pxfLogical;
+}
+
+static px_agg_field_t agg_field(pxfield_t* fields, int j) {
+  px_agg_field_t f;
+  f.offset = 0;
+  for (int k = 0; k < j; k++) f.offset += fields[k].px_flen;
+  f.len = fields[j].px_flen;
+  f.ftype = fields[j].px_ftype;
+  f.fdc = fields[j].px_fdc;
+  return f;
+}
+
+px_aggregate_t* px_aggregate_new(pxdoc_t* pxdoc, SEXP by_sexp, SEXP ops_sexp, SEXP fields_sexp) {
+  int num_fields = PX_get_num_fields(pxdoc);
+  pxfield_t* fields = PX_get_fields(pxdoc);
+  int recordsize = PX_get_recordsize(pxdoc);
+  if (fields == NULL || recordsize <= 0) {
+    Rf_error("Could not retrieve field definitions from Paradox file.");
+  }
+  if ((!Rf_isNull(by_sexp) && TYPEOF(by_sexp) != INTSXP) || TYPEOF(ops_sexp) != STRSXP ||
+      TYPEOF(fields_sexp) != INTSXP || LENGTH(ops_sexp) != LENGTH(fields_sexp)) {
+    Rf_error("Invalid definition of the aggregate.");
+  }
+
+  px_aggregate_t* agg = (px_aggregate_t*) R_alloc(1, sizeof(px_aggregate_t));
+  agg->num_keys = Rf_isNull(by_sexp) ? 0 : LENGTH(by_sexp);
+  agg->keys = (px_agg_field_t*) R_alloc(agg->num_keys > 0 ? agg->num_keys : 1, sizeof(px_agg_field_t));
+  agg->key_size = 0;
+  for (int k = 0; k < agg->num_keys; k++) {
+    int j = INTEGER(by_sexp)[k];
+    if (j == NA_INTEGER || j < 0 || j >= num_fields) {
+      Rf_error("Column index out of range.");
+    }
+    switch (fields[j].px_ftype) {
+    case pxfAlpha: case pxfShort: case pxfLong: case pxfAutoInc: case pxfLogical: case pxfDate: case pxfTime:
+      break;
+    default:
+      Rf_error("Field '%s' cannot be grouped by.", fields[j].px_fname);
+    }
+    agg->keys[k] = agg_field(fields, j);
+    agg->key_size += agg->keys[k].len;
+  }
+
+  agg->num_measures = LENGTH(fields_sexp);
+  agg->measures = (px_agg_field_t*) R_alloc(agg->num_measures > 0 ? agg->num_measures : 1,
+                                            sizeof(px_agg_field_t));
+  agg->ops = (px_agg_op_t*) R_alloc(agg->num_measures > 0 ? agg->num_measures : 1, sizeof(px_agg_op_t));
+  for (int m = 0; m < agg->num_measures; m++) {
+    int j = INTEGER(fields_sexp)[m];
+    if (j == NA_INTEGER || j < 0 || j >= num_fields) {
+      Rf_error("Column index out of range.");
+    }
+    int op = 0;
+    while (op < PX_AGG_NUM_OPS && strcmp(CHAR(STRING_ELT(ops_sexp, m)), op_names[op]) != 0) op++;
+    if (op == PX_AGG_NUM_OPS) {
+      Rf_error("Unknown aggregate '%s'.", CHAR(STRING_ELT(ops_sexp, m)));
+    }
+    int ftype = fields[j].px_ftype;
+    if (!px_decode_has_kernel(ftype)) {
+      Rf_error("Field '%s' cannot be aggregated.", fields[j].px_fname);
+    }
+    if (op == PX_AGG_SUM && ftype != pxfShort && ftype != pxfLong && ftype != pxfAutoInc &&
+        ftype != pxfNumber && ftype != pxfCurrency && ftype != pxfBCD) {
+      Rf_error("Field '%s' cannot be summed.", fields[j].px_fname);
+    }
+    agg->measures[m] = agg_field(fields, j);
+    agg->ops[m] = (px_agg_op_t) op;
+  }
+  // No data block holds more records than fit into it.
+  agg->capacity = pxdoc->px_head->px_maxtablesize * 0x400 / recordsize + 1;
+  return agg;
+}
+
+int px_aggregate_key_size(const px_aggregate_t* agg) {
+  return agg->key_size;
+}
+
+double px_aggregate_empty_value(const px_aggregate_t* agg, int m) {
+  return agg->ops[m] == PX_AGG_SUM ? 0.0 : NA_REAL;
+}
+
+void px_groups_free(px_groups_t* groups) {
+  if (groups == NULL) return;
+  free(groups->keys);
+  free(groups->hashes);
+  free(groups->counts);
+  free(groups->values);
+  free(groups->seen);
+  free(groups->table);
+  free(groups->rows);
+  free(groups->key);
+  free(groups->ibuf);
+  free(groups->dbuf);
+  free(groups);
+}
+
+static px_groups_t* groups_new(const px_aggregate_t* agg) {
+  px_groups_t* groups = (px_groups_t*) calloc(1, sizeof(px_groups_t));
+  if (groups == NULL) return NULL;
+  groups->agg = agg;
+  groups->table_size = 64;
+  groups->table = (int*) calloc((size_t) groups->table_size, sizeof(int));
+  groups->rows = (int*) malloc((size_t) agg->capacity * sizeof(int));
+  groups->key = (char*) malloc((size_t) agg->key_size + 1);
+  groups->ibuf = (int*) malloc((size_t) agg->capacity * sizeof(int));
+  groups->dbuf = (double*) malloc((size_t) agg->capacity * sizeof(double));
+  if (groups->table == NULL || groups->rows == NULL || groups->key == NULL || groups->ibuf == NULL ||
+      groups->dbuf == NULL) {
+    px_groups_free(groups);
+    return NULL;
+  }
+  return groups;
+}
+
+/**
+ * @brief Makes room for one more group.
+ * @return 0 on success, -1 if no memory could be allocated.
+ */
+static int groups_reserve(px_groups_t* groups) {
+  const px_aggregate_t* agg = groups->agg;
+  if (groups->num_groups < groups->capacity) return 0;
+  int capacity = groups->capacity > 0 ? 2 * groups->capacity : 64;
+  size_t nm = (size_t) (agg->num_measures > 0 ? agg->num_measures : 1);
+  char* keys = (char*) realloc(groups->keys, (size_t) capacity * (size_t) (agg->key_size > 0 ? agg->key_size : 1));
+  if (keys == NULL) return -1;
+  groups->keys = keys;
+  unsigned int* hashes = (unsigned int*) realloc(groups->hashes, (size_t) capacity * sizeof(unsigned int));
+  if (hashes == NULL) return -1;
+  groups->hashes = hashes;
+  int* counts = (int*) realloc(groups->counts, (size_t) capacity * sizeof(int));
+  if (counts == NULL) return -1;
+  groups->counts = counts;
+  double* values = (double*) realloc(groups->values, (size_t) capacity * nm * sizeof(double));
+  if (values == NULL) return -1;
+  groups->values = values;
+  int* seen = (int*) realloc(groups->seen, (size_t) capacity * nm * sizeof(int));
+  if (seen == NULL) return -1;
+  groups->seen = seen;
+  groups->capacity = capacity;
+  return 0;
+}
+
+/**
+ * @brief Doubles the hash table, see `find_group()`.
+ * @return 0 on success, -1 if no memory could be allocated.
+ */
+static int groups_rehash(px_groups_t* groups) {
+  int size = 2 * groups->table_size;
+  int* table = (int*) calloc((size_t) size, sizeof(int));
+  if (table == NULL) return -1;
+  for (int g = 0; g < groups->num_groups; g++) {
+    unsigned int slot = groups->hashes[g] & (unsigned int) (size - 1);
+    while (table[slot] != 0) slot = (slot + 1) & (unsigned int) (size - 1);
+    table[slot] = g + 1;
+  }
+  free(groups->table);
+  groups->table = table;
+  groups->table_size = size;
+  return 0;
+}
+
+static unsigned int hash_key(const char* key, int len) {
+  // FNV-1a
+  unsigned int hash = 2166136261u;
+  for (int i = 0; i < len; i++) {
+    hash = (hash ^ (unsigned char) key[i]) * 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * @brief Returns the group of a key, adding a new group with empty measures
+ *   if there is none yet.
+ * @return The index of the group, or -1 if no memory could be allocated.
+ */
+static int find_group(px_groups_t* groups, const char* key) {
+  const px_aggregate_t* agg = groups->agg;
+  size_t key_size = (size_t) agg->key_size;
+  unsigned int hash = hash_key(key, agg->key_size);
+  unsigned int mask = (unsigned int) (groups->table_size - 1);
+  unsigned int slot = hash & mask;
+  while (groups->table[slot] != 0) {
+    int g = groups->table[slot] - 1;
+    if (groups->hashes[g] == hash && memcmp(groups->keys + (size_t) g * key_size, key, key_size) == 0) {
+      return g;
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  if (groups_reserve(groups) != 0) return -1;
+  int g = groups->num_groups++;
+  memcpy(groups->keys + (size_t) g * key_size, key, key_size);
+  groups->hashes[g] = hash;
+  groups->counts[g] = 0;
+  for (int m = 0; m < agg->num_measures; m++) {
+    groups->values[(size_t) g * agg->num_measures + m] = 0;
+    groups->seen[(size_t) g * agg->num_measures + m] = 0;
+  }
+  groups->table[slot] = g + 1;
+  // The table is kept at most half full.
+  if (2 * groups->num_groups > groups->table_size && groups_rehash(groups) != 0) return -1;
+  return g;
+}
+
+/**
+ * @brief Adds a value to a measure of a group, `seen` values having been
+ *   added before.
+ */
+static inline void add_value(px_agg_op_t op, double* value, int* seen, double x, int count) {
+  if (*seen == 0) {
+    *value = x;
+  } else if (op == PX_AGG_SUM) {
+    *value += x;
+  } else if (op == PX_AGG_MIN ? x < *value : x > *value) {
+    *value = x;
+  }
+  *seen += count;
+}
+
+/**
+ * @brief Adds at most `agg->capacity` records to their groups, see `groups_add()`.
+ */
+static int add_records(px_groups_t* groups, const char* records, int n, size_t recordsize,
+                       const unsigned char* keep) {
+  const px_aggregate_t* agg = groups->agg;
+  for (int r = 0; r < n; r++) {
+    groups->rows[r] = -1;
+    if (keep != NULL && !keep[r]) continue;
+    const char* record = records + (size_t) r * recordsize;
+    char* key = groups->key;
+    for (int k = 0; k < agg->num_keys; k++) {
+      const px_agg_field_t* f = &agg->keys[k];
+      memcpy(key, record + f->offset, (size_t) f->len);
+      if (f->ftype == pxfAlpha) {
+        // The text ends at the first zero byte, whatever follows it.
+        char* end = memchr(key, '\0', (size_t) f->len);
+        if (end != NULL) memset(end, 0, (size_t) (key + f->len - end));
+      }
+      key += f->len;
+    }
+    int g = find_group(groups, groups->key);
+    if (g < 0) return -1;
+    groups->rows[r] = g;
+    groups->counts[g]++;
+  }
+
+  for (int m = 0; m < agg->num_measures; m++) {
+    const px_agg_field_t* f = &agg->measures[m];
+    px_agg_op_t op = agg->ops[m];
+    size_t nm = (size_t) agg->num_measures;
+    if (is_int_type(f->ftype)) {
+      px_decode_column(f->ftype, f->fdc, records + f->offset, recordsize, n, groups->ibuf);
+      for (int r = 0; r < n; r++) {
+        int g = groups->rows[r];
+        if (g < 0 || groups->ibuf[r] == NA_INTEGER) continue;
+        add_value(op, &groups->values[g * nm + m], &groups->seen[g * nm + m], (double) groups->ibuf[r], 1);
+      }
+    } else {
+      px_decode_column(f->ftype, f->fdc, records + f->offset, recordsize, n, groups->dbuf);
+      for (int r = 0; r < n; r++) {
+        int g = groups->rows[r];
+        if (g < 0 || ISNAN(groups->dbuf[r])) continue;
+        add_value(op, &groups->values[g * nm + m], &groups->seen[g * nm + m], groups->dbuf[r], 1);
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Adds consecutive records to their groups.
+ *
+ * @param groups The groups.
+ * @param records Raw data of `n` records, `recordsize` bytes apart.
+ * @param n The number of records.
+ * @param recordsize The size of a record in bytes.
+ * @param keep NULL, or 1 for each record to add and 0 for those to skip.
+ * @return 0 on success, -1 if no memory could be allocated.
+ */
+static int groups_add(px_groups_t* groups, const char* records, int n, size_t recordsize,
+                         const unsigned char* keep) {
+  int capacity = groups->agg->capacity;
+  for (int first = 0; first < n; first += capacity) {
+    int count = n - first < capacity ? n - first : capacity;
+    if (add_records(groups, records + (size_t) first * recordsize, count, recordsize,
+                    keep != NULL ? keep + first : NULL) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Adds the groups of `from` to those of `into`.
+ * @return 0 on success, -1 if no memory could be allocated.
+ */
+static int groups_merge(px_groups_t* into, const px_groups_t* from) {
+  const px_aggregate_t* agg = into->agg;
+  size_t nm = (size_t) agg->num_measures;
+  for (int h = 0; h < from->num_groups; h++) {
+    int g = find_group(into, from->keys + (size_t) h * (size_t) agg->key_size);
+    if (g < 0) return -1;
+    into->counts[g] += from->counts[h];
+    for (int m = 0; m < agg->num_measures; m++) {
+      int seen = from->seen[h * nm + m];
+      if (seen > 0) {
+        add_value(agg->ops[m], &into->values[g * nm + m], &into->seen[g * nm + m], from->values[h * nm + m], seen);
+      }
+    }
+  }
+  return 0;
+}
+
+// A table of groups and the filter of one thread.
+typedef struct {
+  px_groups_t* groups;
+  px_filter_t* filter;         // NULL if there is no filter.
+  unsigned char* keep;         // Filter result of the records of one block.
+  int busy;                    // Whether a thread is using the slot.
+  int num_scanned;
+} px_agg_slot_t;
+
+typedef struct {
+  px_agg_slot_t* slots;
+  int num_slots;
+  size_t recordsize;
+  pthread_mutex_t lock;
+} px_agg_scan_t;
+
+/**
+ * @brief Callback for `px_scan_parallel()` that adds the records of a block
+ *   to the groups of a free slot.
+ *
+ * No more callbacks run at the same time than there are threads, so there
+ * is always a free slot.
+ *
+ * @return 0 to continue the scan, -1 if no memory could be allocated.
+ */
+static int aggregate_block_cb(pxdoc_t* pxdoc, int recno, char* records, int numrecords, void* user_data) {
+  px_agg_scan_t* scan = (px_agg_scan_t*) user_data;
+  px_agg_slot_t* slot = NULL;
+  pthread_mutex_lock(&scan->lock);
+  for (int s = 0; s < scan->num_slots && slot == NULL; s++) {
+    if (!scan->slots[s].busy) {
+      slot = &scan->slots[s];
+      slot->busy = 1;
+    }
+  }
+  pthread_mutex_unlock(&scan->lock);
+  if (slot == NULL) return -1;
+
+  int ret = 0;
+  slot->num_scanned += numrecords;
+  if (slot->filter == NULL) {
+    ret = groups_add(slot->groups, records, numrecords, scan->recordsize, NULL);
+  } else if (numrecords > slot->groups->agg->capacity) {
+    ret = -1;
+  } else if (px_filter_block(slot->filter, records, numrecords, scan->recordsize, slot->keep) > 0) {
+    ret = groups_add(slot->groups, records, numrecords, scan->recordsize, slot->keep);
+  }
+
+  pthread_mutex_lock(&scan->lock);
+  slot->busy = 0;
+  pthread_mutex_unlock(&scan->lock);
+  return ret;
+}
+
+px_groups_t* px_aggregate_scan(pxdoc_t* pxdoc, const px_aggregate_t* agg, pxscanpos_t* pos, int num_threads,
+                               px_filter_t** filters, int* num_scanned) {
+  px_agg_scan_t scan;
+  scan.num_slots = num_threads > 1 ? num_threads : 1;
+  scan.recordsize = (size_t) PX_get_recordsize(pxdoc);
+  scan.slots = (px_agg_slot_t*) calloc((size_t) scan.num_slots, sizeof(px_agg_slot_t));
+  int ret = scan.slots == NULL ? -1 : 0;
+  for (int s = 0; s < scan.num_slots && ret == 0; s++) {
+    px_agg_slot_t* slot = &scan.slots[s];
+    slot->groups = groups_new(agg);
+    slot->filter = filters != NULL ? filters[s] : NULL;
+    slot->keep = (unsigned char*) malloc((size_t) agg->capacity);
+    if (slot->groups == NULL || slot->keep == NULL) ret = -1;
+  }
+
+  if (ret == 0) {
+    pthread_mutex_init(&scan.lock, NULL);
+    ret = px_scan_parallel(pxdoc, pos, -1, num_threads, aggregate_block_cb, &scan);
+    pthread_mutex_destroy(&scan.lock);
+  }
+
+  // The tables of the other threads are merged into the first one.
+  px_groups_t* groups = NULL;
+  *num_scanned = 0;
+  if (scan.slots != NULL) {
+    for (int s = 0; s < scan.num_slots; s++) {
+      *num_scanned += scan.slots[s].num_scanned;
+      if (ret == 0 && s > 0) ret = groups_merge(scan.slots[0].groups, scan.slots[s].groups);
+    }
+    if (ret == 0) {
+      groups = scan.slots[0].groups;
+      scan.slots[0].groups = NULL;
+    }
+    for (int s = 0; s < scan.num_slots; s++) {
+      px_groups_free(scan.slots[s].groups);
+      free(scan.slots[s].keep);
+    }
+    free(scan.slots);
+  }
+  return groups;
+}
+
+int px_groups_size(const px_groups_t* groups) {
+  return groups->num_groups;
+}
+
+typedef struct {
+  const char* key;
+  int len;
+  int g;
+} px_group_key_t;
+
+static int compare_group_keys(const void* a, const void* b) {
+  const px_group_key_t* x = (const px_group_key_t*) a;
+  const px_group_key_t* y = (const px_group_key_t*) b;
+  int c = memcmp(x->key, y->key, (size_t) x->len);
+  return c != 0 ? c : (x->g > y->g) - (x->g < y->g);
+}
+
+int* px_groups_order(const px_groups_t* groups) {
+  int n = groups->num_groups;
+  size_t key_size = (size_t) groups->agg->key_size;
+  px_group_key_t* keys = (px_group_key_t*) R_alloc(n > 0 ? n : 1, sizeof(px_group_key_t));
+  for (int g = 0; g < n; g++) {
+    keys[g].key = groups->keys + (size_t) g * key_size;
+    keys[g].len = (int) key_size;
+    keys[g].g = g;
+  }
+  qsort(keys, (size_t) n, sizeof(px_group_key_t), compare_group_keys);
+  int* order = (int*) R_alloc(n > 0 ? n : 1, sizeof(int));
+  for (int i = 0; i < n; i++) {
+    order[i] = keys[i].g;
+  }
+  return order;
+}
+
+const char* px_groups_key(const px_groups_t* groups, int g) {
+  return groups->keys + (size_t) g * (size_t) groups->agg->key_size;
+}
+
+int px_groups_count(const px_groups_t* groups, int g) {
+  return groups->counts[g];
+}
+
+double px_groups_value(const px_groups_t* groups, int g, int m) {
+  size_t i = (size_t) g * (size_t) groups->agg->num_measures + (size_t) m;
+  return groups->seen[i] > 0 ? groups->values[i] : px_aggregate_empty_value(groups->agg, m);
+}
@@ -0,0 +1,118 @@
+/**
+ * @file aggregate.h
+ * @brief Grouped aggregates computed on the raw record data.
+ */
+
+#ifndef RPARADOX_AGGREGATE_H
+#define RPARADOX_AGGREGATE_H
+
+#include <stddef.h>
+#include <Rinternals.h>
+#include "paradox.h"
+#include "filter.h"
+
+typedef enum {
+  PX_AGG_SUM, PX_AGG_MIN, PX_AGG_MAX
+} px_agg_op_t;
+
+typedef struct px_aggregate px_aggregate_t;
+typedef struct px_groups px_groups_t;
+
+/**
+ * @brief Creates the definition of an aggregate from the arguments of
+ *   `pxlib_aggregate()`.
+ *
+ * Records are grouped by the raw bytes of the `by` fields, which may be
+ * Alpha, Short, Long, Autoincrement, Logical, Date or Time fields. Alpha
+ * keys end at their first zero byte. Each measure applies `"sum"` (Short,
+ * Long, Autoincrement, Number, Currency and BCD fields), `"min"` or `"max"`
+ * (all fields with a column decode kernel) to a field. Raises an R error for
+ * invalid fields.
+ *
+ * The definition is allocated with `R_alloc()`.
+ *
+ * @param pxdoc The open Paradox document.
+ * @param by_sexp `NULL`, or an integer vector of 0-based field indices.
+ * @param ops_sexp A character vector with the operator of each measure.
+ * @param fields_sexp An integer vector with the 0-based field of each measure.
+ * @return The new definition.
+ */
+px_aggregate_t* px_aggregate_new(pxdoc_t* pxdoc, SEXP by_sexp, SEXP ops_sexp, SEXP fields_sexp);
+
+/**
+ * @brief Returns the number of bytes of the key of a group, the sum of the
+ *   lengths of the `by` fields.
+ */
+int px_aggregate_key_size(const px_aggregate_t* agg);
+
+/**
+ * @brief Returns the value of a measure over no values: 0 for a sum, like
+ *   `sum()` in R, and `NA_REAL` for a minimum or maximum.
+ */
+double px_aggregate_empty_value(const px_aggregate_t* agg, int m);
+
+/**
+ * @brief Aggregates records block by block with several threads.
+ *
+ * The blocks are read like with `px_scan_parallel()`. Every thread adds the
+ * records it reads, or those of them passing its filter, to a table of
+ * groups of its own, and the tables are merged at the end. The memory used
+ * grows with the number of groups, not with the number of records.
+ *
+ * @param pxdoc The open Paradox document.
+ * @param agg The definition of the aggregate.
+ * @param pos The scan position to start at. It is advanced behind the last record.
+ * @param num_threads The number of threads to use.
+ * @param filters NULL, or `num_threads` distinct copies of the same filter,
+ *   see `px_filter_clone()`.
+ * @param num_scanned Receives the number of records scanned.
+ * @return The groups, to be released with `px_groups_free()`, or NULL if the
+ *   scan failed or no memory could be allocated.
+ */
+px_groups_t* px_aggregate_scan(pxdoc_t* pxdoc, const px_aggregate_t* agg, pxscanpos_t* pos, int num_threads,
+                               px_filter_t** filters, int* num_scanned);
+
+/**
+ * @brief Releases the groups of `px_aggregate_scan()`.
+ */
+void px_groups_free(px_groups_t* groups);
+
+/**
+ * @brief Returns the number of groups.
+ */
+int px_groups_size(const px_groups_t* groups);
+
+/**
+ * @brief Returns the groups in the order of their keys, compared byte by
+ *   byte, as an `R_alloc`'ed array of group indices.
+ *
+ * Raw keys sort like the values of numbers, dates and times (see
+ * `PX_plan_key_range()`), `NA` first, and like the bytes of the text in the
+ * encoding of the file for Alpha fields.
+ */
+int* px_groups_order(const px_groups_t* groups);
+
+/**
+ * @brief Returns the key of a group, `px_aggregate_key_size()` bytes with the
+ *   `by` fields in order.
+ */
+const char* px_groups_key(const px_groups_t* groups, int g);
+
+/**
+ * @brief Returns the number of records of a group.
+ */
+int px_groups_count(const px_groups_t* groups, int g);
+
+/**
+ * @brief Returns the value of a measure of a group.
+ *
+ * `NA` values of the field are ignored. If a group has no other values, the
+ * result is that of `px_aggregate_empty_value()`.
+ *
+ * @param groups The groups.
+ * @param g The index of the group.
+ * @param m The index of the measure.
+ */
+double px_groups_value(const px_groups_t* groups, int g, int m);
+
+#endif /* RPARADOX_AGGREGATE_H */
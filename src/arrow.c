@@ -0,0 +1,493 @@
+/**
+ * @file arrow.c
+ * @brief Export of Paradox records as Arrow record batches.
+ *
+ * The records of a block scan are written straight into the buffers of the
+ * Arrow columnar format: a validity bitmap per column, fixed-width values,
+ * and an offset buffer with the concatenated bytes for text and binary
+ * columns. The batch is handed to a consumer such as the 'arrow' package
+ * through the structures of the Arrow C data interface, which take over the
+ * buffers, so no R vector or CHARSXP is created for the values at all.
+ *
+ * Fixed-width fields are decoded with the column kernels of decode.c and
+ * mapped to their Arrow representation, so the values and NULLs are exactly
+ * those of `pxlib_get_data()`.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <R.h>
+#include <Rinternals.h>
+#include "paradox.h"
+#include "px_encode.h"
+#include "decode.h"
+#include "arrow.h"
+
+// Layout of a column in the Arrow columnar format.
+enum {
+  PX_ARROW_FIXED,  // Validity bitmap and fixed-width values.
+  PX_ARROW_BOOL,   // Validity bitmap and a bitmap of the values.
+  PX_ARROW_VARLEN  // Validity bitmap, int32 offsets and the bytes of the values.
+};
+
+typedef struct {
+  pxfield_t field;        // Definition of the field.
+  int offset;             // Byte offset of the field within a record.
+  int layout;             // One of the PX_ARROW_* layouts.
+  int kernel;             // Whether the field is decoded with px_decode_column().
+  const char* format;     // Arrow format string of the column.
+  size_t elt_size;        // Size of a fixed-width value.
+  int64_t null_count;
+  uint8_t* validity;      // Bit i is set if value i is not NULL.
+  void* values;           // Fixed-width values or the bitmap of the booleans.
+  int32_t* value_offsets; // Variable-length columns: start of value i in `data`.
+  char* data;             // Variable-length columns: the bytes of all values.
+  size_t data_size;
+  size_t data_capacity;
+} px_arrow_column_t;
+
+struct px_arrow_batch {
+  pxdoc_t* pxdoc;
+  px_arrow_column_t* columns;
+  int num_columns;
+  int capacity;           // Maximum number of records.
+  int length;             // Number of records appended so far.
+  void* scratch;          // Output of the decode kernels for one block.
+  int scratch_records;    // Number of records `scratch` can hold.
+};
+
+// The blank BCD value of which PX_get_data_bcd() makes question marks.
+static const char bcd_blank[] = "-??????????????????????????.??????";
+
+static inline void set_bit(uint8_t* bits, int i) {
+  bits[i >> 3] |= (uint8_t) (1u << (i & 7));
+}
+
+/**
+ * @brief Chooses the Arrow type and layout of a column.
+ */
+static void init_column(px_arrow_column_t* col, int bcd_text) {
+  col->kernel = px_decode_has_kernel(col->field.px_ftype) && !(bcd_text && col->field.px_ftype == pxfBCD);
+  col->layout = PX_ARROW_FIXED;
+  switch (col->field.px_ftype) {
+  case pxfShort:
+    col->format = "s"; col->elt_size = sizeof(int16_t); break;
+  case pxfLong: case pxfAutoInc:
+    col->format = "i"; col->elt_size = sizeof(int32_t); break;
+  case pxfLogical:
+    col->format = "b"; col->layout = PX_ARROW_BOOL; break;
+  case pxfNumber: case pxfCurrency:
+    col->format = "g"; col->elt_size = sizeof(double); break;
+  case pxfDate:
+    col->format = "tdD"; col->elt_size = sizeof(int32_t); break;
+  case pxfTime:
+    col->format = "ttm"; col->elt_size = sizeof(int32_t); break;
+  case pxfTimestamp:
+    col->format = "tsm:UTC"; col->elt_size = sizeof(int64_t); break;
+  case pxfBCD:
+    if (col->kernel) {
+      col->format = "g"; col->elt_size = sizeof(double);
+    } else {
+      col->format = "u"; col->layout = PX_ARROW_VARLEN;
+    }
+    break;
+  case pxfBytes: case pxfBLOb: case pxfOLE: case pxfGraphic:
+    col->format = "z"; col->layout = PX_ARROW_VARLEN; break;
+  // Text, and unknown types, which are all NULL like in pxlib_get_data().
+  case pxfAlpha: case pxfMemoBLOb: case pxfFmtMemoBLOb: default:
+    col->format = "u"; col->layout = PX_ARROW_VARLEN; break;
+  }
+}
+
+px_arrow_batch_t* px_arrow_batch_new(pxdoc_t* pxdoc, const pxfield_t* fields, const int* offsets,
+                                     int num_fields, int capacity, int bcd_text) {
+  px_arrow_batch_t* batch = (px_arrow_batch_t*) calloc(1, sizeof(px_arrow_batch_t));
+  if (batch == NULL) return NULL;
+  batch->pxdoc = pxdoc;
+  batch->capacity = capacity;
+  batch->num_columns = num_fields;
+  batch->columns = (px_arrow_column_t*) calloc(num_fields > 0 ? num_fields : 1, sizeof(px_arrow_column_t));
+  if (batch->columns == NULL) {
+    free(batch);
+    return NULL;
+  }
+
+  size_t bitmap_size = ((size_t) capacity + 7) / 8 + 1;
+  for (int j = 0; j < num_fields; j++) {
+    px_arrow_column_t* col = &batch->columns[j];
+    col->field = fields[j];
+    col->offset = offsets[j];
+    init_column(col, bcd_text);
+    col->validity = (uint8_t*) calloc(bitmap_size, 1);
+    switch (col->layout) {
+    case PX_ARROW_FIXED:
+      col->values = malloc(((size_t) capacity + 1) * col->elt_size);
+      break;
+    case PX_ARROW_BOOL:
+      col->values = calloc(bitmap_size, 1);
+      break;
+    default:
+      col->value_offsets = (int32_t*) malloc(((size_t) capacity + 1) * sizeof(int32_t));
+      if (col->value_offsets != NULL) col->value_offsets[0] = 0;
+      col->values = col->value_offsets;
+      break;
+    }
+    if (col->validity == NULL || col->values == NULL) {
+      px_arrow_batch_free(batch);
+      return NULL;
+    }
+  }
+  return batch;
+}
+
+void px_arrow_batch_free(px_arrow_batch_t* batch) {
+  if (batch == NULL) return;
+  for (int j = 0; j < batch->num_columns; j++) {
+    px_arrow_column_t* col = &batch->columns[j];
+    free(col->validity);
+    free(col->values);
+    free(col->data);
+  }
+  free(batch->columns);
+  free(batch->scratch);
+  free(batch);
+}
+
+int px_arrow_batch_length(const px_arrow_batch_t* batch) {
+  return batch->length;
+}
+
+/**
+ * @brief Makes room for `extra` more bytes of variable-length data.
+ *
+ * @return 0 on success, -1 if no memory could be allocated or the column
+ *   would exceed the int32 offsets of the Arrow `utf8` and `binary` types.
+ */
+static int reserve_data(px_arrow_column_t* col, size_t extra) {
+  if (extra > (size_t) INT32_MAX - col->data_size) return -1;
+  size_t needed = col->data_size + extra;
+  if (needed <= col->data_capacity) return 0;
+  size_t capacity = col->data_capacity > 0 ? col->data_capacity : 4096;
+  while (capacity < needed) capacity *= 2;
+  if (capacity > (size_t) INT32_MAX) capacity = (size_t) INT32_MAX;
+  char* data = (char*) realloc(col->data, capacity);
+  if (data == NULL) return -1;
+  col->data = data;
+  col->data_capacity = capacity;
+  return 0;
+}
+
+/**
+ * @brief Ends value `row` of a variable-length column, whose bytes have been
+ *   appended, or marks it as NULL if `valid` is zero.
+ */
+static void end_value(px_arrow_column_t* col, int row, int valid) {
+  if (valid) {
+    set_bit(col->validity, row);
+  } else {
+    col->null_count++;
+  }
+  col->value_offsets[row + 1] = (int32_t) col->data_size;
+}
+
+/**
+ * @brief Appends raw bytes to a variable-length column.
+ */
+static int append_bytes(px_arrow_column_t* col, const char* bytes, size_t len) {
+  if (reserve_data(col, len) != 0) return -1;
+  if (len > 0) memcpy(col->data + col->data_size, bytes, len);
+  col->data_size += len;
+  return 0;
+}
+
+/**
+ * @brief Appends text to a variable-length column, converted to the target
+ *   encoding of the document like `px_decode_text()` does.
+ */
+static int append_text(pxdoc_t* pxdoc, px_arrow_column_t* col, const char* text, size_t len) {
+  if (pxdoc->out_iconvcd == (Riconv_t) -1) {
+    return append_bytes(col, text, len);
+  }
+  if (len > (size_t) INT32_MAX / 4 || reserve_data(col, 4 * len) != 0) return -1;
+  col->data_size += px_recode_target(pxdoc, text, len, col->data + col->data_size, 4 * len);
+  return 0;
+}
+
+/**
+ * @brief Converts the decoded values of a block, in their R representation,
+ *   to the Arrow representation of the column.
+ */
+static void store_kernel_values(px_arrow_column_t* col, const void* scratch, int row, int n) {
+  const int* ivals = (const int*) scratch;
+  const double* dvals = (const double*) scratch;
+  for (int i = 0; i < n; i++) {
+    int valid;
+    int k = row + i;
+    switch (col->field.px_ftype) {
+    case pxfShort:
+      valid = ivals[i] != NA_INTEGER;
+      ((int16_t*) col->values)[k] = valid ? (int16_t) ivals[i] : 0;
+      break;
+    case pxfLong: case pxfAutoInc:
+      valid = ivals[i] != NA_INTEGER;
+      ((int32_t*) col->values)[k] = valid ? (int32_t) ivals[i] : 0;
+      break;
+    case pxfLogical:
+      valid = ivals[i] != NA_LOGICAL;
+      if (valid && ivals[i]) set_bit((uint8_t*) col->values, k);
+      break;
+    case pxfDate:
+      // Days since 1970-01-01, as for R dates.
+      valid = !R_IsNA(dvals[i]);
+      ((int32_t*) col->values)[k] = valid ? (int32_t) dvals[i] : 0;
+      break;
+    case pxfTime:
+      // The kernel gives seconds, time32[ms] takes the milliseconds of the file.
+      valid = !R_IsNA(dvals[i]);
+      ((int32_t*) col->values)[k] = valid ? (int32_t) llround(dvals[i] * 1000.0) : 0;
+      break;
+    case pxfTimestamp:
+      valid = !R_IsNA(dvals[i]);
+      ((int64_t*) col->values)[k] = valid ? (int64_t) llround(dvals[i] * 1000.0) : 0;
+      break;
+    default:
+      // Number, Currency and BCD.
+      valid = !R_IsNA(dvals[i]);
+      ((double*) col->values)[k] = valid ? dvals[i] : 0.0;
+      break;
+    }
+    if (valid) {
+      set_bit(col->validity, k);
+    } else {
+      col->null_count++;
+    }
+  }
+}
+
+/**
+ * @brief Appends one field without a column kernel to its column.
+ *
+ * Text is taken from the record like in `px_decode_alpha()`, everything else
+ * is read with `PX_convert_field()` and mapped like in `px_to_sexp()`.
+ *
+ * @return 0 on success, -1 if the value could not be stored.
+ */
+static int append_generic_value(pxdoc_t* pxdoc, px_arrow_column_t* col, int row, char* data) {
+  int ret = 0;
+  int valid = 0;
+
+  if (col->field.px_ftype == pxfAlpha) {
+    // A NULL value starts with a zero byte, the text ends at the first one.
+    if (data[0] != '\0') {
+      const char* end = memchr(data, '\0', (size_t) col->field.px_flen);
+      size_t len = end ? (size_t) (end - data) : (size_t) col->field.px_flen;
+      ret = append_text(pxdoc, col, data, len);
+      valid = 1;
+    }
+    end_value(col, row, valid);
+    return ret;
+  }
+
+  switch (col->field.px_ftype) {
+  case pxfBCD: case pxfMemoBLOb: case pxfFmtMemoBLOb: case pxfBytes:
+  case pxfBLOb: case pxfOLE: case pxfGraphic:
+    break;
+  default:
+    end_value(col, row, 0);
+    return 0;
+  }
+
+  // The value is copied into the column right away, so the arena can be
+  // reset for every one.
+  PX_arena_begin(pxdoc);
+  pxval_t val;
+  memset(&val, 0, sizeof(val));
+  PX_convert_field(pxdoc, &col->field, data, &val);
+  if (val.isnull) {
+    end_value(col, row, 0);
+    return 0;
+  }
+  char* str = val.value.str.val;
+  size_t len = str ? (size_t) val.value.str.len : 0;
+  switch (col->field.px_ftype) {
+  case pxfBCD:
+    valid = str != NULL && strcmp(str, bcd_blank) != 0;
+    if (valid) ret = append_bytes(col, str, strlen(str));
+    break;
+  case pxfMemoBLOb: case pxfFmtMemoBLOb:
+    valid = str != NULL;
+    if (valid) ret = append_text(pxdoc, col, str, len);
+    break;
+  case pxfBytes:
+    valid = str != NULL;
+    if (valid) ret = append_bytes(col, str, len);
+    break;
+  default:
+    // BLOb, OLE and Graphic: an empty BLOB is NULL.
+    valid = len > 0;
+    if (valid) ret = append_bytes(col, str, len);
+    break;
+  }
+  if (str != NULL) PX_arena_free(pxdoc, str);
+  end_value(col, row, valid);
+  return ret;
+}
+
+int px_arrow_block_cb(pxdoc_t* pxdoc, int recno, char* records, int numrecords, void* user_data) {
+  px_arrow_batch_t* batch = (px_arrow_batch_t*) user_data;
+  size_t recordsize = (size_t) PX_get_recordsize(pxdoc);
+  int row = batch->length;
+  (void) recno;
+  if (numrecords > batch->capacity - row) return -1;
+
+  if (numrecords > batch->scratch_records) {
+    void* scratch = realloc(batch->scratch, (size_t) numrecords * sizeof(double));
+    if (scratch == NULL) return -1;
+    batch->scratch = scratch;
+    batch->scratch_records = numrecords;
+  }
+
+  for (int j = 0; j < batch->num_columns; j++) {
+    px_arrow_column_t* col = &batch->columns[j];
+    if (col->kernel) {
+      // Fixed-width fields: one tight loop per column over the whole block.
+      px_decode_column(col->field.px_ftype, col->field.px_fdc, records + col->offset, recordsize,
+                       numrecords, batch->scratch);
+      store_kernel_values(col, batch->scratch, row, numrecords);
+      continue;
+    }
+    for (int r = 0; r < numrecords; r++) {
+      if (append_generic_value(pxdoc, col, row + r, records + (size_t) r * recordsize + col->offset) != 0) {
+        PX_arena_end(pxdoc);
+        return -1;
+      }
+    }
+  }
+  PX_arena_end(pxdoc);
+  batch->length += numrecords;
+  return 0;
+}
+
+/**
+ * @brief Copies a string with `malloc()`, the consumer may keep it longer than R does.
+ */
+static char* copy_string(const char* s) {
+  size_t len = strlen(s) + 1;
+  char* copy = (char*) malloc(len);
+  if (copy != NULL) memcpy(copy, s, len);
+  return copy;
+}
+
+// --- Release callbacks of the exported structures ---
+
+static void release_column_schema(struct ArrowSchema* schema) {
+  free((char*) schema->name);
+  schema->release = NULL;
+}
+
+static void release_batch_schema(struct ArrowSchema* schema) {
+  for (int64_t j = 0; j < schema->n_children; j++) {
+    struct ArrowSchema* child = schema->children[j];
+    if (child == NULL) continue;
+    if (child->release != NULL) child->release(child);
+    free(child);
+  }
+  free(schema->children);
+  schema->release = NULL;
+}
+
+static void release_column_array(struct ArrowArray* array) {
+  for (int64_t k = 0; k < array->n_buffers; k++) {
+    free((void*) array->buffers[k]);
+  }
+  free(array->buffers);
+  array->release = NULL;
+}
+
+static void release_batch_array(struct ArrowArray* array) {
+  // A consumer may have moved children out, which leaves them released.
+  for (int64_t j = 0; j < array->n_children; j++) {
+    struct ArrowArray* child = array->children[j];
+    if (child == NULL) continue;
+    if (child->release != NULL) child->release(child);
+    free(child);
+  }
+  free(array->children);
+  free(array->buffers);
+  array->release = NULL;
+}
+
+int px_arrow_batch_export(px_arrow_batch_t* batch, const char** names, struct ArrowSchema* schema,
+                          struct ArrowArray* array) {
+  int n = batch->num_columns;
+
+  // The root is a struct with a child per column. The release callbacks are
+  // set first, so that a partly filled export can be released on failure.
+  memset(schema, 0, sizeof(*schema));
+  schema->format = "+s";
+  schema->name = "";
+  schema->n_children = n;
+  schema->children = (struct ArrowSchema**) calloc(n > 0 ? n : 1, sizeof(struct ArrowSchema*));
+  schema->release = release_batch_schema;
+
+  memset(array, 0, sizeof(*array));
+  array->length = batch->length;
+  array->n_buffers = 1;
+  array->n_children = n;
+  array->buffers = (const void**) calloc(1, sizeof(void*));
+  array->children = (struct ArrowArray**) calloc(n > 0 ? n : 1, sizeof(struct ArrowArray*));
+  array->release = release_batch_array;
+
+  int ok = schema->children != NULL && array->buffers != NULL && array->children != NULL;
+  for (int j = 0; ok && j < n; j++) {
+    px_arrow_column_t* col = &batch->columns[j];
+    struct ArrowSchema* child_schema = (struct ArrowSchema*) calloc(1, sizeof(struct ArrowSchema));
+    struct ArrowArray* child = (struct ArrowArray*) calloc(1, sizeof(struct ArrowArray));
+    schema->children[j] = child_schema;
+    array->children[j] = child;
+    if (child_schema == NULL || child == NULL) {
+      ok = 0;
+      break;
+    }
+
+    child_schema->format = col->format;
+    child_schema->name = copy_string(names[j]);
+    child_schema->flags = ARROW_FLAG_NULLABLE;
+    child_schema->release = release_column_schema;
+
+    child->length = batch->length;
+    child->null_count = col->null_count;
+    child->n_buffers = col->layout == PX_ARROW_VARLEN ? 3 : 2;
+    child->buffers = (const void**) calloc(3, sizeof(void*));
+    child->release = release_column_array;
+    if (child_schema->name == NULL || child->buffers == NULL) {
+      ok = 0;
+      break;
+    }
+    // The buffers now belong to the array. Empty data stays allocated, as
+    // some consumers do not accept a NULL buffer.
+    if (col->layout == PX_ARROW_VARLEN && col->data == NULL) {
+      col->data = (char*) malloc(1);
+      if (col->data == NULL) {
+        ok = 0;
+        break;
+      }
+    }
+    child->buffers[0] = col->validity;
+    child->buffers[1] = col->values;
+    child->buffers[2] = col->data;
+    col->validity = NULL;
+    col->values = NULL;
+    col->data = NULL;
+  }
+  px_arrow_batch_free(batch);
+
+  if (!ok) {
+    schema->release(schema);
+    array->release(array);
+    return -1;
+  }
+  return 0;
+}
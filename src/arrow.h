@@ -0,0 +1,123 @@
+/**
+ * @file arrow.h
+ * @brief Export of Paradox records as Arrow record batches.
+ */
+
+#ifndef RPARADOX_ARROW_H
+#define RPARADOX_ARROW_H
+
+#include <stdint.h>
+#include "paradox.h"
+
+// The structures of the Arrow C data interface, as given by its specification.
+// Any producer may define them, the guard avoids a second definition.
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+  // Array type description
+  const char* format;
+  const char* name;
+  const char* metadata;
+  int64_t flags;
+  int64_t n_children;
+  struct ArrowSchema** children;
+  struct ArrowSchema* dictionary;
+
+  // Release callback
+  void (*release)(struct ArrowSchema*);
+  // Opaque producer-specific data
+  void* private_data;
+};
+
+struct ArrowArray {
+  // Array data description
+  int64_t length;
+  int64_t null_count;
+  int64_t offset;
+  int64_t n_buffers;
+  int64_t n_children;
+  const void** buffers;
+  struct ArrowArray** children;
+  struct ArrowArray* dictionary;
+
+  // Release callback
+  void (*release)(struct ArrowArray*);
+  // Opaque producer-specific data
+  void* private_data;
+};
+
+#endif /* ARROW_C_DATA_INTERFACE */
+
+typedef struct px_arrow_batch px_arrow_batch_t;
+
+/**
+ * @brief Creates an empty record batch for the records of a table.
+ *
+ * Each field becomes a nullable column of the Arrow type matching its
+ * Paradox type: Short `int16`, Long and AutoInc `int32`, Logical `bool`,
+ * Number, Currency and BCD `float64`, Date `date32`, Time `time32[ms]`,
+ * Timestamp `timestamp[ms, UTC]`, Alpha, memos and BCD read as text `utf8`,
+ * and Bytes, BLOb, OLE and Graphic `binary`. The values are the ones
+ * `pxlib_get_data()` returns, without creating any R object. Text is
+ * converted to the target encoding of `pxdoc`, if one is set.
+ *
+ * The batch is allocated with `malloc()`, so it can outlive the `.Call`.
+ *
+ * @param pxdoc The open Paradox document.
+ * @param fields The definitions of the fields to export.
+ * @param offsets The byte offset of each field within a record.
+ * @param num_fields The number of fields.
+ * @param capacity The maximum number of records of the batch.
+ * @param bcd_text If non-zero, BCD fields are exported as their exact text.
+ * @return The new batch, or NULL if no memory could be allocated.
+ */
+px_arrow_batch_t* px_arrow_batch_new(pxdoc_t* pxdoc, const pxfield_t* fields, const int* offsets,
+                                     int num_fields, int capacity, int bcd_text);
+
+/**
+ * @brief Callback for `PX_scan_range()` that appends a block of records to a batch.
+ *
+ * Fixed-width fields are decoded with `px_decode_column()`, all others go
+ * straight from the record data or `PX_convert_field()` into the buffers of
+ * their column. No R API is used here.
+ *
+ * @param user_data A pointer to the `px_arrow_batch_t`.
+ * @return 0 to continue the scan, -1 if the batch is full, no memory could
+ *   be allocated or a column holds more than 2 GB of data.
+ */
+int px_arrow_block_cb(pxdoc_t* pxdoc, int recno, char* records, int numrecords, void* user_data);
+
+/**
+ * @brief Returns the number of records appended to a batch.
+ */
+int px_arrow_batch_length(const px_arrow_batch_t* batch);
+
+/**
+ * @brief Moves a batch into the structures of the Arrow C data interface.
+ *
+ * `schema` receives a struct type with one child per field, `array` the
+ * matching struct array, the way record batches are exchanged. The buffers
+ * of the batch are handed over to `array` and freed by its release callback;
+ * the batch itself is freed in all cases.
+ *
+ * @param batch The batch to export.
+ * @param names The UTF-8 name of each field, copied into the schema.
+ * @param schema Receives the schema.
+ * @param array Receives the array.
+ * @return 0 on success, -1 if no memory could be allocated, in which case
+ *   `schema` and `array` are left released.
+ */
+int px_arrow_batch_export(px_arrow_batch_t* batch, const char** names, struct ArrowSchema* schema,
+                          struct ArrowArray* array);
+
+/**
+ * @brief Frees a batch that has not been exported, with all its buffers.
+ */
+void px_arrow_batch_free(px_arrow_batch_t* batch);
+
+#endif /* RPARADOX_ARROW_H */
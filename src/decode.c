@@ -0,0 +1,409 @@
+/**
+ * @file decode.c
+ * @brief Column decode kernels for fixed-width Paradox field types.
+ *
+ * Paradox stores numbers big-endian with the sign bit inverted, so that the
+ * raw bytes sort like the values. A field with all bytes zero is NULL.
+ * The generic path (`PX_get_data_long()`, `PX_get_data_double()`, ...) undoes
+ * this one value at a time through a `pxval_t`. The kernels below do the same
+ * decoding inline and write the values, already mapped to their R
+ * representation, directly into the memory of the R column vector.
+ *
+ * The NULL handling mirrors the generic path exactly:
+ * - Short, Long, AutoInc, Date, Time and Logical: NULL becomes `NA`.
+ * - Number and Currency: a NULL value is read as 0, as `PX_get_data_double()`
+ *   does not flag it as NULL.
+ * - Timestamp: NULL (and any non-positive value) becomes `NA`.
+ * - BCD: NULL, the blank value of which `PX_get_data_bcd()` makes question
+ *   marks, and a value whose number of decimal places is not the one of the
+ *   field, for which `PX_get_data_bcd()` fails, become `NA`.
+ *
+ * Alpha fields are turned into CHARSXPs straight from the record data, with a
+ * small per-column cache for repeated values. If a target encoding is set with
+ * `PX_set_targetencoding()`, text is converted to it on the way, so only the
+ * distinct values of a column are converted at all.
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <R.h>
+#include <Rinternals.h>
+#include "paradox.h"
+#include "px_encode.h"
+#include "decode.h"
+
+// Days between the Paradox epoch (0001-01-01 as day 1) and the R epoch (1970-01-01).
+#define PX_R_EPOCH_DAYS 719163.0
+// Larger day numbers are treated as blank/garbage dates (around year 10100).
+#define PX_DATE_UPPER_BOUND 3000000
+
+static inline uint16_t load_u16_be(const unsigned char* p) {
+  return (uint16_t) (((uint16_t) p[0] << 8) | p[1]);
+}
+
+static inline uint32_t load_u32_be(const unsigned char* p) {
+  return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+         ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+static inline uint64_t load_u64_be(const unsigned char* p) {
+  return ((uint64_t) load_u32_be(p) << 32) | load_u32_be(p + 4);
+}
+
+/**
+ * @brief Decodes a Paradox Long/Date/Time value.
+ * @return 1 if the value is not NULL, 0 otherwise.
+ */
+static inline int decode_long(const unsigned char* p, int32_t* value) {
+  uint32_t u = load_u32_be(p);
+  if (u == 0) return 0;
+  // Clears the sign bit of positive values and sets it for negative ones.
+  *value = (int32_t) (u ^ 0x80000000u);
+  return 1;
+}
+
+/**
+ * @brief Decodes a Paradox Number/Currency/Timestamp value.
+ * NULL values are returned as 0, like `PX_get_data_double()` does.
+ */
+static inline double decode_double(const unsigned char* p) {
+  uint64_t u = load_u64_be(p);
+  double d;
+  if (u & 0x8000000000000000u) {
+    u &= 0x7fffffffffffffffu;
+  } else if ((u >> 32) != 0) {
+    // Negative values have all bits inverted.
+    u = ~u;
+  } else {
+    return 0.0;
+  }
+  memcpy(&d, &u, sizeof(d));
+  return d;
+}
+
+// Number of digits of a BCD value, and powers of ten to scale them.
+#define PX_BCD_DIGITS 32
+static const double bcd_scale[PX_BCD_DIGITS + 1] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16,
+  1e17, 1e18, 1e19, 1e20, 1e21, 1e22, 1e23, 1e24, 1e25, 1e26, 1e27, 1e28, 1e29, 1e30, 1e31, 1e32
+};
+
+/**
+ * @brief Decodes a Paradox BCD value.
+ *
+ * The first byte holds the sign bit and the number of decimal places, the
+ * other 16 bytes hold 32 digits, two per byte, all inverted for negative
+ * values. The digits are summed up as two 16-digit integers. Values of up to
+ * 15 digits with at most 22 decimal places are scaled with a single correctly
+ * rounded division, so they come out exactly like parsing the text of
+ * `PX_get_data_bcd()`. The number of decimal places held by the value must be
+ * `fdc`, the one of the field, as `PX_get_data_bcd()` requires.
+ */
+static inline double decode_bcd(const unsigned char* p, int fdc) {
+  if (p[0] == 0) return NA_REAL;
+  unsigned char flip = (p[0] & 0x80) ? 0x00 : 0xff;
+  int scale = p[0] & 0x3f;
+  if (scale != fdc || scale > PX_BCD_DIGITS) return NA_REAL;
+  uint64_t part[2] = {0, 0};
+  for (int k = 0; k < PX_BCD_DIGITS / 2; k++) {
+    unsigned char b = p[1 + k] ^ flip;
+    unsigned char hi = b >> 4, lo = b & 0x0f;
+    // Blank values have digits beyond 9.
+    if (hi > 9 || lo > 9) return NA_REAL;
+    part[k / 8] = part[k / 8] * 100 + hi * 10 + lo;
+  }
+  double value = ((double) part[0] * 1e16 + (double) part[1]) / bcd_scale[scale];
+  return flip ? -value : value;
+}
+
+// Decoders of a single value, already mapped to its R representation.
+
+static inline int decode_short_value(const unsigned char* p) {
+  uint16_t u = load_u16_be(p);
+  return (u == 0) ? NA_INTEGER : (int) (int16_t) (u ^ 0x8000u);
+}
+
+static inline int decode_long_value(const unsigned char* p) {
+  int32_t lval;
+  return decode_long(p, &lval) ? (int) lval : NA_INTEGER;
+}
+
+// The value byte has its sign bit set; anything else non-zero is read as TRUE.
+static inline int decode_logical_value(const unsigned char* p) {
+  if (p[0] & 0x80) return (p[0] & 0x7f) != 0;
+  return (p[0] != 0) ? TRUE : NA_LOGICAL;
+}
+
+// Paradox dates are day numbers, R dates are days since 1970-01-01.
+static inline double decode_date_value(const unsigned char* p) {
+  int32_t lval;
+  if (decode_long(p, &lval) && lval > 0 && lval <= PX_DATE_UPPER_BOUND) {
+    return (double) lval - PX_R_EPOCH_DAYS;
+  }
+  return NA_REAL;
+}
+
+static inline int decode_date_int_value(const unsigned char* p) {
+  int32_t lval;
+  if (decode_long(p, &lval) && lval > 0 && lval <= PX_DATE_UPPER_BOUND) {
+    return (int) lval - (int) PX_R_EPOCH_DAYS;
+  }
+  return NA_INTEGER;
+}
+
+// Paradox times are milliseconds since midnight, 'hms' uses seconds.
+static inline double decode_time_value(const unsigned char* p) {
+  int32_t lval;
+  if (decode_long(p, &lval) && lval >= 0) {
+    return (double) lval / 1000.0;
+  }
+  return NA_REAL;
+}
+
+// Paradox timestamps are milliseconds, POSIXct uses seconds since 1970-01-01 UTC.
+static inline double decode_timestamp_value(const unsigned char* p) {
+  double ms = decode_double(p);
+  double secs = ms / 1000.0;
+  if (ms == 0.0 || secs < 0) return NA_REAL;
+  return secs - (PX_R_EPOCH_DAYS * 86400.0);
+}
+
+/*
+ * Defines the kernel `name` of a field type of `size` bytes whose values are
+ * decoded with `decode` into elements of `type`. Every field of a run is
+ * decoded in its own tight loop over the records, so one call replaces the
+ * dispatch of each field of the run. The records of a block are still in the
+ * cache when the loop of the next field goes over them. Only BCD values depend
+ * on the number of decimal places of the field, the other kernels ignore it.
+ */
+#define PX_DEFINE_KERNEL(name, type, size, decode)                                        \
+  static void name(const char* field, size_t stride, int n, int width, int fdc,           \
+                   void* const* outs, size_t row) {                                      \
+    (void) fdc;                                                                          \
+    for (int k = 0; k < width; k++) {                                                    \
+      const unsigned char* p = (const unsigned char*) field + k * (size);                \
+      type* out = (type*) outs[k] + row;                                                 \
+      for (int i = 0; i < n; i++, p += stride) out[i] = decode(p);                       \
+    }                                                                                    \
+  }
+
+PX_DEFINE_KERNEL(kernel_short, int, 2, decode_short_value)
+PX_DEFINE_KERNEL(kernel_long, int, 4, decode_long_value)
+PX_DEFINE_KERNEL(kernel_logical, int, 1, decode_logical_value)
+PX_DEFINE_KERNEL(kernel_number, double, 8, decode_double)
+PX_DEFINE_KERNEL(kernel_date, double, 4, decode_date_value)
+PX_DEFINE_KERNEL(kernel_date_int, int, 4, decode_date_int_value)
+PX_DEFINE_KERNEL(kernel_time, double, 4, decode_time_value)
+PX_DEFINE_KERNEL(kernel_timestamp, double, 8, decode_timestamp_value)
+
+static void kernel_bcd(const char* field, size_t stride, int n, int width, int fdc,
+                       void* const* outs, size_t row) {
+  for (int k = 0; k < width; k++) {
+    const unsigned char* p = (const unsigned char*) field + k * 17;
+    double* out = (double*) outs[k] + row;
+    for (int i = 0; i < n; i++, p += stride) out[i] = decode_bcd(p, fdc);
+  }
+}
+
+/**
+ * @brief Returns the kernel of a field type and the size of its fields, or
+ *   NULL if the type has no kernel. With `int_dates`, Date fields are decoded
+ *   to `int` instead of `double`.
+ */
+static px_decode_kernel_t find_kernel(int px_ftype, int int_dates, int* size) {
+  switch (px_ftype) {
+  case pxfShort: *size = 2; return kernel_short;
+  case pxfLong: case pxfAutoInc: *size = 4; return kernel_long;
+  case pxfLogical: *size = 1; return kernel_logical;
+  case pxfNumber: case pxfCurrency: *size = 8; return kernel_number;
+  case pxfDate: *size = 4; return int_dates ? kernel_date_int : kernel_date;
+  case pxfTime: *size = 4; return kernel_time;
+  case pxfTimestamp: *size = 8; return kernel_timestamp;
+  case pxfBCD: *size = 17; return kernel_bcd;
+  default: *size = 0; return NULL;
+  }
+}
+
+int px_decode_has_kernel(int px_ftype) {
+  return px_decode_kernel(px_ftype) != NULL;
+}
+
+px_decode_kernel_t px_decode_kernel(int px_ftype) {
+  int size;
+  return find_kernel(px_ftype, 0, &size);
+}
+
+void px_decode_column(int px_ftype, int px_fdc, const char* field, size_t stride, int n, void* out) {
+  px_decode_kernel_t kernel = px_decode_kernel(px_ftype);
+  if (kernel != NULL) kernel(field, stride, n, 1, px_fdc, &out, 0);
+}
+
+// A kernel call of a decode plan.
+typedef struct {
+  px_decode_kernel_t kernel;
+  int offset;        // Byte offset of the first field within a record.
+  int width;         // Number of adjacent fields decoded by the call.
+  int fdc;           // Number of decimal places of the fields.
+  void* const* outs; // Data pointer of the column of each field.
+} px_decode_step_t;
+
+struct px_decode_plan {
+  px_decode_step_t* steps;
+  int num_steps;
+};
+
+px_decode_plan_t* px_decode_plan_new(const pxfield_t* fields, const int* offsets, void* const* dest,
+                                     int num_fields, int int_dates) {
+  px_decode_plan_t* plan = (px_decode_plan_t*) R_alloc(1, sizeof(px_decode_plan_t));
+  plan->steps = (px_decode_step_t*) R_alloc(num_fields > 0 ? num_fields : 1, sizeof(px_decode_step_t));
+  plan->num_steps = 0;
+  for (int j = 0; j < num_fields; j++) {
+    int size;
+    px_decode_kernel_t kernel = find_kernel(fields[j].px_ftype, int_dates, &size);
+    if (dest[j] == NULL || kernel == NULL) continue;
+    // The following columns join the step while their fields follow this one in the record.
+    int width = 1;
+    if (fields[j].px_flen == size) {
+      while (j + width < num_fields && dest[j + width] != NULL &&
+             fields[j + width].px_flen == size && fields[j + width].px_fdc == fields[j].px_fdc &&
+             offsets[j + width] == offsets[j] + width * size &&
+             find_kernel(fields[j + width].px_ftype, int_dates, &size) == kernel) {
+        width++;
+      }
+    }
+    px_decode_step_t* step = &plan->steps[plan->num_steps++];
+    step->kernel = kernel;
+    step->offset = offsets[j];
+    step->width = width;
+    step->fdc = fields[j].px_fdc;
+    step->outs = dest + j;
+    j += width - 1;
+  }
+  return plan;
+}
+
+void px_decode_plan_run(const px_decode_plan_t* plan, const char* records, size_t stride, int n,
+                        size_t row) {
+  for (int s = 0; s < plan->num_steps; s++) {
+    const px_decode_step_t* step = &plan->steps[s];
+    step->kernel(records + step->offset, stride, n, step->width, step->fdc, step->outs, row);
+  }
+}
+
+// Number of hash slots of a string cache, twice the number of strings it holds.
+#define PX_STRING_CACHE_SLOTS (2 * PX_STRING_CACHE_MAX)
+
+// Size of the chunks the raw bytes of cached strings are copied to.
+#define PX_STRING_CACHE_CHUNK 4096
+
+struct px_string_cache {
+  int size;                              // Number of cached strings, -1 once full.
+  uint32_t hashes[PX_STRING_CACHE_SLOTS];
+  int slots[PX_STRING_CACHE_SLOTS];      // 1-based index into `strings`, 0 if empty.
+  SEXP strings[PX_STRING_CACHE_MAX];     // In order of first appearance.
+  // The bytes of each string as they are in the file. The CHARSXP may hold
+  // other bytes once the text has been converted to the target encoding.
+  const char* raw[PX_STRING_CACHE_MAX];
+  int raw_lengths[PX_STRING_CACHE_MAX];
+  char* chunk;                           // Free space for further raw bytes.
+  size_t chunk_left;
+};
+
+px_string_cache_t* px_string_cache_new(void) {
+  px_string_cache_t* cache = (px_string_cache_t*) R_alloc(1, sizeof(px_string_cache_t));
+  memset(cache, 0, sizeof(px_string_cache_t));
+  return cache;
+}
+
+// FNV-1a, good enough for short code values.
+static inline uint32_t hash_bytes(const unsigned char* p, size_t n) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; i++) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+// Text up to this length is converted in a buffer on the stack.
+#define PX_TEXT_STACK_LEN 256
+
+SEXP px_decode_text(pxdoc_t* pxdoc, const char* text, int len) {
+  if (pxdoc == NULL || pxdoc->out_iconvcd == (Riconv_t) -1) {
+    return mkCharLenCE(text, len, CE_NATIVE);
+  }
+  cetype_t ce = strcmp(pxdoc->targetencoding, "UTF-8") == 0 ? CE_UTF8 : CE_NATIVE;
+  char stack_buffer[4 * PX_TEXT_STACK_LEN];
+  size_t size = 4 * (size_t) len;
+  if (len <= PX_TEXT_STACK_LEN) {
+    size_t n = px_recode_target(pxdoc, text, (size_t) len, stack_buffer, size);
+    return mkCharLenCE(stack_buffer, (int) n, ce);
+  }
+  const void* vmax = vmaxget();
+  char* buffer = R_alloc(size, 1);
+  size_t n = px_recode_target(pxdoc, text, (size_t) len, buffer, size);
+  SEXP r_str = mkCharLenCE(buffer, (int) n, ce);
+  vmaxset(vmax);
+  return r_str;
+}
+
+SEXP px_decode_alpha(pxdoc_t* pxdoc, px_string_cache_t* cache, const char* field, int len, int* level) {
+  *level = NA_INTEGER;
+  // A NULL value starts with a zero byte, like in PX_get_data_alpha().
+  if (field[0] == '\0') return NA_STRING;
+  const char* end = memchr(field, '\0', (size_t) len);
+  int n = end ? (int) (end - field) : len;
+
+  if (cache == NULL || cache->size < 0) {
+    return px_decode_text(pxdoc, field, n);
+  }
+
+  uint32_t h = hash_bytes((const unsigned char*) field, (size_t) n);
+  int slot = (int) (h & (PX_STRING_CACHE_SLOTS - 1));
+  while (cache->slots[slot] != 0) {
+    int k = cache->slots[slot] - 1;
+    if (cache->hashes[slot] == h && cache->raw_lengths[k] == n &&
+        memcmp(cache->raw[k], field, (size_t) n) == 0) {
+      *level = k + 1;
+      return cache->strings[k];
+    }
+    slot = (slot + 1) & (PX_STRING_CACHE_SLOTS - 1);
+  }
+
+  if (cache->size == PX_STRING_CACHE_MAX) {
+    // Too many distinct values: stop caching for the rest of the column.
+    cache->size = -1;
+    return px_decode_text(pxdoc, field, n);
+  }
+  // The raw bytes are kept before the string is made, which leaves it
+  // unprotected until the caller stores it.
+  if ((size_t) n > cache->chunk_left) {
+    cache->chunk_left = PX_STRING_CACHE_CHUNK;
+    if ((size_t) n > cache->chunk_left) cache->chunk_left = (size_t) n;
+    cache->chunk = R_alloc(cache->chunk_left, 1);
+  }
+  memcpy(cache->chunk, field, (size_t) n);
+  cache->raw[cache->size] = cache->chunk;
+  cache->raw_lengths[cache->size] = n;
+  cache->chunk += n;
+  cache->chunk_left -= (size_t) n;
+  SEXP s = px_decode_text(pxdoc, field, n);
+  cache->strings[cache->size] = s;
+  cache->hashes[slot] = h;
+  cache->slots[slot] = ++cache->size;
+  *level = cache->size;
+  return s;
+}
+
+int px_string_cache_size(const px_string_cache_t* cache) {
+  return cache->size;
+}
+
+SEXP px_string_cache_levels(const px_string_cache_t* cache) {
+  int n = cache->size > 0 ? cache->size : 0;
+  SEXP levels = PROTECT(allocVector(STRSXP, n));
+  for (int k = 0; k < n; k++) {
+    SET_STRING_ELT(levels, k, cache->strings[k]);
+  }
+  UNPROTECT(1);
+  return levels;
+}
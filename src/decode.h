@@ -0,0 +1,162 @@
+/**
+ * @file decode.h
+ * @brief Column decode kernels for fixed-width Paradox field types.
+ */
+
+#ifndef RPARADOX_DECODE_H
+#define RPARADOX_DECODE_H
+
+#include <stddef.h>
+#include <Rinternals.h>
+#include "paradox.h"
+
+// Maximum number of distinct strings a string cache holds, see px_decode_alpha().
+#define PX_STRING_CACHE_MAX 1024
+
+typedef struct px_string_cache px_string_cache_t;
+
+/**
+ * @brief Checks whether a Paradox field type has a column decode kernel.
+ *
+ * @param px_ftype The Paradox field type (one of the `pxf*` constants).
+ * @return 1 if `px_decode_column()` can decode the type, 0 otherwise.
+ */
+int px_decode_has_kernel(int px_ftype);
+
+/**
+ * @brief Decodes one field of consecutive records straight into a column buffer.
+ *
+ * `field` points to the field in the first record, the following records are
+ * `stride` bytes apart. Integer types (Short, Long, AutoInc) and Logical are
+ * written to an `int` buffer, all others (Number, Currency, Date, Time,
+ * Timestamp, BCD) to a `double` buffer, both already converted to their R
+ * representation including `NA`. BCD values are decoded to `double`, which
+ * keeps about 15 of their up to 32 significant digits. A BCD value whose
+ * number of decimal places differs from `px_fdc` becomes `NA`, as
+ * `PX_get_data_bcd()` rejects it.
+ *
+ * @param px_ftype The Paradox field type. It must have a kernel.
+ * @param px_fdc The number of decimal places of the field (`px_fdc` of its
+ *   `pxfield_t`).
+ * @param field Pointer to the raw field data of the first record.
+ * @param stride The distance in bytes between two records (the record size).
+ * @param n The number of records to decode.
+ * @param out Pointer to the first `int` or `double` element to write.
+ */
+void px_decode_column(int px_ftype, int px_fdc, const char* field, size_t stride, int n, void* out);
+
+/**
+ * @brief A decode kernel of one field type.
+ *
+ * Decodes `width` adjacent fields of the type in `n` consecutive records.
+ * `field` points to the first field in the first record, the other fields
+ * follow it without a gap and the records are `stride` bytes apart. The
+ * values of field `k` are written to the elements `row` to `row + n - 1` of
+ * the `int` or `double` buffer `outs[k]`, as described for
+ * `px_decode_column()`. All fields have `fdc` decimal places.
+ */
+typedef void (*px_decode_kernel_t)(const char* field, size_t stride, int n, int width, int fdc,
+                                   void* const* outs, size_t row);
+
+/**
+ * @brief Returns the decode kernel of a Paradox field type, or NULL if the
+ *   type has none.
+ */
+px_decode_kernel_t px_decode_kernel(int px_ftype);
+
+typedef struct px_decode_plan px_decode_plan_t;
+
+/**
+ * @brief Compiles the decode plan of the kernel fields of a read.
+ *
+ * The plan is the list of kernel calls that decode the selected fields of a
+ * block of records, made once per read instead of choosing a kernel for
+ * every field of every block. Selected fields of the same type that are
+ * adjacent in the record, such as several Long or Number fields in a row,
+ * are decoded by a single call. The plan is allocated with `R_alloc()`.
+ *
+ * @param fields The fields of the table.
+ * @param offsets The byte offset of each field within a record.
+ * @param dest The data pointer of the column of each field, or NULL for the
+ *   fields that are not decoded by a kernel. The array must stay valid as
+ *   long as the plan is used.
+ * @param num_fields The number of fields.
+ * @param int_dates If non-zero, Date fields are written to `int` columns, as
+ *   the days since 1970-01-01, instead of `double` columns.
+ * @return The new plan.
+ */
+px_decode_plan_t* px_decode_plan_new(const pxfield_t* fields, const int* offsets, void* const* dest,
+                                     int num_fields, int int_dates);
+
+/**
+ * @brief Decodes the kernel fields of consecutive records with a plan.
+ *
+ * Only reads the records and writes the columns, so it can run on any
+ * thread.
+ *
+ * @param plan The plan of `px_decode_plan_new()`.
+ * @param records Pointer to the first record.
+ * @param stride The distance in bytes between two records.
+ * @param n The number of records.
+ * @param row The row of the columns the first record is written to.
+ */
+void px_decode_plan_run(const px_decode_plan_t* plan, const char* records, size_t stride, int n,
+                        size_t row);
+
+/**
+ * @brief Creates an empty string cache for one Alpha column.
+ *
+ * The cache is allocated with `R_alloc()` and released when the `.Call`
+ * returns.
+ */
+px_string_cache_t* px_string_cache_new(void);
+
+/**
+ * @brief Makes a CHARSXP from text of a Paradox file.
+ *
+ * If a target encoding is set for `pxdoc`, the text is converted to it, with
+ * a lookup table for single-byte codepages, and the result is marked as UTF-8
+ * if that is the target. Otherwise the bytes are taken as they are.
+ *
+ * @param pxdoc The Paradox document the text was read from, or NULL.
+ * @param text Pointer to the text.
+ * @param len The length of the text in bytes.
+ * @return The new or existing CHARSXP.
+ */
+SEXP px_decode_text(pxdoc_t* pxdoc, const char* text, int len);
+
+/**
+ * @brief Decodes an Alpha field straight from the record data into a CHARSXP.
+ *
+ * The string ends at the first zero byte or after `len` bytes. It is created
+ * with `px_decode_text()` directly from the record, without an intermediate copy.
+ * The first `PX_STRING_CACHE_MAX` distinct strings of a column are kept in the
+ * cache of the column together with their bytes in the file, so repeated
+ * values are neither converted again nor looked up in R's global CHARSXP
+ * cache. The caller must store the result in a protected vector before the
+ * next allocation, which also keeps the cached strings alive.
+ *
+ * @param pxdoc The Paradox document, for its target encoding.
+ * @param cache The cache of the column, or NULL.
+ * @param field Pointer to the raw field data.
+ * @param len The length of the field in bytes.
+ * @param level Receives the 1-based position of the string in the cache, in
+ *   order of first appearance, or `NA_INTEGER` for NULL values and strings
+ *   that are not cached.
+ * @return The CHARSXP, or `NA_STRING` if the field is NULL.
+ */
+SEXP px_decode_alpha(pxdoc_t* pxdoc, px_string_cache_t* cache, const char* field, int len, int* level);
+
+/**
+ * @brief Returns the number of distinct strings seen by a cache, or -1 if
+ *   there were more than `PX_STRING_CACHE_MAX`.
+ */
+int px_string_cache_size(const px_string_cache_t* cache);
+
+/**
+ * @brief Returns the cached strings in order of first appearance as a new
+ *   (unprotected) character vector.
+ */
+SEXP px_string_cache_levels(const px_string_cache_t* cache);
+
+#endif /* RPARADOX_DECODE_H */
@@ -0,0 +1,252 @@
+/**
+ * @file filter.c
+ * @brief Row filters evaluated on the raw record data.
+ *
+ * A filter is a conjunction of simple conditions on single fields. It is
+ * evaluated block by block during the scan, before any string is created or
+ * any BLOB is read, so only the records that pass are converted at all.
+ *
+ * Numeric, date and time fields are decoded with `px_decode_column()` into a
+ * scratch buffer and compared in their R representation. Alpha fields are
+ * compared byte by byte with the values, which R has already converted to the
+ * encoding of the file.
+ */
+
+#include <string.h>
+#include <R.h>
+#include <Rinternals.h>
+#include "paradox.h"
+#include "decode.h"
+#include "filter.h"
+
+typedef enum {
+  PX_OP_EQ, PX_OP_NE, PX_OP_LT, PX_OP_LE, PX_OP_GT, PX_OP_GE, PX_OP_IN, PX_OP_IS_NA, PX_OP_NOT_NA
+} px_filter_op_t;
+
+static const char* op_names[] = {"==", "!=", "<", "<=", ">", ">=", "in", "is_na", "not_na"};
+#define PX_FILTER_NUM_OPS 9
+
+typedef struct {
+  int ftype;          // Paradox field type.
+  int offset;         // Byte offset of the field within a record.
+  int len;            // Length of the field in bytes.
+  int fdc;            // Number of decimal places of the field.
+  px_filter_op_t op;
+  int num_values;
+  const double* values;        // Numeric fields.
+  const char** texts;          // Alpha fields, NULL for NA.
+  const int* text_lens;
+  int has_na;                  // Whether the values contain NA.
+} px_condition_t;
+
+struct px_filter {
+  int num_conditions;
+  px_condition_t* conditions;
+  int capacity;       // Maximum number of records per call.
+  int* ibuf;          // Scratch buffers for decoded values.
+  double* dbuf;
+};
+
+static SEXP get_element(SEXP list, const char* name) {
+  SEXP names = getAttrib(list, R_NamesSymbol);
+  for (int k = 0; k < LENGTH(list); k++) {
+    if (strcmp(CHAR(STRING_ELT(names, k)), name) == 0) return VECTOR_ELT(list, k);
+  }
+  return R_NilValue;
+}
+
+px_filter_t* px_filter_new(pxdoc_t* pxdoc, SEXP conditions_sexp) {
+  if (TYPEOF(conditions_sexp) != VECSXP) {
+    Rf_error("The filter must be a list of conditions.");
+  }
+  int num_fields = PX_get_num_fields(pxdoc);
+  pxfield_t* fields = PX_get_fields(pxdoc);
+  int recordsize = PX_get_recordsize(pxdoc);
+  if (fields == NULL || recordsize <= 0) {
+    Rf_error("Could not retrieve field definitions from Paradox file.");
+  }
+
+  px_filter_t* filter = (px_filter_t*) R_alloc(1, sizeof(px_filter_t));
+  filter->num_conditions = LENGTH(conditions_sexp);
+  filter->conditions = (px_condition_t*) R_alloc(filter->num_conditions > 0 ? filter->num_conditions : 1,
+                                                 sizeof(px_condition_t));
+  // No data block holds more records than fit into it.
+  filter->capacity = pxdoc->px_head->px_maxtablesize * 0x400 / recordsize + 1;
+  filter->ibuf = (int*) R_alloc(filter->capacity, sizeof(int));
+  filter->dbuf = (double*) R_alloc(filter->capacity, sizeof(double));
+
+  for (int c = 0; c < filter->num_conditions; c++) {
+    SEXP cond = VECTOR_ELT(conditions_sexp, c);
+    px_condition_t* pc = &filter->conditions[c];
+    if (TYPEOF(cond) != VECSXP) {
+      Rf_error("Filter condition %d is not a list.", c + 1);
+    }
+    int j = asInteger(get_element(cond, "field"));
+    if (j == NA_INTEGER || j < 0 || j >= num_fields) {
+      Rf_error("Filter condition %d refers to a field out of range.", c + 1);
+    }
+    SEXP op_sexp = get_element(cond, "op");
+    if (TYPEOF(op_sexp) != STRSXP || LENGTH(op_sexp) != 1) {
+      Rf_error("Filter condition %d has no operator.", c + 1);
+    }
+    int op = 0;
+    while (op < PX_FILTER_NUM_OPS && strcmp(CHAR(STRING_ELT(op_sexp, 0)), op_names[op]) != 0) op++;
+    if (op == PX_FILTER_NUM_OPS) {
+      Rf_error("Unknown operator '%s' in filter condition %d.", CHAR(STRING_ELT(op_sexp, 0)), c + 1);
+    }
+
+    pc->ftype = fields[j].px_ftype;
+    pc->len = fields[j].px_flen;
+    pc->fdc = fields[j].px_fdc;
+    pc->offset = 0;
+    for (int k = 0; k < j; k++) pc->offset += fields[k].px_flen;
+    pc->op = (px_filter_op_t) op;
+    pc->values = NULL;
+    pc->texts = NULL;
+    pc->text_lens = NULL;
+    pc->num_values = 0;
+    pc->has_na = 0;
+
+    SEXP values = get_element(cond, "values");
+    if (pc->ftype == pxfAlpha) {
+      if (pc->op != PX_OP_EQ && pc->op != PX_OP_NE && pc->op != PX_OP_IN &&
+          pc->op != PX_OP_IS_NA && pc->op != PX_OP_NOT_NA) {
+        Rf_error("Alpha fields can only be tested for equality in filter condition %d.", c + 1);
+      }
+      if (!Rf_isNull(values) && TYPEOF(values) != VECSXP) {
+        Rf_error("The values of filter condition %d must be a list of raw vectors.", c + 1);
+      }
+      pc->num_values = Rf_isNull(values) ? 0 : LENGTH(values);
+      pc->texts = (const char**) R_alloc(pc->num_values > 0 ? pc->num_values : 1, sizeof(char*));
+      int* lens = (int*) R_alloc(pc->num_values > 0 ? pc->num_values : 1, sizeof(int));
+      for (int k = 0; k < pc->num_values; k++) {
+        SEXP v = VECTOR_ELT(values, k);
+        if (Rf_isNull(v)) {
+          pc->texts[k] = NULL;
+          lens[k] = 0;
+          pc->has_na = 1;
+        } else if (TYPEOF(v) == RAWSXP) {
+          pc->texts[k] = (const char*) RAW(v);
+          lens[k] = LENGTH(v);
+        } else {
+          Rf_error("The values of filter condition %d must be a list of raw vectors.", c + 1);
+        }
+      }
+      pc->text_lens = lens;
+    } else if (px_decode_has_kernel(pc->ftype)) {
+      if (!Rf_isNull(values) && TYPEOF(values) != REALSXP) {
+        Rf_error("The values of filter condition %d must be a double vector.", c + 1);
+      }
+      pc->num_values = Rf_isNull(values) ? 0 : LENGTH(values);
+      pc->values = Rf_isNull(values) ? NULL : REAL(values);
+      for (int k = 0; k < pc->num_values; k++) {
+        if (ISNAN(pc->values[k])) pc->has_na = 1;
+      }
+    } else {
+      Rf_error("Field '%s' of filter condition %d cannot be filtered.", fields[j].px_fname, c + 1);
+    }
+    if (pc->op != PX_OP_IN && pc->op != PX_OP_IS_NA && pc->op != PX_OP_NOT_NA && pc->num_values != 1) {
+      Rf_error("Filter condition %d needs exactly one value.", c + 1);
+    }
+  }
+  return filter;
+}
+
+px_filter_t* px_filter_clone(const px_filter_t* filter) {
+  px_filter_t* copy = (px_filter_t*) R_alloc(1, sizeof(px_filter_t));
+  *copy = *filter;
+  copy->ibuf = (int*) R_alloc(filter->capacity, sizeof(int));
+  copy->dbuf = (double*) R_alloc(filter->capacity, sizeof(double));
+  return copy;
+}
+
+/**
+ * @brief Evaluates a condition for a decoded value, `NaN` standing for `NA`.
+ */
+static inline int test_number(const px_condition_t* pc, double x) {
+  if (ISNAN(x)) {
+    return pc->op == PX_OP_IS_NA || (pc->op == PX_OP_IN && pc->has_na);
+  }
+  double v = pc->num_values > 0 ? pc->values[0] : NA_REAL;
+  switch (pc->op) {
+  case PX_OP_EQ: return x == v;
+  case PX_OP_NE: return !ISNAN(v) && x != v;
+  case PX_OP_LT: return x < v;
+  case PX_OP_LE: return x <= v;
+  case PX_OP_GT: return x > v;
+  case PX_OP_GE: return x >= v;
+  case PX_OP_IN:
+    for (int k = 0; k < pc->num_values; k++) {
+      if (x == pc->values[k]) return 1;
+    }
+    return 0;
+  case PX_OP_IS_NA: return 0;
+  case PX_OP_NOT_NA: return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Evaluates a condition for an Alpha field, like `px_decode_alpha()` reads it.
+ */
+static inline int test_alpha(const px_condition_t* pc, const char* field) {
+  // A NULL value starts with a zero byte.
+  if (field[0] == '\0') {
+    return pc->op == PX_OP_IS_NA || (pc->op == PX_OP_IN && pc->has_na);
+  }
+  if (pc->op == PX_OP_IS_NA) return 0;
+  if (pc->op == PX_OP_NOT_NA) return 1;
+
+  const char* end = memchr(field, '\0', (size_t) pc->len);
+  int n = end ? (int) (end - field) : pc->len;
+  int found = 0;
+  for (int k = 0; k < pc->num_values && !found; k++) {
+    found = pc->texts[k] != NULL && pc->text_lens[k] == n && memcmp(pc->texts[k], field, (size_t) n) == 0;
+  }
+  if (pc->op == PX_OP_NE) return !found && !pc->has_na;
+  return found;
+}
+
+/**
+ * @brief Evaluates a filter for at most `filter->capacity` records, see `px_filter_block()`.
+ */
+static void filter_records(px_filter_t* filter, const char* records, int n, size_t recordsize, unsigned char* keep) {
+  memset(keep, 1, (size_t) n);
+  for (int c = 0; c < filter->num_conditions; c++) {
+    const px_condition_t* pc = &filter->conditions[c];
+    const char* field = records + pc->offset;
+    if (pc->ftype == pxfAlpha) {
+      for (int i = 0; i < n; i++) {
+        if (keep[i]) keep[i] = (unsigned char) test_alpha(pc, field + (size_t) i * recordsize);
+      }
+      continue;
+    }
+    switch (pc->ftype) {
+    case pxfShort: case pxfLong: case pxfAutoInc: case pxfLogical:
+      px_decode_column(pc->ftype, pc->fdc, field, recordsize, n, filter->ibuf);
+      for (int i = 0; i < n; i++) {
+        int x = filter->ibuf[i];
+        if (keep[i]) keep[i] = (unsigned char) test_number(pc, x == NA_INTEGER ? NA_REAL : (double) x);
+      }
+      break;
+    default:
+      px_decode_column(pc->ftype, pc->fdc, field, recordsize, n, filter->dbuf);
+      for (int i = 0; i < n; i++) {
+        if (keep[i]) keep[i] = (unsigned char) test_number(pc, filter->dbuf[i]);
+      }
+      break;
+    }
+  }
+}
+
+int px_filter_block(px_filter_t* filter, const char* records, int n, size_t recordsize, unsigned char* keep) {
+  for (int first = 0; first < n; first += filter->capacity) {
+    int count = n - first < filter->capacity ? n - first : filter->capacity;
+    filter_records(filter, records + (size_t) first * recordsize, count, recordsize, keep + first);
+  }
+  int passed = 0;
+  for (int i = 0; i < n; i++) {
+    passed += keep[i];
+  }
+  return passed;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file filter.h
+ * @brief Row filters evaluated on the raw record data.
+ */
+
+#ifndef RPARADOX_FILTER_H
+#define RPARADOX_FILTER_H
+
+#include <stddef.h>
+#include <Rinternals.h>
+#include "paradox.h"
+
+typedef struct px_filter px_filter_t;
+
+/**
+ * @brief Creates a filter from the conditions built by `resolve_filter()` in R.
+ *
+ * `conditions_sexp` is a list with one element per condition, all of which
+ * must hold for a record to be kept. Each condition is a list with the 0-based
+ * `field`, the operator `op` (`"=="`, `"!="`, `"<"`, `"<="`, `">"`, `">="`,
+ * `"in"`, `"is_na"` or `"not_na"`) and the `values` to compare with: a double
+ * vector in the R representation of the field for numbers, dates and times,
+ * or a list of raw vectors (`NULL` for `NA`) in the encoding of the file for
+ * Alpha fields. Raises an R error for invalid conditions.
+ *
+ * The filter is allocated with `R_alloc()`, and refers to the vectors in
+ * `conditions_sexp`, which must stay protected while it is used.
+ *
+ * @param pxdoc The open Paradox document.
+ * @param conditions_sexp The list of conditions.
+ * @return The new filter.
+ */
+px_filter_t* px_filter_new(pxdoc_t* pxdoc, SEXP conditions_sexp);
+
+/**
+ * @brief Makes a copy of a filter with scratch buffers of its own.
+ *
+ * A filter cannot be evaluated by several threads at once, but its copies
+ * can, one per thread. The copy is allocated with `R_alloc()` and shares the
+ * conditions of `filter`.
+ *
+ * @param filter The filter.
+ * @return The new filter.
+ */
+px_filter_t* px_filter_clone(const px_filter_t* filter);
+
+/**
+ * @brief Evaluates a filter for consecutive records.
+ *
+ * The fields are decoded like in `px_decode_column()`, so a condition sees
+ * the same value as R does after reading, and comparisons with `NA` are
+ * false. Only plain C is used, so this can run in a block scan callback.
+ *
+ * @param filter The filter.
+ * @param records Raw data of `n` records, `recordsize` bytes apart. `n` must
+ *   not exceed the number of records of a data block.
+ * @param n The number of records.
+ * @param recordsize The size of a record in bytes.
+ * @param keep Receives 1 for each record that passes the filter, 0 otherwise.
+ * @return The number of records that pass.
+ */
+int px_filter_block(px_filter_t* filter, const char* records, int n, size_t recordsize, unsigned char* keep);
+
+#endif /* RPARADOX_FILTER_H */
@@ -0,0 +1,262 @@
+/**
+ * @file generate.c
+ * @brief Generation of synthetic Paradox tables for benchmarks and tests.
+ *
+ * The bundled fixtures are tiny, so read throughput can only be measured on
+ * tables generated on the fly. This writes them with the writer of pxlib
+ * (`PX_create_file()`, `PX_put_record()`, `PX_set_blob_file()`), which
+ * produces the same block layout as Paradox itself. The values come from a
+ * small xorshift generator seeded per record, so a table is reproducible from
+ * its seed and does not depend on R's random number generator.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "paradox.h"
+#include "generate.h"
+
+typedef struct {
+  const char* name;
+  int px_ftype;
+  int px_flen;
+  int px_fdc;
+  int nullable;
+} px_generate_kind_t;
+
+static const px_generate_kind_t kinds_table[] = {
+  {"alpha",     pxfAlpha,      20, 0, 1},
+  {"code",      pxfAlpha,       8, 0, 1},
+  {"short",     pxfShort,       2, 0, 1},
+  {"long",      pxfLong,        4, 0, 1},
+  {"number",    pxfNumber,      8, 0, 1},
+  {"currency",  pxfCurrency,    8, 0, 1},
+  {"bcd",       pxfBCD,        17, 2, 1},
+  {"date",      pxfDate,        4, 0, 1},
+  {"time",      pxfTime,        4, 0, 1},
+  {"timestamp", pxfTimestamp,   8, 0, 1},
+  {"logical",   pxfLogical,     1, 0, 1},
+  {"autoinc",   pxfAutoInc,     4, 0, 0},
+  {"bytes",     pxfBytes,       8, 0, 0},
+  {"memo",      pxfMemoBLOb,   20, 0, 1},
+  {"blob",      pxfBLOb,       20, 0, 1}
+};
+
+#define NUM_KINDS ((int) (sizeof(kinds_table) / sizeof(kinds_table[0])))
+
+// Words of the text fields, some with CP1252 characters so that recoding is measured.
+static const char* words[] = {
+  "Grouper", "Wrasse", "Snapper", "Angelfish", "Butterfly", "Triggerfish", "Moray",
+  "Barracuda", "Sp\xe4ter", "M\xfchle", "Caf\xe9", "Ray", "Shark", "Tuna", "Cod", "Eel"
+};
+static const char* codes[] = {
+  "ALPHA", "BRAVO", "CHARLIE", "DELTA", "ECHO", "FOXTROT",
+  "GOLF", "HOTEL", "INDIA", "JULIETT", "KILO", "LIMA"
+};
+
+int px_generate_kind(const char* name) {
+  for (int k = 0; k < NUM_KINDS; k++) {
+    if (strcmp(kinds_table[k].name, name) == 0) return k;
+  }
+  return -1;
+}
+
+// xorshift32, never 0 once seeded with a non-zero state.
+static unsigned int next_random(unsigned int* state) {
+  unsigned int x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+// A pseudo-random number in [0, 1).
+static double next_unit(unsigned int* state) {
+  return next_random(state) / 4294967296.0;
+}
+
+/**
+ * @brief Fills `buffer` with a memo text or BLOB of 16 bytes to 4 KB.
+ * @return The length of the value.
+ */
+static int make_blob(unsigned int* state, char* buffer, int text) {
+  int len = 16 + (int) (next_random(state) % 4080);
+  for (int i = 0; i < len; i++) {
+    buffer[i] = text ? (i % 8 == 7 ? ' ' : 'a' + (char) (next_random(state) % 26))
+                     : (char) next_random(state);
+  }
+  return len;
+}
+
+/**
+ * @brief Writes the value of field `k` of record `recno` at `data`.
+ * @return 0 on success, -1 if the BLOB could not be written.
+ */
+static int put_value(pxdoc_t* pxdoc, const px_generate_kind_t* kind, char* data, int recno,
+                     unsigned int* state, const px_generate_options_t* options, char* blob) {
+  char text[64];
+  int len = kind->px_flen;
+
+  // NULL values are left as the zero bytes of the record
+  if (kind->nullable && kind->px_ftype != pxfMemoBLOb && kind->px_ftype != pxfBLOb &&
+      next_unit(state) < options->null_rate) {
+    return 0;
+  }
+
+  switch (kind->px_ftype) {
+  case pxfAlpha:
+    if (len == 8) {
+      PX_put_data_alpha(pxdoc, data, len, (char*) codes[next_random(state) % 12]);
+    } else {
+      snprintf(text, sizeof(text), "%s %d", words[next_random(state) % 16], recno);
+      PX_put_data_alpha(pxdoc, data, len, text);
+    }
+    break;
+  case pxfShort:
+    PX_put_data_short(pxdoc, data, len, (short) ((int) (next_random(state) % 60001) - 30000));
+    break;
+  case pxfLong:
+    PX_put_data_long(pxdoc, data, len, (int) (next_random(state) % 2000000001u) - 1000000000);
+    break;
+  case pxfAutoInc:
+    PX_put_data_long(pxdoc, data, len, recno + 1);
+    break;
+  case pxfNumber:
+    PX_put_data_double(pxdoc, data, len, (next_unit(state) - 0.5) * 1e6);
+    break;
+  case pxfCurrency:
+    PX_put_data_double(pxdoc, data, len, (double) ((int) (next_random(state) % 20000001) - 10000000) / 100.0);
+    break;
+  case pxfBCD: {
+    unsigned int value = next_random(state);
+    snprintf(text, sizeof(text), "%s%u.%02u", value & 1 ? "-" : "", value / 100, value % 100);
+    PX_put_data_bcd(pxdoc, data, kind->px_fdc, text);
+    break;
+  }
+  case pxfDate:
+    // Days since 1 January of year 1, from 1900 to about 2010
+    PX_put_data_long(pxdoc, data, len, 693596 + (int) (next_random(state) % 40000));
+    break;
+  case pxfTime:
+    PX_put_data_long(pxdoc, data, len, (int) (next_random(state) % 86400) * 1000);
+    break;
+  case pxfTimestamp:
+    PX_put_data_double(pxdoc, data, len,
+                       (693596.0 + next_random(state) % 40000) * 86400000.0 +
+                       (double) (next_random(state) % 86400) * 1000.0);
+    break;
+  case pxfLogical:
+    PX_put_data_byte(pxdoc, data, len, (char) (next_random(state) & 1));
+    break;
+  case pxfBytes:
+    for (int i = 0; i < len; i++) data[i] = (char) next_random(state);
+    break;
+  case pxfMemoBLOb:
+  case pxfBLOb:
+    if (next_unit(state) < options->blob_rate) {
+      int blob_len = make_blob(state, blob, kind->px_ftype == pxfMemoBLOb);
+      if (PX_put_data_blob(pxdoc, data, len, blob, blob_len) < 0) return -1;
+    }
+    break;
+  }
+  return 0;
+}
+
+int px_generate_table(const char* path, const char* blob_path, const int* kinds, int num_fields,
+                      const px_generate_options_t* options, char* message, size_t message_len) {
+  int has_blobs = 0;
+  for (int j = 0; j < num_fields; j++) {
+    int t = kinds_table[kinds[j]].px_ftype;
+    if (t == pxfMemoBLOb || t == pxfBLOb) has_blobs = 1;
+  }
+  // pxlib writes the .mb file unencrypted, so it could not be read back
+  if (has_blobs && options->password != NULL) {
+    snprintf(message, message_len, "Memo and BLOB fields cannot be written to encrypted tables.");
+    return -1;
+  }
+
+  pxdoc_t* pxdoc = PX_new();
+  if (pxdoc == NULL) {
+    snprintf(message, message_len, "Could not allocate the Paradox document.");
+    return -1;
+  }
+
+  // --- Step 1: Create the file with its fields ---
+  // pxlib takes over the field definitions and frees them on PX_delete()
+  pxfield_t* fields = (pxfield_t*) pxdoc->malloc(pxdoc, num_fields * sizeof(pxfield_t),
+                                                 "Allocate memory for field definitions.");
+  if (fields == NULL) {
+    PX_delete(pxdoc);
+    snprintf(message, message_len, "Could not allocate the field definitions.");
+    return -1;
+  }
+  for (int j = 0; j < num_fields; j++) {
+    const px_generate_kind_t* kind = &kinds_table[kinds[j]];
+    char name[32];
+    snprintf(name, sizeof(name), "%s_%d", kind->name, j + 1);
+    fields[j].px_fname = (char*) pxdoc->malloc(pxdoc, strlen(name) + 1, "Allocate memory for field name.");
+    if (fields[j].px_fname) strcpy(fields[j].px_fname, name);
+    fields[j].px_ftype = kind->px_ftype;
+    fields[j].px_flen = kind->px_flen;
+    fields[j].px_fdc = kind->px_fdc;
+  }
+  if (PX_create_file(pxdoc, fields, num_fields, path, pxfFileTypNonIndexDB) < 0) {
+    // The header, which would own the fields, has not been set up
+    for (int j = 0; j < num_fields; j++) {
+      if (fields[j].px_fname) pxdoc->free(pxdoc, fields[j].px_fname);
+    }
+    pxdoc->free(pxdoc, fields);
+    PX_delete(pxdoc);
+    snprintf(message, message_len, "Could not create the file: %s", path);
+    return -1;
+  }
+
+  // --- Step 2: Set the block size, encryption and blob file ---
+  int status = 0;
+  if (options->block_size > 0 && PX_set_value(pxdoc, "maxtablesize", (float) options->block_size) < 0) {
+    snprintf(message, message_len, "A block size of %d KB is not possible for records of %d bytes.",
+             options->block_size, PX_get_recordsize(pxdoc));
+    status = -1;
+  } else if (options->password != NULL && PX_set_parameter(pxdoc, "password", options->password) < 0) {
+    snprintf(message, message_len, "Could not encrypt the table.");
+    status = -1;
+  } else if (has_blobs && PX_set_blob_file(pxdoc, blob_path) < 0) {
+    snprintf(message, message_len, "Could not create the blob file: %s", blob_path);
+    status = -1;
+  }
+
+  // --- Step 3: Write the records ---
+  int recordsize = PX_get_recordsize(pxdoc);
+  char* record = status == 0 ? (char*) malloc(recordsize) : NULL;
+  char* blob = status == 0 ? (char*) malloc(4096) : NULL;
+  if (status == 0 && (record == NULL || blob == NULL)) {
+    snprintf(message, message_len, "Could not allocate memory for a record.");
+    status = -1;
+  }
+  for (int recno = 0; status == 0 && recno < options->num_records; recno++) {
+    unsigned int state = (options->seed ^ (unsigned int) recno * 2654435761u) | 1u;
+    for (int k = 0; k < 4; k++) next_random(&state);
+    memset(record, 0, recordsize);
+    int offset = 0;
+    for (int j = 0; j < num_fields && status == 0; j++) {
+      const px_generate_kind_t* kind = &kinds_table[kinds[j]];
+      if (put_value(pxdoc, kind, record + offset, recno, &state, options, blob) < 0) {
+        snprintf(message, message_len, "Could not write the BLOB of record %d.", recno + 1);
+        status = -1;
+      }
+      offset += kind->px_flen;
+    }
+    if (status == 0 && PX_put_record(pxdoc, record) < 0) {
+      snprintf(message, message_len, "Could not write record %d.", recno + 1);
+      status = -1;
+    }
+  }
+  free(record);
+  free(blob);
+
+  // --- Step 4: Close the files ---
+  // PX_close() closes the blob file as well
+  PX_close(pxdoc);
+  PX_delete(pxdoc);
+  return status;
+}
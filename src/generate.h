@@ -0,0 +1,57 @@
+/**
+ * @file generate.h
+ * @brief Generation of synthetic Paradox tables for benchmarks and tests.
+ */
+
+#ifndef RPARADOX_GENERATE_H
+#define RPARADOX_GENERATE_H
+
+#include <stddef.h>
+
+/**
+ * @brief The layout and contents of a generated table.
+ */
+typedef struct {
+  int num_records;      // The number of records to write.
+  int block_size;       // The size of the data blocks in KB, or 0 for pxlib's default.
+  const char* password; // The password to encrypt the table with, or NULL.
+  double null_rate;     // The fraction of NULL values in the fields that may be NULL.
+  double blob_rate;     // The fraction of memo and BLOB values that are not NULL.
+  unsigned int seed;    // Seed of the pseudo-random values, the same seed gives the same table.
+} px_generate_options_t;
+
+/**
+ * @brief Returns the index of a field kind, or -1 if there is none of that name.
+ *
+ * The kinds are `"alpha"` (Alpha of 20 characters), `"code"` (Alpha of 8
+ * characters with a dozen distinct values), `"short"`, `"long"`, `"number"`,
+ * `"currency"`, `"bcd"` (two decimal places), `"date"`, `"time"`,
+ * `"timestamp"`, `"logical"`, `"autoinc"`, `"bytes"` (8 bytes), `"memo"` and
+ * `"blob"`.
+ */
+int px_generate_kind(const char* name);
+
+/**
+ * @brief Writes a table of pseudo-random records with pxlib's writer.
+ *
+ * The fields are named after their kind and position, e.g. `long_3`. The
+ * values of a record only depend on the seed and the record number. Memo and
+ * BLOB values of 16 bytes to 4 KB are written to `blob_path`, so both
+ * sub-allocated and whole blocks of the `.mb` file are used.
+ *
+ * No R API is used here.
+ *
+ * @param path The path of the `.db` file to create.
+ * @param blob_path The path of the `.mb` file to create. Only used if there
+ *   are memo or BLOB fields.
+ * @param kinds The kinds of the fields, see `px_generate_kind()`.
+ * @param num_fields The number of fields.
+ * @param options The number of records and how they are stored.
+ * @param message Receives a description of the error, if any.
+ * @param message_len The size of `message`.
+ * @return 0 on success, -1 on error.
+ */
+int px_generate_table(const char* path, const char* blob_path, const int* kinds, int num_fields,
+                      const px_generate_options_t* options, char* message, size_t message_len);
+
+#endif /* RPARADOX_GENERATE_H */
@@ -7,21 +7,63 @@
  * The following functions are declared in src/interface.c
  * and are exposed to R via .Call.
  */
-extern SEXP pxlib_open_file_c(SEXP filename_sexp, SEXP password_sexp);
+extern SEXP pxlib_open_file_c(SEXP filename_sexp, SEXP password_sexp, SEXP mmap_sexp, SEXP defer_index_sexp);
 extern SEXP pxlib_close_file_c(SEXP pxdoc_extptr);
-extern SEXP pxlib_get_data_c(SEXP pxdoc_extptr);
-extern SEXP pxlib_set_blob_file_c(SEXP pxdoc_extptr, SEXP blob_filename_sexp);
+extern SEXP pxlib_get_data_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP skip_sexp, SEXP n_max_sexp,
+                             SEXP threads_sexp, SEXP factors_sexp, SEXP lazy_blobs_sexp,
+                             SEXP filter_sexp, SEXP bcd_text_sexp, SEXP int_dates_sexp);
+extern SEXP pxlib_get_lazy_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP skip_sexp, SEXP n_max_sexp,
+                             SEXP bcd_text_sexp, SEXP int_dates_sexp, SEXP recode_sexp);
+extern SEXP pxlib_read_many_c(SEXP pxdocs_sexp, SEXP threads_sexp, SEXP factors_sexp, SEXP bcd_text_sexp);
+extern SEXP pxlib_read_chunk_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP n_sexp);
+extern SEXP pxlib_read_since_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP token_sexp);
+extern SEXP pxlib_read_arrow_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP n_sexp, SEXP names_sexp,
+                               SEXP bcd_text_sexp);
+extern SEXP pxlib_fetch_blobs_c(SEXP pxdoc_extptr, SEXP field_sexp, SEXP recno_sexp, SEXP offset_sexp,
+                                SEXP index_sexp, SEXP size_sexp, SEXP mod_nr_sexp);
+extern SEXP pxlib_set_blob_file_c(SEXP pxdoc_extptr, SEXP blob_filename_sexp, SEXP cache_size_sexp);
+extern SEXP pxlib_set_index_file_c(SEXP pxdoc_extptr, SEXP index_filename_sexp);
+extern SEXP pxlib_lookup_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP from_sexp, SEXP to_sexp,
+                           SEXP factors_sexp, SEXP lazy_blobs_sexp);
+extern SEXP pxlib_get_rows_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP rows_sexp, SEXP factors_sexp,
+                             SEXP lazy_blobs_sexp);
+extern SEXP pxlib_recover_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP status_sexp, SEXP factors_sexp,
+                            SEXP bcd_text_sexp);
+extern SEXP pxlib_aggregate_c(SEXP pxdoc_extptr, SEXP by_sexp, SEXP ops_sexp, SEXP fields_sexp, SEXP count_sexp,
+                              SEXP filter_sexp, SEXP threads_sexp);
 extern SEXP pxlib_get_codepage_c(SEXP pxdoc_extptr);
+extern SEXP pxlib_set_encoding_c(SEXP pxdoc_extptr, SEXP encoding_sexp);
 extern SEXP pxlib_get_metadata_c(SEXP pxdoc_extptr);
+extern SEXP pxlib_set_stats_c(SEXP pxdoc_extptr, SEXP enable_sexp);
+extern SEXP pxlib_get_stats_c(SEXP pxdoc_extptr, SEXP reset_sexp);
+extern SEXP pxlib_generate_table_c(SEXP path_sexp, SEXP blob_path_sexp, SEXP kinds_sexp, SEXP n_records_sexp,
+                                   SEXP block_size_sexp, SEXP password_sexp, SEXP null_rate_sexp,
+                                   SEXP blob_rate_sexp, SEXP seed_sexp);
+extern void px_init_lazy_columns(DllInfo *dll);
 
 // Define the R_CallMethodDef structure to register C functions
 static const R_CallMethodDef CallEntries[] = {
-  {"R_pxlib_open_file", (DL_FUNC) &pxlib_open_file_c, 2},   // "R_pxlib_open_file" is the name R will use for .Call()
+  {"R_pxlib_open_file", (DL_FUNC) &pxlib_open_file_c, 4},   // "R_pxlib_open_file" is the name R will use for .Call()
   {"R_pxlib_close_file", (DL_FUNC) &pxlib_close_file_c, 1}, // "R_pxlib_close_file" is the name R will use for .Call()
-  {"R_pxlib_get_data", (DL_FUNC) &pxlib_get_data_c, 1},
-  {"R_pxlib_set_blob_file", (DL_FUNC) &pxlib_set_blob_file_c, 2},
+  {"R_pxlib_get_data", (DL_FUNC) &pxlib_get_data_c, 10},
+  {"R_pxlib_get_lazy", (DL_FUNC) &pxlib_get_lazy_c, 7},
+  {"R_pxlib_read_many", (DL_FUNC) &pxlib_read_many_c, 4},
+  {"R_pxlib_read_chunk", (DL_FUNC) &pxlib_read_chunk_c, 3},
+  {"R_pxlib_read_since", (DL_FUNC) &pxlib_read_since_c, 3},
+  {"R_pxlib_read_arrow", (DL_FUNC) &pxlib_read_arrow_c, 5},
+  {"R_pxlib_fetch_blobs", (DL_FUNC) &pxlib_fetch_blobs_c, 7},
+  {"R_pxlib_set_blob_file", (DL_FUNC) &pxlib_set_blob_file_c, 3},
+  {"R_pxlib_set_index_file", (DL_FUNC) &pxlib_set_index_file_c, 2},
+  {"R_pxlib_lookup", (DL_FUNC) &pxlib_lookup_c, 6},
+  {"R_pxlib_get_rows", (DL_FUNC) &pxlib_get_rows_c, 5},
+  {"R_pxlib_recover", (DL_FUNC) &pxlib_recover_c, 5},
+  {"R_pxlib_aggregate", (DL_FUNC) &pxlib_aggregate_c, 7},
   {"R_pxlib_get_codepage", (DL_FUNC) &pxlib_get_codepage_c, 1},
+  {"R_pxlib_set_encoding", (DL_FUNC) &pxlib_set_encoding_c, 2},
   {"R_pxlib_get_metadata", (DL_FUNC) &pxlib_get_metadata_c, 1},
+  {"R_pxlib_set_stats", (DL_FUNC) &pxlib_set_stats_c, 2},
+  {"R_pxlib_get_stats", (DL_FUNC) &pxlib_get_stats_c, 2},
+  {"R_pxlib_generate_table", (DL_FUNC) &pxlib_generate_table_c, 9},
   {NULL, NULL, 0} // Sentinel for the end of the array
 };
 
@@ -33,4 +75,6 @@ void R_init_Rparadox(DllInfo *dll)
   R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
   // Prevent searching for symbols in the global environment
   R_useDynamicSymbols(dll, FALSE);
+  // Register the ALTREP classes of lazy columns
+  px_init_lazy_columns(dll);
 }
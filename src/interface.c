@@ -18,6 +18,16 @@
 #include <string.h>  // For strcmp, strlen, memcpy
 #include "paradox.h" // pxlib main header, contains pxdoc_t, pxval_t, pxfield_t etc.
 #include "px_crypt.h"
+#include "px_misc.h" // Little-endian helpers for the BLOB leader
+#include "px_io.h"   // Clock of the read statistics
+#include "decode.h"  // Column decode kernels for fixed-width field types
+#include "parallel.h" // Multi-threaded block scan
+#include "filter.h"   // Row filters on the raw record data
+#include "aggregate.h" // Grouped aggregates on the raw record data
+#include "arrow.h"    // Export as Arrow record batches
+#include "generate.h" // Synthetic tables for benchmarks
+#include <R_ext/Rdynload.h>
+#include <R_ext/Altrep.h> // Lazy columns
 
 // Forward declarations for static helper functions.
 // These functions are internal to this file and not exposed to R directly.
@@ -79,9 +89,14 @@ SEXP pxlib_close_file_c(SEXP pxdoc_extptr) {
  *
  * @param filename_sexp An R character string SEXP containing the path to the .DB file.
  * @param password_sexp An R character string SEXP for the password, or R_NilValue.
+ * @param mmap_sexp An R logical SEXP. If `TRUE`, the file is memory mapped
+ *   (see `PX_open_file_mmap()`) instead of being read with stdio.
+ * @param defer_index_sexp An R logical SEXP. If `TRUE`, only the header is
+ *   read, and the index of the data blocks is built on the first access to
+ *   the records (see `PX_load_index()`).
  * @return An R external pointer of class "pxdoc_t" on success, or `R_NilValue` on failure.
  */
-SEXP pxlib_open_file_c(SEXP filename_sexp, SEXP password_sexp) {
+SEXP pxlib_open_file_c(SEXP filename_sexp, SEXP password_sexp, SEXP mmap_sexp, SEXP defer_index_sexp) {
   // Local static variable - created once, visible only in this function
   static SEXP class_pxdoc = NULL;
   if (class_pxdoc == NULL) {
@@ -115,8 +130,14 @@ SEXP pxlib_open_file_c(SEXP filename_sexp, SEXP password_sexp) {
     Rf_error("Failed to allocate new pxdoc_t object via PX_new().");
   }
   
-  // Open file
-  if (PX_open_file(pxdoc, filename) != 0) {
+  // Walking the block list can be put off until the records are read
+  if (asLogical(defer_index_sexp) == TRUE) {
+    PX_set_value(pxdoc, "deferindex", 1);
+  }
+
+  // Open file, optionally through a memory mapping
+  int use_mmap = asLogical(mmap_sexp) == TRUE;
+  if ((use_mmap ? PX_open_file_mmap(pxdoc, filename) : PX_open_file(pxdoc, filename)) != 0) {
     PX_delete(pxdoc);
     Rf_warning("pxlib failed to open file: %s", filename);
     return R_NilValue;
@@ -147,213 +168,2429 @@ SEXP pxlib_open_file_c(SEXP filename_sexp, SEXP password_sexp) {
     // The encryption key is already in px_head->px_encryption
     // px_read() will automatically decrypt blocks when reading
   }
-  // else: file is not encrypted, continue normally
-  
-  // Create an R external pointer to hold the pxdoc_t object
-  // PROTECT ensures the SEXP is not garbage collected prematurely.
-  SEXP pxdoc_extptr = PROTECT(R_MakeExternalPtr(pxdoc, R_NilValue, R_NilValue));
-  R_RegisterCFinalizerEx(pxdoc_extptr, pxdoc_finalizer, TRUE);
-  
-  // Set the S3 class for method dispatch in R (using cached constant)
-  setAttrib(pxdoc_extptr, R_ClassSymbol, class_pxdoc);
-  
-  UNPROTECT(1); // Only pxdoc_extptr
-  return pxdoc_extptr;
+  // else: file is not encrypted, continue normally
+  
+  // Create an R external pointer to hold the pxdoc_t object
+  // PROTECT ensures the SEXP is not garbage collected prematurely.
+  SEXP pxdoc_extptr = PROTECT(R_MakeExternalPtr(pxdoc, R_NilValue, R_NilValue));
+  R_RegisterCFinalizerEx(pxdoc_extptr, pxdoc_finalizer, TRUE);
+  
+  // Set the S3 class for method dispatch in R (using cached constant)
+  setAttrib(pxdoc_extptr, R_ClassSymbol, class_pxdoc);
+  
+  // PX_open_file_mmap() falls back to stdio if the file cannot be mapped.
+  // Warn only now, when the finalizer owns the document.
+  if (use_mmap && pxdoc->px_stream->type != pxfIOMmap) {
+    Rf_warning("Could not memory-map file '%s', reading it without mmap.", filename);
+  }
+  
+  UNPROTECT(1); // Only pxdoc_extptr
+  return pxdoc_extptr;
+}
+
+/**
+ * @brief Extracts the code page from the Paradox file header.
+ *
+ * This function is called from R to retrieve the original encoding,
+ * which will then be used by function in R.
+ *
+ * @param pxdoc_extptr External R pointer to an open Paradox database.
+ * @return R string (SEXP) with the code page name (e.g., "CP866")
+ * or R_NilValue if the code page is not found.
+ */
+SEXP pxlib_get_codepage_c(SEXP pxdoc_extptr) {
+  pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
+  int codepage = pxdoc->px_head->px_doscodepage;
+  
+  if (codepage > 0) {
+    char buffer[30];
+    snprintf(buffer, sizeof(buffer), "CP%d", codepage);
+    return mkString(buffer);
+  }
+  
+  return R_NilValue;
+}
+
+/**
+ * @brief Makes the C code convert all text it reads to UTF-8.
+ *
+ * Sets the source encoding of the open document and `"UTF-8"` as its
+ * target encoding. Alpha and memo fields are then converted while the
+ * records are decoded, through a 256-entry table for single-byte codepages
+ * such as CP866, CP1251 or CP437 and through iconv for all others.
+ *
+ * @param pxdoc_extptr External R pointer to an open Paradox database.
+ * @param encoding_sexp R string with the encoding of the file (e.g., "CP866").
+ * @return A logical SEXP, `TRUE` if the text is converted from now on, or
+ *   `FALSE` if iconv does not know the encoding.
+ */
+SEXP pxlib_set_encoding_c(SEXP pxdoc_extptr, SEXP encoding_sexp) {
+  pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
+
+  if (TYPEOF(encoding_sexp) != STRSXP || LENGTH(encoding_sexp) != 1 ||
+      STRING_ELT(encoding_sexp, 0) == NA_STRING) {
+    Rf_error("Encoding must be a single, non-NA character string.");
+  }
+  const char* encoding = CHAR(STRING_ELT(encoding_sexp, 0));
+
+  // Check the encoding first, so that pxlib does not report unknown ones.
+  Riconv_t cd = Riconv_open("UTF-8", encoding);
+  if (cd == (Riconv_t) -1) {
+    return ScalarLogical(FALSE);
+  }
+  Riconv_close(cd);
+
+  if (PX_set_parameter(pxdoc, "sourceencoding", encoding) < 0) {
+    return ScalarLogical(FALSE);
+  }
+  if (pxdoc->targetencoding == NULL) {
+    return ScalarLogical(PX_set_targetencoding(pxdoc, "UTF-8") == 0);
+  }
+  return ScalarLogical(TRUE);
+}
+
+/**
+ * @brief Associates a BLOB file (.MB) with an open Paradox database.
+ *
+ * Paradox databases can store BLOB (Binary Large Object) data in a separate
+ * .MB file. This function tells pxlib where to find this associated BLOB file.
+ * Reads of the .MB file go through an LRU cache of its 4 KB blocks, which
+ * holds `cache_size_sexp` blocks.
+ *
+ * @param pxdoc_extptr The R external pointer to the open Paradox database.
+ * @param blob_filename_sexp An R character string SEXP with the path to the .MB file.
+ * @param cache_size_sexp An R integer SEXP, the number of blocks to cache (0 disables the cache).
+ * @return A logical SEXP (`TRUE` on success, `FALSE` on failure).
+ */
+SEXP pxlib_set_blob_file_c(SEXP pxdoc_extptr, SEXP blob_filename_sexp, SEXP cache_size_sexp) {
+  pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
+  
+  if (TYPEOF(blob_filename_sexp) != STRSXP || LENGTH(blob_filename_sexp) != 1 || STRING_ELT(blob_filename_sexp, 0) == NA_STRING) {
+    Rf_error("BLOB filename must be a single, non-NA character string.");
+  }
+  const char* blob_filename = CHAR(STRING_ELT(blob_filename_sexp, 0));
+  
+  int cache_size = asInteger(cache_size_sexp);
+  if (cache_size == NA_INTEGER || cache_size < 0) {
+    Rf_error("BLOB cache size must be a non-negative integer.");
+  }
+
+  if (PX_set_blob_file(pxdoc, blob_filename) == 0) {
+    PX_set_value(pxdoc, "mbcachesize", (float) cache_size);
+    return ScalarLogical(TRUE);
+  } else {
+    Rf_warning("pxlib failed to set BLOB file: %s", blob_filename);
+    return ScalarLogical(FALSE);
+  }
+}
+
+/**
+ * @brief Stores a converted value in row `i` of a column created by `pxlib_get_data_c()`.
+ */
+static void set_column_value(SEXP column, R_xlen_t i, SEXP r_val, int j) {
+  switch(TYPEOF(column)) {
+  // For BLOBs (list of raw vectors)
+  case VECSXP:  SET_VECTOR_ELT(column, i, r_val); break;
+  // For character strings
+  case STRSXP:  SET_STRING_ELT(column, i, Rf_isNull(r_val) ? NA_STRING : r_val); break;
+  // For integers
+  case INTSXP:  INTEGER(column)[i] = Rf_isNull(r_val) ? NA_INTEGER : asInteger(r_val); break;
+  // For doubles (numeric, date, time)
+  case REALSXP: REAL(column)[i] = Rf_isNull(r_val) ? NA_REAL : asReal(r_val); break;
+  // For logicals
+  case LGLSXP:  LOGICAL(column)[i] = Rf_isNull(r_val) ? NA_LOGICAL : asLogical(r_val); break;
+  // This case should not be reached with the current logic.
+  default:      Rf_warning("Unhandled R SEXP type for column %d, record %lld.", j + 1, (long long) i + 1); break;
+  }
+}
+
+/**
+ * @brief Columns of a data frame of BLOB references, see `alloc_blob_refs()`.
+ */
+typedef struct {
+  int* recno;     // 1-based record number.
+  double* offset; // Offset of the BLOB in the .MB file.
+  int* index;     // Index of the BLOB within a suballocated block, 0xff otherwise.
+  int* size;      // Size of the BLOB as stored in the leader.
+  int* mod_nr;    // Modification number.
+} px_blob_refs_t;
+
+// Names of the columns of a BLOB reference data frame.
+static const char* blob_ref_names[] = {"field", "recno", "offset", "index", "size", "mod_nr"};
+#define PX_BLOB_REF_COLS 6
+
+/**
+ * @brief Checks whether a Paradox field type keeps its data in the .MB file.
+ */
+static int is_blob_type(int px_ftype) {
+  switch (px_ftype) {
+  case pxfMemoBLOb: case pxfFmtMemoBLOb: case pxfBLOb: case pxfOLE: case pxfGraphic:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/**
+ * @brief Allocates the column of a BLOB field read with `blobs = "lazy"`.
+ *
+ * Instead of the data, the column holds what the 10-byte BLOB leader at the
+ * end of the field says about it: a data frame with the columns `field`
+ * (1-based field position), `recno`, `offset`, `index`, `size` and `mod_nr`.
+ * `pxlib_fetch_blobs_c()` reads the data later on.
+ *
+ * @param field The 0-based position of the field in the table.
+ * @param n The number of rows.
+ * @return The new (unprotected) data frame.
+ */
+static SEXP alloc_blob_refs(int field, int n) {
+  SEXP refs = PROTECT(allocVector(VECSXP, PX_BLOB_REF_COLS));
+  SEXP names = PROTECT(allocVector(STRSXP, PX_BLOB_REF_COLS));
+  for (int k = 0; k < PX_BLOB_REF_COLS; k++) {
+    SET_VECTOR_ELT(refs, k, allocVector(k == 2 ? REALSXP : INTSXP, n));
+    SET_STRING_ELT(names, k, mkChar(blob_ref_names[k]));
+  }
+  int* field_col = INTEGER(VECTOR_ELT(refs, 0));
+  for (int i = 0; i < n; i++) {
+    field_col[i] = field + 1;
+  }
+  setAttrib(refs, R_NamesSymbol, names);
+  SEXP row_names = PROTECT(allocVector(INTSXP, 2));
+  INTEGER(row_names)[0] = NA_INTEGER;
+  INTEGER(row_names)[1] = -n;
+  setAttrib(refs, R_RowNamesSymbol, row_names);
+  SEXP class_name = PROTECT(mkString("data.frame"));
+  setAttrib(refs, R_ClassSymbol, class_name);
+  UNPROTECT(4);
+  return refs;
+}
+
+/**
+ * @brief Stores the leader of a BLOB field as row `i` of a reference data frame.
+ */
+static void store_blob_ref(const px_blob_refs_t* refs, R_xlen_t i, int recno, const char* data, int len) {
+  int leader = len - 10;
+  long ref = get_long_le(&data[leader]);
+  refs->recno[i] = recno + 1;
+  refs->offset[i] = (double) (ref & 0xffffff00);
+  refs->index[i] = (int) (ref & 0xff);
+  refs->size[i] = (int) get_long_le(&data[leader + 4]);
+  refs->mod_nr[i] = (int) get_short_le(&data[leader + 8]);
+}
+
+/**
+ * @brief State shared between `pxlib_get_data_c()` and its block scan callbacks.
+ */
+typedef struct {
+  SEXP data_list;      // List of preallocated column vectors.
+  pxfield_t* fields;   // Field definitions of the table.
+  int num_fields;      // Number of fields (columns).
+  int* offsets;        // Byte offset of each field within a record.
+  void** dest;         // Data pointer of columns with a decode kernel, NULL otherwise.
+  px_decode_plan_t* plan; // Kernel calls that decode the columns in `dest`.
+  int has_generic;     // Whether any column needs the generic per-value path.
+  int* generic;        // The columns on the generic path, in order.
+  int num_generic;     // Number of columns in `generic`.
+  int first_recno;     // Record number stored in row 0 of the columns.
+  const int* recnos;   // Filtered reads: record number of each row, NULL otherwise.
+  int num_filled;      // Number of records written so far.
+  char* staged;        // Parallel scans: raw bytes of the generic fields of all rows.
+  size_t staged_size;  // Number of bytes per row in `staged`.
+  int* staged_offsets; // Byte offset of each generic field within a row of `staged`.
+  px_string_cache_t** caches; // String cache of each Alpha column, NULL otherwise.
+  int** codes;         // Factor codes of Alpha columns read as factors, NULL otherwise.
+  px_blob_refs_t** refs; // Columns of BLOB fields read lazily, NULL otherwise.
+} px_fill_state_t;
+
+/**
+ * @brief Decodes the fields with a column kernel of a run of records.
+ *
+ * Only plain C is used here, so this can run on any thread.
+ *
+ * @param state The fill state.
+ * @param row The row of the first record in the columns.
+ * @param records Raw data of `numrecords` consecutive records.
+ * @param numrecords The number of records.
+ * @param recordsize The size of a record in bytes.
+ */
+static void decode_kernel_fields(px_fill_state_t* state, int row, char* records, int numrecords, size_t recordsize) {
+  // Fixed-width fields: one tight loop per column, or per run of adjacent columns, over the whole block.
+  px_decode_plan_run(state->plan, records, recordsize, numrecords, (size_t) row);
+}
+
+/**
+ * @brief Converts the fields without a column kernel of a run of records.
+ *
+ * The values of `PX_convert_field()` are taken from the arena of `pxdoc`,
+ * which is reset for every record.
+ *
+ * @param pxdoc The Paradox document, needed for strings and blobs.
+ * @param state The fill state.
+ * @param row The row of the first record in the columns.
+ * @param records Raw data of `numrecords` consecutive records.
+ * @param numrecords The number of records.
+ * @param recordsize The distance in bytes between two records in `records`.
+ * @param offsets The byte offset of each field within a record of `records`.
+ */
+static void convert_generic_fields(pxdoc_t* pxdoc, px_fill_state_t* state, int row, char* records,
+                                   int numrecords, size_t recordsize, const int* offsets) {
+  for (int r = 0; r < numrecords; r++) {
+    char* record = records + (size_t) r * recordsize;
+    // The strings and blobs of the previous record are released at once.
+    PX_arena_begin(pxdoc);
+    for (int g = 0; g < state->num_generic; g++) {
+      int j = state->generic[g];
+      // Lazily read BLOB fields only keep their leader.
+      if (state->refs[j] != NULL) {
+        int recno = state->recnos ? state->recnos[row + r] : state->first_recno + row + r;
+        store_blob_ref(state->refs[j], (R_xlen_t) row + r, recno, record + offsets[j], state->fields[j].px_flen);
+        continue;
+      }
+      // Alpha fields are made into CHARSXPs directly from the record data.
+      if (state->caches[j] != NULL) {
+        int level;
+        SEXP r_str = px_decode_alpha(pxdoc, state->caches[j], record + offsets[j], state->fields[j].px_flen, &level);
+        SET_STRING_ELT(VECTOR_ELT(state->data_list, j), (R_xlen_t) row + r, r_str);
+        if (state->codes[j] != NULL) state->codes[j][row + r] = level;
+        continue;
+      }
+      pxval_t val;
+      memset(&val, 0, sizeof(val));
+      PX_convert_field(pxdoc, &state->fields[j], record + offsets[j], &val);
+      // Convert the Paradox value to an R SEXP and place it into the column.
+      SEXP r_val = px_to_sexp(pxdoc, &val, state->fields[j].px_ftype);
+      set_column_value(VECTOR_ELT(state->data_list, j), (R_xlen_t) row + r, r_val, j);
+    }
+  }
+  PX_arena_end(pxdoc);
+}
+
+/**
+ * @brief Callback for `PX_scan_range()` that writes one block of records into the columns.
+ *
+ * Fixed-width fields are decoded with the decode plan of the read,
+ * directly into the column memory. Strings and blobs go through
+ * `PX_convert_field()` and `px_to_sexp()` record by record.
+ *
+ * The callback may raise an R error, as `px_to_sexp()` allocates and its
+ * warnings can be turned into errors. `PX_scan_range()` then does not
+ * return, and the block buffer it allocated is leaked. That only happens
+ * for documents with their own read function; with the builtin `px_read()`
+ * the blocks come from the block cache or the mapping of the document.
+ * The scan position has been advanced by then, so callers keeping it across
+ * reads scan with a copy and store it only on success.
+ *
+ * @param pxdoc The Paradox document being scanned.
+ * @param recno The number of the first record in `records` (0-based).
+ * @param records Raw data of `numrecords` consecutive records.
+ * @param numrecords The number of records in `records`.
+ * @param user_data A pointer to the `px_fill_state_t`.
+ * @return Always 0, to continue the scan.
+ */
+static int fill_block_cb(pxdoc_t* pxdoc, int recno, char* records, int numrecords, void* user_data) {
+  px_fill_state_t* state = (px_fill_state_t*) user_data;
+  size_t recordsize = (size_t) PX_get_recordsize(pxdoc);
+  int row = recno - state->first_recno;
+
+  decode_kernel_fields(state, row, records, numrecords, recordsize);
+  if (state->has_generic) {
+    convert_generic_fields(pxdoc, state, row, records, numrecords, recordsize, state->offsets);
+  }
+  state->num_filled += numrecords;
+  return 0;
+}
+
+/**
+ * @brief Callback for `px_scan_parallel()`, called concurrently by the worker threads.
+ *
+ * Decodes the fixed-width fields like `fill_block_cb()`. The bytes of all other
+ * fields are copied to the staging area, as they need the R API and are
+ * converted on the main thread afterwards. The rows written by different
+ * blocks never overlap.
+ *
+ * @return Always 0, to continue the scan.
+ */
+static int decode_block_cb(pxdoc_t* pxdoc, int recno, char* records, int numrecords, void* user_data) {
+  px_fill_state_t* state = (px_fill_state_t*) user_data;
+  size_t recordsize = (size_t) pxdoc->px_head->px_recordsize;
+  int row = recno - state->first_recno;
+
+  decode_kernel_fields(state, row, records, numrecords, recordsize);
+  if (state->has_generic) {
+    for (int r = 0; r < numrecords; r++) {
+      char* record = records + (size_t) r * recordsize;
+      char* staged = state->staged + (size_t) (row + r) * state->staged_size;
+      for (int g = 0; g < state->num_generic; g++) {
+        int j = state->generic[g];
+        memcpy(staged + state->staged_offsets[j], record + state->offsets[j], state->fields[j].px_flen);
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief A range of primary keys, see `pxlib_lookup_c()`.
+ */
+typedef struct {
+  const char* from;    // Raw key data of the lower bound, NULL for none.
+  const char* to;      // Raw key data of the upper bound, NULL for none.
+  int len;             // Number of bytes compared, the length of the first key field.
+  int use_index;       // Whether the primary index sorts keys in the order of the comparison.
+} px_keyrange_t;
+
+/**
+ * @brief State of the first pass of a filtered read, see `select_block_cb()`.
+ */
+typedef struct {
+  px_filter_t* filter; // NULL if there is no filter.
+  const px_keyrange_t* keys; // NULL if there is no key range.
+  unsigned char* keep; // Filter result of the records of one block.
+  int keep_size;       // Number of records `keep` can hold.
+  size_t recordsize;
+  SEXP storage;        // Protected list holding the vectors behind `records` and `recnos`.
+  char* records;       // Raw data of the selected records, in a raw vector.
+  int* recnos;         // Record numbers of the selected records, in an integer vector.
+  int count;           // Number of selected records.
+  int capacity;        // Number of records `records` and `recnos` can hold.
+  int num_scanned;     // Number of records scanned so far.
+} px_selection_t;
+
+/**
+ * @brief Callback for `PX_scan_range()` that copies the records passing a
+ *   filter and lying in a key range.
+ *
+ * The raw data of the selected records is collected, so that the columns can
+ * be allocated with their final length and filled afterwards. Keys are
+ * compared as raw bytes, which sort like the values of the key field, see
+ * `PX_plan_key_range()`. The data is collected in R vectors, whose allocation
+ * raises an R error if R runs out of memory; they are garbage collected then.
+ *
+ * @return 0 to continue the scan, -1 if a block holds too many records.
+ */
+static int select_block_cb(pxdoc_t* pxdoc, int recno, char* records, int numrecords, void* user_data) {
+  px_selection_t* sel = (px_selection_t*) user_data;
+  if (numrecords > sel->keep_size) return -1;
+  sel->num_scanned += numrecords;
+  int passed = numrecords;
+  if (sel->filter != NULL) {
+    passed = px_filter_block(sel->filter, records, numrecords, sel->recordsize, sel->keep);
+  } else {
+    memset(sel->keep, 1, (size_t) numrecords);
+  }
+  if (sel->keys != NULL) {
+    const px_keyrange_t* keys = sel->keys;
+    for (int r = 0; r < numrecords; r++) {
+      if (!sel->keep[r]) continue;
+      const char* key = records + (size_t) r * sel->recordsize;
+      if ((keys->from && memcmp(key, keys->from, (size_t) keys->len) < 0) ||
+          (keys->to && memcmp(key, keys->to, (size_t) keys->len) > 0)) {
+        sel->keep[r] = 0;
+        passed--;
+      }
+    }
+  }
+  if (passed == 0) return 0;
+
+  for (int r = 0; r < numrecords; r++) {
+    if (!sel->keep[r]) continue;
+    if (sel->count == sel->capacity) {
+      // The selection grows in R vectors, so that it is used without another
+      // copy and the old vectors are garbage collected.
+      int capacity = sel->capacity > 0 ? 2 * sel->capacity : 256;
+      SEXP new_records = allocVector(RAWSXP, (R_xlen_t) capacity * (R_xlen_t) sel->recordsize);
+      SET_VECTOR_ELT(sel->storage, 0, new_records);
+      if (sel->count > 0) memcpy(RAW(new_records), sel->records, (size_t) sel->count * sel->recordsize);
+      sel->records = (char*) RAW(new_records);
+      SEXP new_recnos = allocVector(INTSXP, capacity);
+      SET_VECTOR_ELT(sel->storage, 1, new_recnos);
+      if (sel->count > 0) memcpy(INTEGER(new_recnos), sel->recnos, (size_t) sel->count * sizeof(int));
+      sel->recnos = INTEGER(new_recnos);
+      sel->capacity = capacity;
+    }
+    memcpy(sel->records + (size_t) sel->count * sel->recordsize, records + (size_t) r * sel->recordsize,
+           sel->recordsize);
+    sel->recnos[sel->count++] = recno + r;
+  }
+  return 0;
+}
+
+/**
+ * @brief Resolves the fields requested by `pxlib_get_data_c()`.
+ *
+ * @param pxdoc The open Paradox document.
+ * @param columns_sexp `NULL` for all fields, or an integer vector of 0-based
+ *   field indices in the order they should be returned.
+ * @param num_cols Receives the number of selected fields.
+ * @param offsets Receives an `R_alloc`'ed array with the byte offset of each
+ *   selected field within a record.
+ * @return An `R_alloc`'ed array with the definitions of the selected fields.
+ */
+static pxfield_t* select_fields(pxdoc_t* pxdoc, SEXP columns_sexp, int* num_cols, int** offsets) {
+  int num_fields = PX_get_num_fields(pxdoc);
+  pxfield_t* fields = PX_get_fields(pxdoc);
+  if (fields == NULL) {
+    Rf_error("Could not retrieve field definitions from Paradox file.");
+  }
+
+  // Offsets of all fields, as the record layout is the concatenation of all of them.
+  int* all_offsets = (int*) R_alloc(num_fields > 0 ? num_fields : 1, sizeof(int));
+  for (int j = 0, offset = 0; j < num_fields; j++) {
+    all_offsets[j] = offset;
+    offset += fields[j].px_flen;
+  }
+
+  if (!Rf_isNull(columns_sexp) && TYPEOF(columns_sexp) != INTSXP) {
+    Rf_error("Argument 'columns' must be NULL or an integer vector.");
+  }
+  int n = Rf_isNull(columns_sexp) ? num_fields : LENGTH(columns_sexp);
+  pxfield_t* cols = (pxfield_t*) R_alloc(n > 0 ? n : 1, sizeof(pxfield_t));
+  *offsets = (int*) R_alloc(n > 0 ? n : 1, sizeof(int));
+  for (int k = 0; k < n; k++) {
+    int j = Rf_isNull(columns_sexp) ? k : INTEGER(columns_sexp)[k];
+    if (j == NA_INTEGER || j < 0 || j >= num_fields) {
+      Rf_error("Column index out of range.");
+    }
+    cols[k] = fields[j];
+    (*offsets)[k] = all_offsets[j];
+  }
+  *num_cols = n;
+  return cols;
+}
+
+/**
+ * @brief Returns the R vector type of the column of a field, see `alloc_columns()`.
+ *
+ * @param px_ftype The Paradox type of the field.
+ * @param bcd_text Whether BCD columns hold text.
+ * @param int_dates Whether Date columns hold integers.
+ */
+static SEXPTYPE column_type(int px_ftype, int bcd_text, int int_dates) {
+  switch(px_ftype) {
+  // Binary types are mapped to a VECSXP (list), which will hold raw vectors.
+  case pxfBLOb: case pxfOLE: case pxfGraphic: case pxfBytes:
+    return VECSXP;
+  // Integer types.
+  case pxfShort: case pxfLong: case pxfAutoInc:
+    return INTSXP;
+  // Floating-point types. Dates and times are also stored as doubles.
+  case pxfNumber: case pxfCurrency: case pxfTime: case pxfTimestamp:
+    return REALSXP;
+  // Dates are whole days, which fit into integers at half the memory.
+  case pxfDate:
+    return int_dates ? INTSXP : REALSXP;
+  // BCD is decoded to doubles, or returned as the string made by pxlib.
+  case pxfBCD:
+    return bcd_text ? STRSXP : REALSXP;
+  // Logical type.
+  case pxfLogical:
+    return LGLSXP;
+  // Text types and unhandled types default to character strings.
+  case pxfAlpha: case pxfMemoBLOb: case pxfFmtMemoBLOb: default:
+    return STRSXP;
+  }
+}
+
+/**
+ * @brief Allocates the column vectors of a read, see `read_records()`.
+ *
+ * @param columns_sexp `NULL` for all fields, or the 0-based field indices.
+ * @param fields The definitions of the selected fields.
+ * @param num_fields The number of selected fields.
+ * @param num_records The number of rows.
+ * @param lazy_blobs Whether memo and BLOB columns hold references.
+ * @param bcd_text Whether BCD columns hold text.
+ * @param int_dates Whether Date columns hold integers.
+ * @return An unprotected R list with one vector per field.
+ */
+static SEXP alloc_columns(SEXP columns_sexp, const pxfield_t* fields, int num_fields, int num_records,
+                          int lazy_blobs, int bcd_text, int int_dates) {
+  // data_list will hold all the column vectors. It must be protected from GC.
+  SEXP data_list = PROTECT(allocVector(VECSXP, num_fields));
+  for (int j = 0; j < num_fields; j++) {
+    SEXP column;
+    if (lazy_blobs && is_blob_type(fields[j].px_ftype)) {
+      int field = Rf_isNull(columns_sexp) ? j : INTEGER(columns_sexp)[j];
+      SET_VECTOR_ELT(data_list, j, alloc_blob_refs(field, num_records));
+      continue;
+    }
+    column = PROTECT(allocVector(column_type(fields[j].px_ftype, bcd_text, int_dates), num_records));
+    SET_VECTOR_ELT(data_list, j, column);
+    // The column is now part of data_list, which is protected, so we can unprotect the 'column' variable.
+    UNPROTECT(1);
+  }
+  UNPROTECT(1);
+  return data_list;
+}
+
+/**
+ * @brief Prepares the state filling the columns allocated by `alloc_columns()`.
+ *
+ * Memory is allocated with `R_alloc()`, so it is released when the .Call returns.
+ *
+ * @param state The state to initialize.
+ * @param data_list The columns.
+ * @param fields The definitions of the selected fields.
+ * @param num_fields The number of selected fields.
+ * @param offsets The byte offset of each selected field within a record.
+ * @param first_recno The record number of the first row.
+ * @param recnos The record number of each row of a filtered read, NULL otherwise.
+ * @param num_records The number of rows.
+ * @param factors Whether Alpha columns may become factors.
+ * @param lazy_blobs Whether memo and BLOB columns hold references.
+ */
+static void init_fill_state(px_fill_state_t* state, SEXP data_list, pxfield_t* fields, int num_fields,
+                            int* offsets, int first_recno, const int* recnos, int num_records,
+                            int factors, int lazy_blobs) {
+  state->data_list = data_list;
+  state->fields = fields;
+  state->num_fields = num_fields;
+  state->offsets = offsets;
+  state->dest = (void**) R_alloc(num_fields > 0 ? num_fields : 1, sizeof(void*));
+  state->has_generic = 0;
+  state->generic = (int*) R_alloc(num_fields > 0 ? num_fields : 1, sizeof(int));
+  state->num_generic = 0;
+  state->first_recno = first_recno;
+  state->recnos = recnos;
+  state->num_filled = 0;
+  state->staged = NULL;
+  state->staged_size = 0;
+  state->staged_offsets = (int*) R_alloc(num_fields > 0 ? num_fields : 1, sizeof(int));
+  state->caches = (px_string_cache_t**) R_alloc(num_fields > 0 ? num_fields : 1, sizeof(px_string_cache_t*));
+  state->codes = (int**) R_alloc(num_fields > 0 ? num_fields : 1, sizeof(int*));
+  state->refs = (px_blob_refs_t**) R_alloc(num_fields > 0 ? num_fields : 1, sizeof(px_blob_refs_t*));
+  // The columns of Date fields tell whether they hold doubles or integers.
+  int int_dates = 0;
+  for (int j = 0; j < num_fields; j++) {
+    SEXP column = VECTOR_ELT(data_list, j);
+    if (fields[j].px_ftype == pxfDate && TYPEOF(column) == INTSXP) int_dates = 1;
+    state->staged_offsets[j] = -1;
+    state->caches[j] = NULL;
+    state->codes[j] = NULL;
+    state->refs[j] = NULL;
+    if (lazy_blobs && is_blob_type(fields[j].px_ftype)) {
+      px_blob_refs_t* refs = (px_blob_refs_t*) R_alloc(1, sizeof(px_blob_refs_t));
+      refs->recno = INTEGER(VECTOR_ELT(column, 1));
+      refs->offset = REAL(VECTOR_ELT(column, 2));
+      refs->index = INTEGER(VECTOR_ELT(column, 3));
+      refs->size = INTEGER(VECTOR_ELT(column, 4));
+      refs->mod_nr = INTEGER(VECTOR_ELT(column, 5));
+      state->refs[j] = refs;
+    }
+    if (fields[j].px_ftype == pxfAlpha) {
+      state->caches[j] = px_string_cache_new();
+      if (factors) {
+        state->codes[j] = (int*) R_alloc(num_records > 0 ? num_records : 1, sizeof(int));
+      }
+    }
+    // BCD values read as text take the generic path.
+    if (px_decode_has_kernel(fields[j].px_ftype) && TYPEOF(column) != STRSXP) {
+      switch(TYPEOF(column)) {
+      case REALSXP: state->dest[j] = REAL(column); break;
+      case LGLSXP:  state->dest[j] = LOGICAL(column); break;
+      default:      state->dest[j] = INTEGER(column); break;
+      }
+    } else {
+      state->dest[j] = NULL;
+      state->has_generic = 1;
+      state->generic[state->num_generic++] = j;
+      state->staged_offsets[j] = (int) state->staged_size;
+      state->staged_size += fields[j].px_flen;
+    }
+  }
+  state->plan = px_decode_plan_new(fields, offsets, state->dest, num_fields, int_dates);
+}
+
+/**
+ * @brief Converts the fields staged by `decode_block_cb()` once a parallel scan is done.
+ *
+ * @param pxdoc The Paradox document, needed for strings and blobs.
+ * @param state The fill state.
+ * @param pos The scan position, behind the last record read.
+ */
+static void convert_staged_fields(pxdoc_t* pxdoc, px_fill_state_t* state, const pxscanpos_t* pos) {
+  state->num_filled = pos->recno - state->first_recno;
+  if (state->has_generic) {
+    // This is the second half of decoding the records, counted as such.
+    double start = pxdoc->px_stats != NULL ? px_time_ns() : 0;
+    convert_generic_fields(pxdoc, state, 0, state->staged, state->num_filled,
+                           state->staged_size, state->staged_offsets);
+    if (pxdoc->px_stats != NULL) pxdoc->px_stats->nsdecode += px_time_ns() - start;
+  }
+}
+
+/**
+ * @brief Sets the S3 class of a date/time column for proper R dispatch.
+ *
+ * @param column The column.
+ * @param px_ftype The Paradox type of its field.
+ */
+static void set_column_class(SEXP column, int px_ftype) {
+  // Local static variables - optimize only class vectors
+  // mkString() is already cached by R via CHARSXP pool, so we only optimize allocVector()
+  static SEXP class_hms = NULL;
+  static SEXP class_posixct = NULL;
+
+  // Initialize on first call of this function
+  if (class_hms == NULL) {
+    class_hms = PROTECT(allocVector(STRSXP, 2));
+    SET_STRING_ELT(class_hms, 0, mkChar("hms"));
+    SET_STRING_ELT(class_hms, 1, mkChar("difftime"));
+    R_PreserveObject(class_hms);
+    UNPROTECT(1);
+
+    class_posixct = PROTECT(allocVector(STRSXP, 2));
+    SET_STRING_ELT(class_posixct, 0, mkChar("POSIXct"));
+    SET_STRING_ELT(class_posixct, 1, mkChar("POSIXt"));
+    R_PreserveObject(class_posixct);
+    UNPROTECT(1);
+  }
+
+  switch(px_ftype) {
+  case pxfDate:
+    // mkString already cached by R via CHARSXP pool - leave as is
+    setAttrib(column, R_ClassSymbol, mkString("Date"));
+    break;
+  case pxfTime:
+    // Use cached class vector
+    setAttrib(column, R_ClassSymbol, class_hms);
+    // mkString is cached - leave as is
+    setAttrib(column, install("units"), mkString("secs"));
+    break;
+  case pxfTimestamp:
+    // Use cached class vector
+    setAttrib(column, R_ClassSymbol, class_posixct);
+    // mkString is cached - leave as is
+    setAttrib(column, install("tzone"), mkString("UTC"));
+    break;
+  default: break;
+  }
+}
+
+/**
+ * @brief Completes the columns once all rows are filled: makes factors of
+ *   the Alpha columns with few distinct values and sets the names and classes.
+ *
+ * @param state The fill state.
+ * @param num_records The number of rows.
+ */
+static void finish_columns(const px_fill_state_t* state, int num_records) {
+  // Alpha columns with few distinct values become factors, their codes are already known.
+  for (int j = 0; j < state->num_fields; j++) {
+    if (state->codes[j] == NULL || px_string_cache_size(state->caches[j]) < 0) continue;
+    SEXP factor = PROTECT(allocVector(INTSXP, num_records));
+    if (num_records > 0) {
+      memcpy(INTEGER(factor), state->codes[j], (size_t) num_records * sizeof(int));
+    }
+    SEXP levels = PROTECT(px_string_cache_levels(state->caches[j]));
+    SEXP class_name = PROTECT(mkString("factor"));
+    setAttrib(factor, R_LevelsSymbol, levels);
+    setAttrib(factor, R_ClassSymbol, class_name);
+    SET_VECTOR_ELT(state->data_list, j, factor);
+    UNPROTECT(3);
+  }
+  
+  // Set the column names
+  SEXP col_names = PROTECT(allocVector(STRSXP, state->num_fields));
+  for (int j = 0; j < state->num_fields; j++) {
+    SET_STRING_ELT(col_names, j, mkChar(state->fields[j].px_fname));
+  }
+  // No special class needed for other types.
+  setAttrib(state->data_list, R_NamesSymbol, col_names);
+  
+  // Set special S3 classes for date/time types for proper R dispatch.
+  for (int j = 0; j < state->num_fields; j++) {
+    set_column_class(VECTOR_ELT(state->data_list, j), state->fields[j].px_ftype);
+  }
+  
+  UNPROTECT(1); // Unprotect col_names.
+}
+
+/**
+ * @brief Reads a range of records into an R list of vectors.
+ *
+ * This is the core data retrieval function. It allocates R vectors for each column,
+ * scans the data blocks with `PX_scan_range()` to populate them, and sets
+ * column names and classes.
+ *
+ * Only the fields listed in `columns_sexp` are allocated and decoded; the bytes
+ * of all other fields are skipped, and their BLOBs are never read.
+ *
+ * @param pxdoc The open Paradox document.
+ * @param columns_sexp `NULL` to read all fields, or an integer vector of
+ *   0-based field indices.
+ * @param pos The scan position to start at. It is advanced behind the last record read.
+ * @param n The maximum number of records to read, or a negative value for all
+ *   remaining records.
+ * @param num_threads The number of threads decoding the data blocks. With more
+ *   than one, strings and blobs are converted in a second pass on this thread.
+ * @param factors If non-zero, Alpha columns with at most `PX_STRING_CACHE_MAX`
+ *   distinct values are returned as factors, with the levels in order of
+ *   first appearance.
+ * @param lazy_blobs If non-zero, the .MB file is not read. Memo and BLOB
+ *   columns hold references to their data instead, see `alloc_blob_refs()`.
+ * @param bcd_text If non-zero, BCD columns hold the exact text of the values
+ *   made by `PX_get_data_bcd()`, otherwise they are decoded to doubles.
+ * @param int_dates If non-zero, Date columns hold the days since 1970-01-01 as
+ *   integers instead of doubles.
+ * @param filter_sexp `NULL`, or the conditions of a filter, see
+ *   `px_filter_new()`. Only the records passing the filter are returned. They
+ *   are selected on the raw data of the blocks first, on a single thread, and
+ *   only the selected records are converted.
+ * @param keys NULL, or a range of primary keys. Only the records with a key
+ *   in the range are returned, selected like with a filter. If the document
+ *   has a primary index file, only the blocks it lists for the range are
+ *   read, otherwise all blocks from `pos` on.
+ * @return An R list (`VECSXP`), with named elements representing columns.
+ */
+static SEXP read_records(pxdoc_t* pxdoc, SEXP columns_sexp, pxscanpos_t* pos, int n, int num_threads,
+                         int factors, int lazy_blobs, int bcd_text, int int_dates, SEXP filter_sexp,
+                         const px_keyrange_t* keys) {
+  // The number of rows is whatever remains behind the scan position, capped at n.
+  int num_records = PX_get_num_records(pxdoc) - pos->recno;
+  if (num_records < 0) {
+    num_records = 0;
+  }
+  if (n >= 0 && n < num_records) {
+    num_records = n;
+  }
+  
+  // Only the selected fields become columns (all of them by default).
+  int num_fields;
+  int* offsets;
+  pxfield_t* fields = select_fields(pxdoc, columns_sexp, &num_fields, &offsets);
+
+  // --- Step 0: With a filter or key range, select the records before anything is converted ---
+  int first_recno = pos->recno;
+  int selecting = !Rf_isNull(filter_sexp) || keys != NULL;
+  char* selected = NULL;
+  int* selected_recnos = NULL;
+  SEXP selection = PROTECT(selecting ? allocVector(VECSXP, 2) : R_NilValue);
+  if (selecting) {
+    px_selection_t sel;
+    memset(&sel, 0, sizeof(sel));
+    sel.storage = selection;
+    sel.filter = Rf_isNull(filter_sexp) ? NULL : px_filter_new(pxdoc, filter_sexp);
+    sel.keys = keys;
+    sel.recordsize = (size_t) PX_get_recordsize(pxdoc);
+    sel.keep_size = pxdoc->px_head->px_maxtablesize * 0x400 / (int) sel.recordsize + 1;
+    sel.keep = (unsigned char*) R_alloc(sel.keep_size, 1);
+    int ret;
+    if (keys != NULL && keys->use_index && pxdoc->px_keyindex != NULL) {
+      // The primary index tells which blocks can hold the keys.
+      pxscanblock_t* blocks = NULL;
+      int num_blocks = PX_plan_key_range(pxdoc, keys->from, keys->to, keys->len, &blocks);
+      ret = num_blocks < 0 ? -1 : PX_scan_block_list(pxdoc, blocks, num_blocks, select_block_cb, &sel);
+      if (blocks) pxdoc->free(pxdoc, blocks);
+      num_records = sel.num_scanned;
+    } else {
+      ret = PX_scan_range(pxdoc, pos, num_records, select_block_cb, &sel);
+    }
+    selected = sel.records;
+    selected_recnos = sel.recnos;
+    if (ret != 0) {
+      Rf_error("Failed to read the data blocks of the Paradox file.");
+    }
+    if (sel.num_scanned != num_records) {
+      Rf_error("Failed to retrieve record #%d.", first_recno + sel.num_scanned + 1);
+    }
+    num_records = sel.count;
+  }
+  
+  // --- Step 1: Allocate R vectors (columns) based on Paradox field types ---
+  SEXP data_list = PROTECT(alloc_columns(columns_sexp, fields, num_fields, num_records, lazy_blobs, bcd_text,
+                                         int_dates));
+
+  // --- Step 2: Scan the data blocks and populate the R column vectors. ---
+  // Each data block is read only once; its records are handed to fill_block_cb(),
+  // or to decode_block_cb() on several threads.
+  // R_alloc'ed memory is released automatically when the .Call returns.
+  px_fill_state_t state;
+  init_fill_state(&state, data_list, fields, num_fields, offsets, first_recno, selected_recnos,
+                  num_records, factors, lazy_blobs);
+
+  int ret;
+  if (selecting) {
+    // The selected records have been read already, they are only converted.
+    size_t recordsize = (size_t) PX_get_recordsize(pxdoc);
+    decode_kernel_fields(&state, 0, selected, num_records, recordsize);
+    if (state.has_generic) {
+      convert_generic_fields(pxdoc, &state, 0, selected, num_records, recordsize, state.offsets);
+    }
+    state.num_filled = num_records;
+    ret = 0;
+  } else if (num_threads > 1 && num_records > 0) {
+    // The worker threads cannot create R objects, so they only stage the raw
+    // bytes of strings and blobs, which are converted once all blocks are done.
+    if (state.has_generic) {
+      state.staged = R_alloc((size_t) num_records, (int) state.staged_size);
+    }
+    ret = px_scan_parallel(pxdoc, pos, num_records, num_threads, decode_block_cb, &state);
+    if (ret == 0) {
+      convert_staged_fields(pxdoc, &state, pos);
+    }
+  } else {
+    ret = PX_scan_range(pxdoc, pos, num_records, fill_block_cb, &state);
+  }
+  if (ret != 0) {
+    UNPROTECT(2); // Unprotect data_list and the selection before erroring.
+    Rf_error("Failed to read the data blocks of the Paradox file.");
+  }
+  if (state.num_filled != num_records) {
+    UNPROTECT(2);
+    Rf_error("Failed to retrieve record #%d.", state.num_filled + 1);
+  }
+
+  // --- Step 3: Turn codes into factors, set column names and classes ---
+  finish_columns(&state, num_records);
+
+  UNPROTECT(2); // Unprotect data_list and the selection.
+  return data_list;
+}
+
+/**
+ * @brief Reads records from an open Paradox file into an R list of vectors.
+ *
+ * @param pxdoc_extptr An R external pointer to the open Paradox database.
+ * @param columns_sexp `NULL` to read all fields, or an integer vector of
+ *   0-based field indices.
+ * @param skip_sexp The number of records to skip before reading.
+ * @param n_max_sexp The maximum number of records to read, or a negative value
+ *   to read all remaining records.
+ * @param threads_sexp The number of threads decoding the data blocks.
+ * @param factors_sexp Whether to return Alpha columns with few distinct values as factors.
+ * @param lazy_blobs_sexp Whether to return references instead of the data of
+ *   memo and BLOB fields.
+ * @param filter_sexp `NULL`, or a list of conditions the returned records must
+ *   meet, see `px_filter_new()`.
+ * @param bcd_text_sexp Whether to return BCD columns as text instead of doubles.
+ * @param int_dates_sexp Whether to return Date columns as integers instead of doubles.
+ * @return An R list (`VECSXP`), with named elements representing columns.
+ * Returns `R_NilValue` if the file is empty.
+ */
+SEXP pxlib_get_data_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP skip_sexp, SEXP n_max_sexp,
+                      SEXP threads_sexp, SEXP factors_sexp, SEXP lazy_blobs_sexp, SEXP filter_sexp,
+                      SEXP bcd_text_sexp, SEXP int_dates_sexp) {
+  pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
+  
+  if (PX_get_num_records(pxdoc) <= 0) {
+    return R_NilValue;
+  }
+  
+  int skip = asInteger(skip_sexp);
+  int n_max = asInteger(n_max_sexp);
+  if (skip == NA_INTEGER || skip < 0) {
+    Rf_error("Argument 'skip' must be a non-negative number.");
+  }
+  if (n_max == NA_INTEGER) {
+    n_max = -1;
+  }
+  int threads = asInteger(threads_sexp);
+  if (threads == NA_INTEGER || threads < 1) {
+    Rf_error("Argument 'threads' must be a positive number.");
+  }
+  
+  // A private scan position, so that full reads do not disturb pxlib_read_chunk().
+  pxscanpos_t pos;
+  PX_scan_init(pxdoc, &pos);
+  if (skip > 0 && PX_scan_range(pxdoc, &pos, skip, NULL, NULL) != 0) {
+    Rf_error("Failed to skip records of the Paradox file.");
+  }
+  
+  return read_records(pxdoc, columns_sexp, &pos, n_max, threads, asLogical(factors_sexp) == TRUE,
+                      asLogical(lazy_blobs_sexp) == TRUE, asLogical(bcd_text_sexp) == TRUE,
+                      asLogical(int_dates_sexp) == TRUE, filter_sexp, NULL);
+}
+
+// --- Lazy columns ---
+//
+// With `lazy = TRUE`, columns are ALTREP vectors that only know the field
+// and the range of records they stand for. Their values are read from the
+// file when R asks for them: single elements and regions through a window
+// of PX_LAZY_WINDOW rows, and the whole column once R needs its data
+// pointer, e.g. to modify it. Each column keeps the external pointer of its
+// `pxdoc_t`, so the file stays open as long as any column is alive. Text in
+// an encoding the C code cannot convert is recoded by an R function as it
+// is read, so that building the tibble does not read the whole column.
+
+// Number of rows read at once for single elements and small regions.
+#define PX_LAZY_WINDOW 4096
+
+// Elements of the `data1` list of a lazy column.
+enum { LAZY_PXDOC, LAZY_INFO, LAZY_WINDOW, LAZY_RECODE, LAZY_NUM_SLOTS };
+// Elements of its `LAZY_INFO` integer vector.
+enum { LAZY_FIELD, LAZY_FIRST_RECNO, LAZY_LENGTH, LAZY_BCD_TEXT, LAZY_INT_DATES, LAZY_WINDOW_START,
+       LAZY_NUM_INFO };
+
+static R_altrep_class_t lazy_integer_class;
+static R_altrep_class_t lazy_real_class;
+static R_altrep_class_t lazy_logical_class;
+static R_altrep_class_t lazy_string_class;
+
+/**
+ * @brief Reads rows `start` to `start + n - 1` of a lazy column into an ordinary vector.
+ *
+ * The records go through `read_records()` like those of `pxlib_get_data_c()`,
+ * so the values are exactly the same. Text is then passed through the
+ * recode function of the column, if it has one.
+ */
+static SEXP lazy_read(SEXP x, R_xlen_t start, R_xlen_t n) {
+  SEXP state = R_altrep_data1(x);
+  SEXP pxdoc_extptr = VECTOR_ELT(state, LAZY_PXDOC);
+  if (R_ExternalPtrAddr(pxdoc_extptr) == NULL) {
+    Rf_error("The Paradox file of this lazy column has been closed. "
+             "Read the column before calling pxlib_close_file().");
+  }
+  pxdoc_t* pxdoc = (pxdoc_t*) R_ExternalPtrAddr(pxdoc_extptr);
+  const int* info = INTEGER(VECTOR_ELT(state, LAZY_INFO));
+
+  const void* vmax = vmaxget();
+  pxscanpos_t pos;
+  PX_scan_init(pxdoc, &pos);
+  int skip = info[LAZY_FIRST_RECNO] + (int) start;
+  if (skip > 0 && PX_scan_range(pxdoc, &pos, skip, NULL, NULL) != 0) {
+    Rf_error("Failed to skip records of the Paradox file.");
+  }
+  SEXP columns = PROTECT(ScalarInteger(info[LAZY_FIELD]));
+  SEXP data_list = PROTECT(read_records(pxdoc, columns, &pos, (int) n, 1, 0, 0, info[LAZY_BCD_TEXT],
+                                        info[LAZY_INT_DATES], R_NilValue, NULL));
+  SEXP column = VECTOR_ELT(data_list, 0);
+  vmaxset(vmax);
+  SEXP recode = VECTOR_ELT(state, LAZY_RECODE);
+  if (recode != R_NilValue && TYPEOF(column) == STRSXP) {
+    SEXP call = PROTECT(lang2(recode, column));
+    column = eval(call, R_GlobalEnv);
+    UNPROTECT(1);
+  }
+  UNPROTECT(2);
+  return column;
+}
+
+/**
+ * @brief Returns all values of a lazy column, reading them on first use.
+ */
+static SEXP lazy_materialize(SEXP x) {
+  SEXP data = R_altrep_data2(x);
+  if (data == R_NilValue) {
+    const int* info = INTEGER(VECTOR_ELT(R_altrep_data1(x), LAZY_INFO));
+    data = PROTECT(lazy_read(x, 0, info[LAZY_LENGTH]));
+    R_set_altrep_data2(x, data);
+    // The window is not needed any more.
+    SET_VECTOR_ELT(R_altrep_data1(x), LAZY_WINDOW, R_NilValue);
+    UNPROTECT(1);
+  }
+  return data;
+}
+
+/**
+ * @brief Returns the window of a lazy column holding row `i`, reading it if needed.
+ *
+ * @param x The lazy column, not yet materialized.
+ * @param i The row.
+ * @param start Receives the first row of the window.
+ */
+static SEXP lazy_window(SEXP x, R_xlen_t i, R_xlen_t* start) {
+  SEXP state = R_altrep_data1(x);
+  int* info = INTEGER(VECTOR_ELT(state, LAZY_INFO));
+  SEXP window = VECTOR_ELT(state, LAZY_WINDOW);
+  if (window == R_NilValue || i < info[LAZY_WINDOW_START] || i >= info[LAZY_WINDOW_START] + XLENGTH(window)) {
+    R_xlen_t first = i - i % PX_LAZY_WINDOW;
+    R_xlen_t n = info[LAZY_LENGTH] - first < PX_LAZY_WINDOW ? info[LAZY_LENGTH] - first : PX_LAZY_WINDOW;
+    window = lazy_read(x, first, n);
+    SET_VECTOR_ELT(state, LAZY_WINDOW, window);
+    info[LAZY_WINDOW_START] = (int) first;
+  }
+  *start = info[LAZY_WINDOW_START];
+  return window;
+}
+
+static R_xlen_t lazy_length(SEXP x) {
+  return INTEGER(VECTOR_ELT(R_altrep_data1(x), LAZY_INFO))[LAZY_LENGTH];
+}
+
+static Rboolean lazy_inspect(SEXP x, int pre, int deep, int pvec, void (*inspect_subtree)(SEXP, int, int, int)) {
+  const int* info = INTEGER(VECTOR_ELT(R_altrep_data1(x), LAZY_INFO));
+  Rprintf(" Rparadox lazy column (field %d, %d records, %s)\n", info[LAZY_FIELD] + 1, info[LAZY_LENGTH],
+          R_altrep_data2(x) == R_NilValue ? "not read" : "read");
+  return TRUE;
+}
+
+/**
+ * @brief Returns the data of an ordinary column vector.
+ */
+static void* column_data(SEXP data) {
+  switch(TYPEOF(data)) {
+  case INTSXP:  return INTEGER(data);
+  case REALSXP: return REAL(data);
+  case LGLSXP:  return LOGICAL(data);
+  default:      return (void*) STRING_PTR_RO(data);
+  }
+}
+
+static void* lazy_dataptr(SEXP x, Rboolean writeable) {
+  return column_data(lazy_materialize(x));
+}
+
+static const void* lazy_dataptr_or_null(SEXP x) {
+  SEXP data = R_altrep_data2(x);
+  return data == R_NilValue ? NULL : column_data(data);
+}
+
+/**
+ * @brief Copies a region of a lazy column of fixed-width values into `buf`.
+ *
+ * Regions within the current window are served from it, larger ones are
+ * read as they are.
+ */
+static R_xlen_t lazy_get_region(SEXP x, R_xlen_t i, R_xlen_t n, void* buf, size_t elt_size) {
+  R_xlen_t length = lazy_length(x);
+  if (i >= length) return 0;
+  if (n > length - i) n = length - i;
+  SEXP data = R_altrep_data2(x);
+  if (data != R_NilValue) {
+    memcpy(buf, (char*) column_data(data) + (size_t) i * elt_size, (size_t) n * elt_size);
+  } else if (n <= PX_LAZY_WINDOW / 2) {
+    // A small region may span two windows.
+    for (R_xlen_t k = 0; k < n; ) {
+      R_xlen_t start;
+      SEXP window = lazy_window(x, i + k, &start);
+      R_xlen_t count = start + XLENGTH(window) - (i + k);
+      if (count > n - k) count = n - k;
+      memcpy((char*) buf + (size_t) k * elt_size, (char*) column_data(window) + (size_t) (i + k - start) * elt_size,
+             (size_t) count * elt_size);
+      k += count;
+    }
+  } else {
+    SEXP region = PROTECT(lazy_read(x, i, n));
+    memcpy(buf, column_data(region), (size_t) n * elt_size);
+    UNPROTECT(1);
+  }
+  return n;
+}
+
+static int lazy_integer_elt(SEXP x, R_xlen_t i) {
+  SEXP data = R_altrep_data2(x);
+  if (data != R_NilValue) return INTEGER(data)[i];
+  R_xlen_t start;
+  SEXP window = lazy_window(x, i, &start);
+  return INTEGER(window)[i - start];
+}
+
+static R_xlen_t lazy_integer_get_region(SEXP x, R_xlen_t i, R_xlen_t n, int* buf) {
+  return lazy_get_region(x, i, n, buf, sizeof(int));
+}
+
+static double lazy_real_elt(SEXP x, R_xlen_t i) {
+  SEXP data = R_altrep_data2(x);
+  if (data != R_NilValue) return REAL(data)[i];
+  R_xlen_t start;
+  SEXP window = lazy_window(x, i, &start);
+  return REAL(window)[i - start];
+}
+
+static R_xlen_t lazy_real_get_region(SEXP x, R_xlen_t i, R_xlen_t n, double* buf) {
+  return lazy_get_region(x, i, n, buf, sizeof(double));
+}
+
+static int lazy_logical_elt(SEXP x, R_xlen_t i) {
+  SEXP data = R_altrep_data2(x);
+  if (data != R_NilValue) return LOGICAL(data)[i];
+  R_xlen_t start;
+  SEXP window = lazy_window(x, i, &start);
+  return LOGICAL(window)[i - start];
+}
+
+static R_xlen_t lazy_logical_get_region(SEXP x, R_xlen_t i, R_xlen_t n, int* buf) {
+  return lazy_get_region(x, i, n, buf, sizeof(int));
+}
+
+static SEXP lazy_string_elt(SEXP x, R_xlen_t i) {
+  SEXP data = R_altrep_data2(x);
+  if (data != R_NilValue) return STRING_ELT(data, i);
+  R_xlen_t start;
+  SEXP window = lazy_window(x, i, &start);
+  return STRING_ELT(window, i - start);
+}
+
+static void lazy_string_set_elt(SEXP x, R_xlen_t i, SEXP value) {
+  SET_STRING_ELT(lazy_materialize(x), i, value);
+}
+
+/**
+ * @brief Registers the ALTREP classes of lazy columns, called when the package is loaded.
+ */
+void px_init_lazy_columns(DllInfo* dll) {
+  lazy_integer_class = R_make_altinteger_class("px_lazy_integer", "Rparadox", dll);
+  lazy_real_class = R_make_altreal_class("px_lazy_real", "Rparadox", dll);
+  lazy_logical_class = R_make_altlogical_class("px_lazy_logical", "Rparadox", dll);
+  lazy_string_class = R_make_altstring_class("px_lazy_string", "Rparadox", dll);
+
+  R_altrep_class_t classes[] = {lazy_integer_class, lazy_real_class, lazy_logical_class, lazy_string_class};
+  for (int k = 0; k < 4; k++) {
+    R_set_altrep_Length_method(classes[k], lazy_length);
+    R_set_altrep_Inspect_method(classes[k], lazy_inspect);
+    R_set_altvec_Dataptr_method(classes[k], lazy_dataptr);
+    R_set_altvec_Dataptr_or_null_method(classes[k], lazy_dataptr_or_null);
+  }
+  R_set_altinteger_Elt_method(lazy_integer_class, lazy_integer_elt);
+  R_set_altinteger_Get_region_method(lazy_integer_class, lazy_integer_get_region);
+  R_set_altreal_Elt_method(lazy_real_class, lazy_real_elt);
+  R_set_altreal_Get_region_method(lazy_real_class, lazy_real_get_region);
+  R_set_altlogical_Elt_method(lazy_logical_class, lazy_logical_elt);
+  R_set_altlogical_Get_region_method(lazy_logical_class, lazy_logical_get_region);
+  R_set_altstring_Elt_method(lazy_string_class, lazy_string_elt);
+  R_set_altstring_Set_elt_method(lazy_string_class, lazy_string_set_elt);
+}
+
+/**
+ * @brief Creates the columns of a table without reading its records.
+ *
+ * Every field with a numeric, logical, date/time or text column becomes a
+ * lazy column, see above. The list columns of Bytes, BLOb, OLE and Graphic
+ * fields cannot be deferred; they are read right away, in a single scan.
+ *
+ * @param pxdoc_extptr An R external pointer to the open Paradox database.
+ * @param columns_sexp `NULL` for all fields, or an integer vector of 0-based
+ *   field indices.
+ * @param skip_sexp The number of records to skip.
+ * @param n_max_sexp The maximum number of records, or a negative value for all
+ *   remaining records.
+ * @param bcd_text_sexp Whether to return BCD columns as text instead of doubles.
+ * @param int_dates_sexp Whether to return Date columns as integers instead of doubles.
+ * @param recode_sexp `NULL`, or an R function that converts a character vector
+ *   read from the file to UTF-8. The text columns call it on the values they read.
+ * @return An R list (`VECSXP`), with named elements representing columns.
+ * Returns `R_NilValue` if the file is empty.
+ */
+SEXP pxlib_get_lazy_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP skip_sexp, SEXP n_max_sexp,
+                      SEXP bcd_text_sexp, SEXP int_dates_sexp, SEXP recode_sexp) {
+  pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
+
+  if (PX_get_num_records(pxdoc) <= 0) {
+    return R_NilValue;
+  }
+
+  int skip = asInteger(skip_sexp);
+  int n_max = asInteger(n_max_sexp);
+  if (skip == NA_INTEGER || skip < 0) {
+    Rf_error("Argument 'skip' must be a non-negative number.");
+  }
+  int num_records = PX_get_num_records(pxdoc) - skip;
+  if (num_records < 0) {
+    num_records = 0;
+  }
+  if (n_max != NA_INTEGER && n_max >= 0 && n_max < num_records) {
+    num_records = n_max;
+  }
+  int bcd_text = asLogical(bcd_text_sexp) == TRUE;
+  int int_dates = asLogical(int_dates_sexp) == TRUE;
+  if (!Rf_isNull(recode_sexp) && !Rf_isFunction(recode_sexp)) {
+    Rf_error("Argument 'recode' must be NULL or a function.");
+  }
+
+  int num_fields;
+  int* offsets;
+  pxfield_t* fields = select_fields(pxdoc, columns_sexp, &num_fields, &offsets);
+
+  // --- Step 1: Create the lazy columns, and collect the fields read now ---
+  SEXP data_list = PROTECT(allocVector(VECSXP, num_fields));
+  int* eager_fields = (int*) R_alloc(num_fields > 0 ? num_fields : 1, sizeof(int));
+  int num_eager = 0;
+  for (int j = 0; j < num_fields; j++) {
+    int field = Rf_isNull(columns_sexp) ? j : INTEGER(columns_sexp)[j];
+    R_altrep_class_t altrep_class;
+    switch(column_type(fields[j].px_ftype, bcd_text, int_dates)) {
+    case INTSXP:  altrep_class = lazy_integer_class; break;
+    case REALSXP: altrep_class = lazy_real_class; break;
+    case LGLSXP:  altrep_class = lazy_logical_class; break;
+    case STRSXP:  altrep_class = lazy_string_class; break;
+    default:
+      eager_fields[num_eager++] = field;
+      continue;
+    }
+    SEXP state = PROTECT(allocVector(VECSXP, LAZY_NUM_SLOTS));
+    SET_VECTOR_ELT(state, LAZY_PXDOC, pxdoc_extptr);
+    SET_VECTOR_ELT(state, LAZY_RECODE, recode_sexp);
+    SEXP info = allocVector(INTSXP, LAZY_NUM_INFO);
+    SET_VECTOR_ELT(state, LAZY_INFO, info);
+    INTEGER(info)[LAZY_FIELD] = field;
+    INTEGER(info)[LAZY_FIRST_RECNO] = skip;
+    INTEGER(info)[LAZY_LENGTH] = num_records;
+    INTEGER(info)[LAZY_BCD_TEXT] = bcd_text;
+    INTEGER(info)[LAZY_INT_DATES] = int_dates;
+    INTEGER(info)[LAZY_WINDOW_START] = 0;
+    SEXP column = R_new_altrep(altrep_class, state, R_NilValue);
+    SET_VECTOR_ELT(data_list, j, column);
+    set_column_class(column, fields[j].px_ftype);
+    UNPROTECT(1);
+  }
+
+  // --- Step 2: Read the list columns in one scan ---
+  if (num_eager > 0) {
+    pxscanpos_t pos;
+    PX_scan_init(pxdoc, &pos);
+    if (skip > 0 && PX_scan_range(pxdoc, &pos, skip, NULL, NULL) != 0) {
+      Rf_error("Failed to skip records of the Paradox file.");
+    }
+    SEXP eager = PROTECT(allocVector(INTSXP, num_eager));
+    memcpy(INTEGER(eager), eager_fields, (size_t) num_eager * sizeof(int));
+    SEXP eager_list = PROTECT(read_records(pxdoc, eager, &pos, num_records, 1, 0, 0, bcd_text, 0,
+                                           R_NilValue, NULL));
+    for (int j = 0, k = 0; j < num_fields; j++) {
+      if (VECTOR_ELT(data_list, j) == R_NilValue) {
+        SET_VECTOR_ELT(data_list, j, VECTOR_ELT(eager_list, k++));
+      }
+    }
+    UNPROTECT(2);
+  }
+
+  // --- Step 3: Set the column names ---
+  SEXP col_names = PROTECT(allocVector(STRSXP, num_fields));
+  for (int j = 0; j < num_fields; j++) {
+    SET_STRING_ELT(col_names, j, mkChar(fields[j].px_fname));
+  }
+  setAttrib(data_list, R_NamesSymbol, col_names);
+
+  UNPROTECT(2);
+  return data_list;
+}
+
+/**
+ * @brief Reads all records of several open Paradox files at once.
+ *
+ * The data blocks of all files are decoded by a common pool of threads, see
+ * `px_scan_parallel_jobs()`, so that many small files are read about as fast
+ * as one large one. As with `pxlib_get_data_c()`, strings and blobs are
+ * converted on this thread once all blocks have been read.
+ *
+ * @param pxdocs_sexp An R list of external pointers to open, distinct Paradox databases.
+ * @param threads_sexp The number of threads decoding the data blocks.
+ * @param factors_sexp Whether to return Alpha columns with few distinct values as factors.
+ * @param bcd_text_sexp Whether to return BCD columns as text instead of doubles.
+ * @return An R list with an element for each file: the list of its columns,
+ *   `R_NilValue` if it is empty, or a string with the error message if its
+ *   data blocks could not be read.
+ */
+SEXP pxlib_read_many_c(SEXP pxdocs_sexp, SEXP threads_sexp, SEXP factors_sexp, SEXP bcd_text_sexp) {
+  if (TYPEOF(pxdocs_sexp) != VECSXP) {
+    Rf_error("Argument 'pxdocs' must be a list of Paradox handles.");
+  }
+  int threads = asInteger(threads_sexp);
+  if (threads == NA_INTEGER || threads < 1) {
+    Rf_error("Argument 'threads' must be a positive number.");
+  }
+  int factors = asLogical(factors_sexp) == TRUE;
+  int bcd_text = asLogical(bcd_text_sexp) == TRUE;
+  int num_docs = LENGTH(pxdocs_sexp);
+  for (int i = 0; i < num_docs; i++) {
+    check_pxdoc_ptr(VECTOR_ELT(pxdocs_sexp, i));
+  }
+
+  // --- Step 1: Allocate the columns of every file ---
+  // The columns are protected as elements of the result.
+  SEXP result = PROTECT(allocVector(VECSXP, num_docs));
+  px_scan_job_t* jobs = (px_scan_job_t*) R_alloc(num_docs > 0 ? num_docs : 1, sizeof(px_scan_job_t));
+  px_fill_state_t* states = (px_fill_state_t*) R_alloc(num_docs > 0 ? num_docs : 1, sizeof(px_fill_state_t));
+  pxscanpos_t* positions = (pxscanpos_t*) R_alloc(num_docs > 0 ? num_docs : 1, sizeof(pxscanpos_t));
+  int* job_docs = (int*) R_alloc(num_docs > 0 ? num_docs : 1, sizeof(int));
+  int num_jobs = 0;
+  for (int i = 0; i < num_docs; i++) {
+    pxdoc_t* pxdoc = (pxdoc_t*) R_ExternalPtrAddr(VECTOR_ELT(pxdocs_sexp, i));
+    int num_records = PX_get_num_records(pxdoc);
+    if (num_records <= 0) continue;
+
+    int num_fields;
+    int* offsets;
+    pxfield_t* fields = select_fields(pxdoc, R_NilValue, &num_fields, &offsets);
+    SEXP data_list = alloc_columns(R_NilValue, fields, num_fields, num_records, 0, bcd_text, 0);
+    SET_VECTOR_ELT(result, i, data_list);
+
+    px_fill_state_t* state = &states[num_jobs];
+    init_fill_state(state, data_list, fields, num_fields, offsets, 0, NULL, num_records, factors, 0);
+    // The threads stage the raw bytes of strings and blobs, see read_records().
+    if (threads > 1 && state->has_generic) {
+      state->staged = R_alloc((size_t) num_records, (int) state->staged_size);
+    }
+    PX_scan_init(pxdoc, &positions[num_jobs]);
+    px_scan_job_t* job = &jobs[num_jobs];
+    job->pxdoc = pxdoc;
+    job->pos = &positions[num_jobs];
+    job->maxrecords = num_records;
+    job->callback = threads > 1 ? decode_block_cb : fill_block_cb;
+    job->user_data = state;
+    job_docs[num_jobs++] = i;
+  }
+
+  // --- Step 2: Decode the data blocks of all files ---
+  px_scan_parallel_jobs(jobs, num_jobs, threads);
+
+  // --- Step 3: Convert the staged fields and complete the columns of each file ---
+  for (int k = 0; k < num_jobs; k++) {
+    px_fill_state_t* state = &states[k];
+    if (jobs[k].status == 0 && threads > 1) {
+      convert_staged_fields(jobs[k].pxdoc, state, jobs[k].pos);
+    }
+    if (jobs[k].status != 0 || state->num_filled != jobs[k].maxrecords) {
+      SET_VECTOR_ELT(result, job_docs[k], mkString("Failed to read the data blocks of the Paradox file."));
+      continue;
+    }
+    finish_columns(state, jobs[k].maxrecords);
+  }
+
+  UNPROTECT(1);
+  return result;
+}
+
+/**
+ * @brief Reads the next chunk of records from an open Paradox file.
+ *
+ * The read position is kept in the `pxdoc_t` handle between calls, so
+ * consecutive calls return consecutive slices of the table. It is only
+ * advanced once the chunk has been read, so that a read ending in an R
+ * error can be repeated.
+ *
+ * @param pxdoc_extptr An R external pointer to the open Paradox database.
+ * @param columns_sexp `NULL` to read all fields, or an integer vector of
+ *   0-based field indices.
+ * @param n_sexp The maximum number of records to read.
+ * @return An R list (`VECSXP`), with named elements representing columns.
+ * Returns `R_NilValue` if all records have been read.
+ */
+SEXP pxlib_read_chunk_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP n_sexp) {
+  pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
+  
+  int n = asInteger(n_sexp);
+  if (n == NA_INTEGER || n <= 0) {
+    Rf_error("Argument 'n' must be a positive number.");
+  }
+  
+  if (pxdoc->px_cursor.recno >= PX_get_num_records(pxdoc)) {
+    return R_NilValue;
+  }
+  
+  pxscanpos_t pos = pxdoc->px_cursor;
+  SEXP data_list = PROTECT(read_records(pxdoc, columns_sexp, &pos, n, 1, 0, 0, 0, 0, R_NilValue, NULL));
+  pxdoc->px_cursor = pos;
+  UNPROTECT(1);
+  return data_list;
+}
+
+// --- Incremental reads ---
+
+// Length of the tokens of `pxlib_read_since_c()`: the number of records, the
+// last data block, the number of its records, their checksum and that of the
+// record layout.
+#define PX_SINCE_TOKEN_LEN 5
+
+/**
+ * @brief Checksum of the records passed to `since_checksum_cb()`.
+ */
+typedef struct {
+  unsigned int hash;   // FNV-1a of the record data.
+  int count;           // Number of records hashed.
+} px_since_checksum_t;
+
+// Adds the bytes of `n` to an FNV-1a hash, least significant byte first.
+static unsigned int since_hash_int(unsigned int hash, unsigned int n) {
+  for (int k = 0; k < 4; k++) {
+    hash = (hash ^ ((n >> (8 * k)) & 0xFF)) * 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * @brief Callback for `PX_scan_chain()` that hashes the records of a block.
+ *
+ * @return Always 0, to continue the scan.
+ */
+static int since_checksum_cb(pxdoc_t* pxdoc, int recno, char* records, int numrecords, void* user_data) {
+  px_since_checksum_t* sum = (px_since_checksum_t*) user_data;
+  size_t len = (size_t) numrecords * (size_t) PX_get_recordsize(pxdoc);
+  unsigned int hash = sum->hash;
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ (unsigned char) records[i]) * 16777619u;
+  }
+  sum->hash = hash;
+  sum->count += numrecords;
+  return 0;
+}
+
+/**
+ * @brief Checksum of the header fields that define how records are stored.
+ *
+ * Covers the block and record sizes, the file type, the encryption and the
+ * type and length of every field. Records can only be appended to an earlier
+ * read if none of them has changed.
+ */
+static unsigned int since_layout_checksum(pxdoc_t* pxdoc) {
+  pxhead_t* pxh = pxdoc->px_head;
+  unsigned int hash = 2166136261u;
+  hash = since_hash_int(hash, (unsigned int) pxh->px_recordsize);
+  hash = since_hash_int(hash, (unsigned int) pxh->px_headersize);
+  hash = since_hash_int(hash, (unsigned int) pxh->px_maxtablesize);
+  hash = since_hash_int(hash, (unsigned int) pxh->px_filetype);
+  hash = since_hash_int(hash, (unsigned int) pxh->px_encryption);
+  hash = since_hash_int(hash, (unsigned int) pxh->px_numfields);
+  for (int j = 0; j < pxh->px_numfields; j++) {
+    hash = since_hash_int(hash, (unsigned int) pxh->px_fields[j].px_ftype);
+    hash = since_hash_int(hash, (unsigned int) pxh->px_fields[j].px_flen);
+  }
+  return hash;
+}
+
+/**
+ * @brief Takes the state of the block list for the next incremental read.
+ *
+ * The last data block is taken from the header. It is only recorded if the
+ * block list really ends there; otherwise the token has no last block, and
+ * the next incremental read falls back to a full read.
+ *
+ * @param pxdoc The open Paradox document.
+ * @param token The `PX_SINCE_TOKEN_LEN` values of the token to fill.
+ */
+static void since_token(pxdoc_t* pxdoc, double* token) {
+  pxhead_t* pxh = pxdoc->px_head;
+  token[0] = PX_get_num_records(pxdoc);
+  token[1] = 0;
+  token[2] = 0;
+  token[3] = 0;
+  token[4] = since_layout_checksum(pxdoc);
+  if (pxh->px_numrecords <= 0 || pxh->px_lastblock <= 0) {
+    return;
+  }
+  pxscanpos_t pos;
+  PX_scan_init(pxdoc, &pos);
+  pos.blocknumber = (int) pxh->px_lastblock;
+  px_since_checksum_t sum = {2166136261u, 0};
+  if (PX_scan_chain(pxdoc, &pos, -1, since_checksum_cb, &sum) == 0 && pos.blockcount == 1 &&
+      pos.blocknumber == 0 && sum.count > 0) {
+    token[1] = pxh->px_lastblock;
+    token[2] = sum.count;
+    token[3] = sum.hash;
+  }
+}
+
+/**
+ * @brief Reads the records appended since an incremental read.
+ *
+ * The records of the old last block are compared with the checksum of the
+ * token first. The records behind them are then read by following the block
+ * list from that block, see `PX_scan_chain()`, which neither builds the self
+ * built index nor reads any block before it. The read only counts if the
+ * block list ends with exactly the records the header counts behind those of
+ * the token.
+ *
+ * @param pxdoc The open Paradox document.
+ * @param columns_sexp `NULL` to read all fields, or an integer vector of
+ *   0-based field indices.
+ * @param old The values of the token of the earlier read.
+ * @return The columns with the appended records, or `R_NilValue` if the
+ *   table has not just been appended to since the token was taken.
+ */
+static SEXP read_appended(pxdoc_t* pxdoc, SEXP columns_sexp, const double* old) {
+  int num_records = PX_get_num_records(pxdoc);
+  int old_records = (int) old[0];
+  int last_block = (int) old[1];
+  int last_count = (int) old[2];
+  if (old[4] != (double) since_layout_checksum(pxdoc) || old_records > num_records) {
+    return R_NilValue;
+  }
+
+  // --- Step 1: Find the end of the earlier read ---
+  pxscanpos_t pos;
+  PX_scan_init(pxdoc, &pos);
+  if (old_records == 0) {
+    // Every record is new.
+    return read_records(pxdoc, columns_sexp, &pos, -1, 1, 0, 0, 0, 0, R_NilValue, NULL);
+  }
+  // The old last block must still start with the same records.
+  if (last_block <= 0 || last_count <= 0 || last_count > old_records) {
+    return R_NilValue;
+  }
+  // The records are counted from the old last block on, so that the number of
+  // records in the header does not cut off the blocks behind it.
+  pos.blocknumber = last_block;
+  px_since_checksum_t sum = {2166136261u, 0};
+  if (PX_scan_chain(pxdoc, &pos, last_count, since_checksum_cb, &sum) != 0 ||
+      sum.count != last_count || (double) sum.hash != old[3]) {
+    return R_NilValue;
+  }
+
+  // --- Step 2: Read the records behind them ---
+  int num_appended = num_records - old_records;
+  int num_fields;
+  int* offsets;
+  pxfield_t* fields = select_fields(pxdoc, columns_sexp, &num_fields, &offsets);
+  SEXP data_list = PROTECT(alloc_columns(columns_sexp, fields, num_fields, num_appended, 0, 0, 0));
+  px_fill_state_t state;
+  init_fill_state(&state, data_list, fields, num_fields, offsets, last_count, NULL, num_appended, 0, 0);
+  int ret = num_appended > 0 ? PX_scan_chain(pxdoc, &pos, num_appended, fill_block_cb, &state) : 0;
+  // A block list that goes on has been changed elsewhere, e.g. by deletes.
+  if (ret != 0 || state.num_filled != num_appended || pos.blocknumber != 0) {
+    UNPROTECT(1);
+    return R_NilValue;
+  }
+  finish_columns(&state, num_appended);
+  UNPROTECT(1); // Unprotect data_list.
+  return data_list;
+}
+
+/**
+ * @brief Reads the records appended to an open Paradox file since an earlier read.
+ *
+ * Without a token, or if the table has been changed otherwise since the token
+ * was taken, e.g. by deletes, inserts into a keyed table or packing, all
+ * records are read. See `read_appended()` for the checks.
+ *
+ * @param pxdoc_extptr An R external pointer to the open Paradox database.
+ * @param columns_sexp `NULL` to read all fields, or an integer vector of
+ *   0-based field indices.
+ * @param token_sexp `NULL`, or the token of an earlier read, a double vector
+ *   of length `PX_SINCE_TOKEN_LEN`.
+ * @return An R list (`VECSXP`), with named elements representing columns. Its
+ *   attribute `px_token` holds the token for the next read, and `px_full`
+ *   whether all records have been read.
+ */
+SEXP pxlib_read_since_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP token_sexp) {
+  pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
+  if (!Rf_isNull(token_sexp) && (TYPEOF(token_sexp) != REALSXP || XLENGTH(token_sexp) != PX_SINCE_TOKEN_LEN)) {
+    Rf_error("Argument 'token' must be a token returned by pxlib_read_since().");
+  }
+
+  // --- Step 1: Read the appended records, or all of them ---
+  SEXP data_list = Rf_isNull(token_sexp) ? R_NilValue : read_appended(pxdoc, columns_sexp, REAL(token_sexp));
+  int full = Rf_isNull(data_list);
+  if (full) {
+    pxscanpos_t pos;
+    PX_scan_init(pxdoc, &pos);
+    data_list = read_records(pxdoc, columns_sexp, &pos, -1, 1, 0, 0, 0, 0, R_NilValue, NULL);
+  }
+  PROTECT(data_list);
+
+  // --- Step 2: Attach the token for the next read ---
+  SEXP token = PROTECT(allocVector(REALSXP, PX_SINCE_TOKEN_LEN));
+  since_token(pxdoc, REAL(token));
+  SEXP names = PROTECT(allocVector(STRSXP, PX_SINCE_TOKEN_LEN));
+  const char* token_names[PX_SINCE_TOKEN_LEN] = {"num_records", "last_block", "last_count", "checksum", "layout"};
+  for (int k = 0; k < PX_SINCE_TOKEN_LEN; k++) {
+    SET_STRING_ELT(names, k, mkChar(token_names[k]));
+  }
+  setAttrib(token, R_NamesSymbol, names);
+  setAttrib(data_list, install("px_token"), token);
+  setAttrib(data_list, install("px_full"), ScalarLogical(full));
+
+  UNPROTECT(3); // Unprotect names, token and data_list.
+  return data_list;
+}
+
+/**
+ * @brief The structures of an exported Arrow record batch, see `pxlib_read_arrow_c()`.
+ */
+typedef struct {
+  struct ArrowSchema schema;
+  struct ArrowArray array;
+  px_arrow_batch_t* batch; // The batch while it is filled, NULL once it is exported.
+} px_arrow_export_t;
+
+/**
+ * @brief Finalizer of an exported record batch.
+ *
+ * A consumer that imported the batch has moved its contents out and left the
+ * structures released. Otherwise the buffers are freed here.
+ */
+static void arrow_export_finalizer(SEXP extptr) {
+  px_arrow_export_t* exported = (px_arrow_export_t*) R_ExternalPtrAddr(extptr);
+  if (exported == NULL) return;
+  if (exported->batch != NULL) px_arrow_batch_free(exported->batch);
+  if (exported->schema.release != NULL) exported->schema.release(&exported->schema);
+  if (exported->array.release != NULL) exported->array.release(&exported->array);
+  free(exported);
+  R_ClearExternalPtr(extptr);
+}
+
+/**
+ * @brief Reads the next chunk of records into an Arrow record batch.
+ *
+ * Like `pxlib_read_chunk_c()`, this reads from the read position kept in the
+ * `pxdoc_t` handle. The records go straight from the data blocks into the
+ * buffers of the batch, see `px_arrow_block_cb()`, without creating R vectors.
+ *
+ * @param pxdoc_extptr An R external pointer to the open Paradox database.
+ * @param columns_sexp `NULL` to read all fields, or an integer vector of
+ *   0-based field indices.
+ * @param n_sexp The maximum number of records to read.
+ * @param names_sexp A character vector with the names of the selected fields.
+ * @param bcd_text_sexp Whether to export BCD fields as text instead of doubles.
+ * @return An R list with an external pointer owning the exported structures,
+ *   and a double vector with the addresses of the `ArrowSchema` and the
+ *   `ArrowArray`. The batch has no rows once all records have been read.
+ */
+SEXP pxlib_read_arrow_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP n_sexp, SEXP names_sexp,
+                        SEXP bcd_text_sexp) {
+  pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
+
+  int n = asInteger(n_sexp);
+  if (n == NA_INTEGER || n <= 0) {
+    Rf_error("Argument 'n' must be a positive number.");
+  }
+  int num_fields;
+  int* offsets;
+  pxfield_t* fields = select_fields(pxdoc, columns_sexp, &num_fields, &offsets);
+  if (TYPEOF(names_sexp) != STRSXP || LENGTH(names_sexp) != num_fields) {
+    Rf_error("Argument 'names' must name every selected field.");
+  }
+  const char** names = (const char**) R_alloc(num_fields > 0 ? num_fields : 1, sizeof(char*));
+  for (int j = 0; j < num_fields; j++) {
+    names[j] = translateCharUTF8(STRING_ELT(names_sexp, j));
+  }
+
+  int num_records = PX_get_num_records(pxdoc) - pxdoc->px_cursor.recno;
+  if (num_records < 0) {
+    num_records = 0;
+  }
+  if (n < num_records) {
+    num_records = n;
+  }
+
+  // The structures are owned by an external pointer before the batch is
+  // allocated, and the batch by the same pointer until it is exported, so
+  // that both are released even if reading the records raises an R error.
+  px_arrow_export_t* exported = (px_arrow_export_t*) calloc(1, sizeof(px_arrow_export_t));
+  if (exported == NULL) {
+    Rf_error("Could not allocate memory for the record batch.");
+  }
+  SEXP handle = PROTECT(R_MakeExternalPtr(exported, R_NilValue, R_NilValue));
+  R_RegisterCFinalizerEx(handle, arrow_export_finalizer, TRUE);
+  SEXP result = PROTECT(allocVector(VECSXP, 2));
+  SEXP addresses = PROTECT(allocVector(REALSXP, 2));
+  SET_VECTOR_ELT(result, 0, handle);
+  SET_VECTOR_ELT(result, 1, addresses);
+
+  px_arrow_batch_t* batch = px_arrow_batch_new(pxdoc, fields, offsets, num_fields, num_records,
+                                               asLogical(bcd_text_sexp) == TRUE);
+  if (batch == NULL) {
+    UNPROTECT(3);
+    Rf_error("Could not allocate memory for the record batch.");
+  }
+  exported->batch = batch;
+  // Like with pxlib_read_chunk_c(), the read position is only advanced on success.
+  pxscanpos_t pos = pxdoc->px_cursor;
+  int ret = 0;
+  if (num_records > 0) {
+    ret = PX_scan_range(pxdoc, &pos, num_records, px_arrow_block_cb, batch);
+  }
+  if (ret != 0 || px_arrow_batch_length(batch) != num_records) {
+    UNPROTECT(3);
+    Rf_error("Failed to read the data blocks of the Paradox file, or a column of the "
+               "batch holds more than 2 GB. Try fewer records per batch.");
+  }
+  pxdoc->px_cursor = pos;
+  // The export frees the batch in any case.
+  exported->batch = NULL;
+  if (px_arrow_batch_export(batch, names, &exported->schema, &exported->array) != 0) {
+    UNPROTECT(3);
+    Rf_error("Could not allocate memory for the record batch.");
+  }
+
+  // Pointers fit into doubles on all supported platforms, the 'arrow'
+  // package accepts them in this form.
+  REAL(addresses)[0] = (double) (uintptr_t) &exported->schema;
+  REAL(addresses)[1] = (double) (uintptr_t) &exported->array;
+  UNPROTECT(3);
+  return result;
+}
+
+/**
+ * @brief Reads the primary index file (.PX) of an open keyed Paradox table.
+ *
+ * The index is only used by `pxlib_lookup_c()`, to find the data blocks
+ * holding a range of keys. All other reads keep using the index built from
+ * the block list, see `PX_set_key_index_file()`.
+ *
+ * @param pxdoc_extptr The R external pointer to the open Paradox database.
+ * @param index_filename_sexp An R character string SEXP with the path to the .PX file.
+ * @return A logical SEXP (`TRUE` on success, `FALSE` on failure).
+ */
+SEXP pxlib_set_index_file_c(SEXP pxdoc_extptr, SEXP index_filename_sexp) {
+  pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
+
+  if (TYPEOF(index_filename_sexp) != STRSXP || LENGTH(index_filename_sexp) != 1 ||
+      STRING_ELT(index_filename_sexp, 0) == NA_STRING) {
+    Rf_error("Index filename must be a single, non-NA character string.");
+  }
+  const char* index_filename = CHAR(STRING_ELT(index_filename_sexp, 0));
+
+  if (PX_set_key_index_file(pxdoc, index_filename) == 0) {
+    return ScalarLogical(TRUE);
+  }
+  Rf_warning("pxlib failed to read primary index file: %s", index_filename);
+  return ScalarLogical(FALSE);
+}
+
+/**
+ * @brief Converts a key value from R into the raw data of the first key field.
+ *
+ * @param pxdoc The open Paradox document.
+ * @param field The first key field.
+ * @param value_sexp A double in the R representation of the field, or a raw
+ *   vector with text in the encoding of the file for Alpha fields.
+ * @param out Receives `field->px_flen` bytes of key data.
+ */
+static void encode_key(pxdoc_t* pxdoc, const pxfield_t* field, SEXP value_sexp, char* out) {
+  memset(out, 0, (size_t) field->px_flen);
+  if (field->px_ftype == pxfAlpha) {
+    if (TYPEOF(value_sexp) != RAWSXP) {
+      Rf_error("The key of an Alpha field must be a raw vector.");
+    }
+    int len = LENGTH(value_sexp) < field->px_flen ? LENGTH(value_sexp) : field->px_flen;
+    memcpy(out, RAW(value_sexp), (size_t) len);
+    return;
+  }
+  if (TYPEOF(value_sexp) != REALSXP || LENGTH(value_sexp) != 1 || ISNAN(REAL(value_sexp)[0])) {
+    Rf_error("The key must be a single number.");
+  }
+  double v = REAL(value_sexp)[0];
+  // Values beyond the range of an integer field are clamped to it.
+  switch (field->px_ftype) {
+  case pxfShort:
+    PX_put_data_short(pxdoc, out, 2, (short) (v > 32767 ? 32767 : v < -32767 ? -32767 : v));
+    break;
+  case pxfLong: case pxfAutoInc:
+    PX_put_data_long(pxdoc, out, 4, (int) (v > 2147483647.0 ? 2147483647.0 : v < -2147483647.0 ? -2147483647.0 : v));
+    break;
+  case pxfNumber: case pxfCurrency:
+    PX_put_data_double(pxdoc, out, 8, v);
+    break;
+  case pxfDate:
+    PX_put_data_long(pxdoc, out, 4, (int) (v + 719163.0));
+    break;
+  case pxfTime:
+    PX_put_data_long(pxdoc, out, 4, (int) (v * 1000.0 + 0.5));
+    break;
+  case pxfTimestamp:
+    PX_put_data_double(pxdoc, out, 8, (v + 719163.0 * 86400.0) * 1000.0);
+    break;
+  case pxfLogical:
+    PX_put_data_byte(pxdoc, out, 1, (char) (v != 0));
+    break;
+  default:
+    Rf_error("Lookups on a primary key of this field type are not supported.");
+  }
 }
 
 /**
- * @brief Extracts the code page from the Paradox file header.
+ * @brief Reads the records of an open keyed Paradox table within a range of keys.
  *
- * This function is called from R to retrieve the original encoding,
- * which will then be used by function in R.
+ * The range applies to the first field of the primary key. Keys are compared
+ * as stored in the file, which orders numbers, dates and times by value and
+ * text byte by byte. With a primary index file, see
+ * `pxlib_set_index_file_c()`, only the data blocks that can hold keys of the
+ * range are read; without one, all blocks are scanned.
  *
- * @param pxdoc_extptr External R pointer to an open Paradox database.
- * @return R string (SEXP) with the code page name (e.g., "CP866")
- * or R_NilValue if the code page is not found.
+ * @param pxdoc_extptr An R external pointer to the open Paradox database.
+ * @param columns_sexp `NULL` to read all fields, or an integer vector of
+ *   0-based field indices.
+ * @param from_sexp The lower bound of the keys, or `NULL` for none. See
+ *   `encode_key()` for its representation.
+ * @param to_sexp The upper bound of the keys, or `NULL` for none.
+ * @param factors_sexp Whether to return Alpha columns with few distinct values as factors.
+ * @param lazy_blobs_sexp Whether to return references instead of the data of
+ *   memo and BLOB fields.
+ * @return An R list (`VECSXP`), with named elements representing columns.
+ * Returns `R_NilValue` if the file is empty.
  */
-SEXP pxlib_get_codepage_c(SEXP pxdoc_extptr) {
+SEXP pxlib_lookup_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP from_sexp, SEXP to_sexp,
+                    SEXP factors_sexp, SEXP lazy_blobs_sexp) {
   pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
-  int codepage = pxdoc->px_head->px_doscodepage;
-  
-  if (codepage > 0) {
-    char buffer[30];
-    snprintf(buffer, sizeof(buffer), "CP%d", codepage);
-    return mkString(buffer);
+
+  if (pxdoc->px_head->px_primarykeyfields <= 0 || pxdoc->px_head->px_filetype != pxfFileTypIndexDB) {
+    Rf_error("The Paradox table has no primary key.");
   }
-  
-  return R_NilValue;
+  if (PX_get_num_records(pxdoc) <= 0) {
+    return R_NilValue;
+  }
+
+  // Primary key fields come first in the record.
+  pxfield_t* key_field = PX_get_field(pxdoc, 0);
+  px_keyrange_t keys;
+  keys.len = key_field->px_flen;
+  keys.from = NULL;
+  keys.to = NULL;
+  // Text is only sorted byte by byte under the ASCII sort order.
+  keys.use_index = key_field->px_ftype != pxfAlpha || pxdoc->px_head->px_sortorder == 0;
+  if (!Rf_isNull(from_sexp)) {
+    char* from = R_alloc((size_t) keys.len, 1);
+    encode_key(pxdoc, key_field, from_sexp, from);
+    keys.from = from;
+  }
+  if (!Rf_isNull(to_sexp)) {
+    char* to = R_alloc((size_t) keys.len, 1);
+    encode_key(pxdoc, key_field, to_sexp, to);
+    keys.to = to;
+  }
+
+  pxscanpos_t pos;
+  PX_scan_init(pxdoc, &pos);
+  return read_records(pxdoc, columns_sexp, &pos, -1, 1, asLogical(factors_sexp) == TRUE,
+                      asLogical(lazy_blobs_sexp) == TRUE, 0, 0, R_NilValue, &keys);
+}
+
+// --- Random access to records ---
+
+// A requested record of pxlib_get_rows_c() with its place in the result.
+typedef struct {
+  int recno;
+  int i;
+} px_row_request_t;
+
+static int compare_row_requests(const void* a, const void* b) {
+  const px_row_request_t* x = (const px_row_request_t*) a;
+  const px_row_request_t* y = (const px_row_request_t*) b;
+  if (x->recno != y->recno) return x->recno < y->recno ? -1 : 1;
+  return (x->i > y->i) - (x->i < y->i);
+}
+
+// Orders the blocks to read by their position in the file.
+static int compare_scan_blocks(const void* a, const void* b) {
+  const pxscanblock_t* x = (const pxscanblock_t*) a;
+  const pxscanblock_t* y = (const pxscanblock_t*) b;
+  return (x->blocknumber > y->blocknumber) - (x->blocknumber < y->blocknumber);
+}
+
+/**
+ * @brief State of `pxlib_get_rows_c()`, see `fetch_rows_cb()`.
+ */
+typedef struct {
+  const px_row_request_t* requests; // Sorted by record number.
+  int num_requests;
+  size_t recordsize;
+  char* records;       // Raw data of the requested records, in the requested order.
+  int num_fetched;     // Number of requests whose record was found.
+} px_row_fetch_t;
+
+/**
+ * @brief Callback for `PX_scan_block_list()` that copies the requested
+ *   records of a block to their places in the result.
+ *
+ * @return Always 0, to continue the scan.
+ */
+static int fetch_rows_cb(pxdoc_t* pxdoc, int recno, char* records, int numrecords, void* user_data) {
+  px_row_fetch_t* fetch = (px_row_fetch_t*) user_data;
+  // The first request for a record of the block.
+  int lo = 0, hi = fetch->num_requests;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (fetch->requests[mid].recno < recno) lo = mid + 1; else hi = mid;
+  }
+  for (int k = lo; k < fetch->num_requests && fetch->requests[k].recno < recno + numrecords; k++) {
+    const px_row_request_t* req = &fetch->requests[k];
+    memcpy(fetch->records + (size_t) req->i * fetch->recordsize,
+           records + (size_t) (req->recno - recno) * fetch->recordsize, fetch->recordsize);
+    fetch->num_fetched++;
+  }
+  return 0;
 }
+
 /**
- * @brief Associates a BLOB file (.MB) with an open Paradox database.
+ * @brief Reads records by their number, in any order.
  *
- * Paradox databases can store BLOB (Binary Large Object) data in a separate
- * .MB file. This function tells pxlib where to find this associated BLOB file.
+ * The record numbers are sorted and mapped to the data blocks holding them
+ * with `PX_scan_plan()`, which takes the number of records of every block
+ * from the block index without reading it. Each block holding at least one
+ * of the records is then read once, in the order of the blocks in the file,
+ * and the records are converted like those of a filtered read.
  *
- * @param pxdoc_extptr The R external pointer to the open Paradox database.
- * @param blob_filename_sexp An R character string SEXP with the path to the .MB file.
- * @return A logical SEXP (`TRUE` on success, `FALSE` on failure).
+ * @param pxdoc_extptr An R external pointer to the open Paradox database.
+ * @param columns_sexp `NULL` to read all fields, or an integer vector of
+ *   0-based field indices.
+ * @param rows_sexp An integer vector of 0-based record numbers, which may
+ *   repeat.
+ * @param factors_sexp Whether to return Alpha columns with few distinct values as factors.
+ * @param lazy_blobs_sexp Whether to return references instead of the data of
+ *   memo and BLOB fields.
+ * @return An R list (`VECSXP`), with named elements representing columns and
+ *   a row per element of `rows_sexp`.
  */
-SEXP pxlib_set_blob_file_c(SEXP pxdoc_extptr, SEXP blob_filename_sexp) {
+SEXP pxlib_get_rows_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP rows_sexp, SEXP factors_sexp,
+                      SEXP lazy_blobs_sexp) {
   pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
-  
-  if (TYPEOF(blob_filename_sexp) != STRSXP || LENGTH(blob_filename_sexp) != 1 || STRING_ELT(blob_filename_sexp, 0) == NA_STRING) {
-    Rf_error("BLOB filename must be a single, non-NA character string.");
+  if (TYPEOF(rows_sexp) != INTSXP) {
+    Rf_error("Argument 'rows' must be an integer vector.");
   }
-  const char* blob_filename = CHAR(STRING_ELT(blob_filename_sexp, 0));
-  
-  if (PX_set_blob_file(pxdoc, blob_filename) == 0) {
-    return ScalarLogical(TRUE);
-  } else {
-    Rf_warning("pxlib failed to set BLOB file: %s", blob_filename);
-    return ScalarLogical(FALSE);
+  int lazy_blobs = asLogical(lazy_blobs_sexp) == TRUE;
+  int num_fields;
+  int* offsets;
+  pxfield_t* fields = select_fields(pxdoc, columns_sexp, &num_fields, &offsets);
+
+  // --- Step 1: Sort the requests by record number ---
+  int num_rows = LENGTH(rows_sexp);
+  int num_records = PX_get_num_records(pxdoc);
+  int* recnos = INTEGER(rows_sexp);
+  px_row_request_t* requests = (px_row_request_t*) R_alloc(num_rows > 0 ? num_rows : 1, sizeof(px_row_request_t));
+  for (int i = 0; i < num_rows; i++) {
+    if (recnos[i] == NA_INTEGER || recnos[i] < 0 || recnos[i] >= num_records) {
+      Rf_error("Record numbers must be between 1 and %d.", num_records);
+    }
+    requests[i].recno = recnos[i];
+    requests[i].i = i;
+  }
+  qsort(requests, (size_t) num_rows, sizeof(px_row_request_t), compare_row_requests);
+
+  // --- Step 2: Find the blocks of the records and read each of them once ---
+  px_row_fetch_t fetch;
+  fetch.requests = requests;
+  fetch.num_requests = num_rows;
+  fetch.recordsize = (size_t) PX_get_recordsize(pxdoc);
+  fetch.records = R_alloc(num_rows > 0 ? num_rows : 1, (int) fetch.recordsize);
+  fetch.num_fetched = 0;
+  if (num_rows > 0) {
+    pxscanpos_t pos;
+    PX_scan_init(pxdoc, &pos);
+    pxscanblock_t* blocks = NULL;
+    int num_blocks = PX_scan_plan(pxdoc, &pos, -1, &blocks);
+    if (num_blocks < 0) {
+      Rf_error("Failed to locate the data blocks of the Paradox file.");
+    }
+    // Only the blocks holding requested records, and in them only the range of those records.
+    int needed = 0;
+    for (int b = 0, k = 0; b < num_blocks && k < num_rows; b++) {
+      pxscanblock_t block = blocks[b];
+      while (k < num_rows && requests[k].recno < block.recno) k++;
+      if (k == num_rows || requests[k].recno >= block.recno + block.numrecords) continue;
+      int first = requests[k].recno;
+      while (k < num_rows && requests[k].recno < block.recno + block.numrecords) k++;
+      int last = requests[k - 1].recno;
+      blocks[needed].blocknumber = block.blocknumber;
+      blocks[needed].recno = first;
+      blocks[needed].recinblock = block.recinblock + (first - block.recno);
+      blocks[needed].numrecords = last - first + 1;
+      needed++;
+    }
+    qsort(blocks, (size_t) needed, sizeof(pxscanblock_t), compare_scan_blocks);
+    int ret = PX_scan_block_list(pxdoc, blocks, needed, fetch_rows_cb, &fetch);
+    if (blocks) pxdoc->free(pxdoc, blocks);
+    if (ret != 0) {
+      Rf_error("Failed to read the data blocks of the Paradox file.");
+    }
+    if (fetch.num_fetched != num_rows) {
+      Rf_error("Failed to retrieve %d of the requested records.", num_rows - fetch.num_fetched);
+    }
   }
+
+  // --- Step 3: Convert the records like a filtered read ---
+  SEXP data_list = PROTECT(alloc_columns(columns_sexp, fields, num_fields, num_rows, lazy_blobs, 0, 0));
+  px_fill_state_t state;
+  init_fill_state(&state, data_list, fields, num_fields, offsets, 0, recnos, num_rows,
+                  asLogical(factors_sexp) == TRUE, lazy_blobs);
+  if (num_rows > 0) {
+    decode_kernel_fields(&state, 0, fetch.records, num_rows, fetch.recordsize);
+    if (state.has_generic) {
+      convert_generic_fields(pxdoc, &state, 0, fetch.records, num_rows, fetch.recordsize, state.offsets);
+    }
+  }
+  state.num_filled = num_rows;
+  finish_columns(&state, num_rows);
+
+  UNPROTECT(1); // Unprotect data_list.
+  return data_list;
 }
 
 /**
- * @brief Reads all records from an open Paradox file into an R list of vectors.
+ * @brief State of a physical scan of `pxlib_recover_c()`, see `recover_block_cb()`.
+ */
+typedef struct {
+  int keep[3];         // Whether to keep the records of each status.
+  size_t recordsize;
+  char* records;       // malloc'ed raw data of the kept records.
+  int* statuses;       // malloc'ed status of the kept records.
+  int count;           // Number of kept records.
+  int capacity;        // Number of records `records` and `statuses` can hold.
+} px_recovery_t;
+
+/**
+ * @brief Callback for `PX_scan_physical()` that copies the records of the
+ *   requested statuses.
  *
- * This is the core data retrieval function. It allocates R vectors for each column,
- * iterates through records to populate them, and sets column names and classes.
+ * @return 0 to continue the scan, -1 if memory ran out.
+ */
+static int recover_block_cb(pxdoc_t* pxdoc, int blocknumber, int recinblock, int status, char* records,
+                            int numrecords, void* user_data) {
+  px_recovery_t* rec = (px_recovery_t*) user_data;
+  if (status < 0 || status > 2 || !rec->keep[status]) return 0;
+  if (rec->count + numrecords > rec->capacity) {
+    int capacity = rec->capacity > 0 ? 2 * rec->capacity : 256;
+    while (capacity < rec->count + numrecords) capacity *= 2;
+    char* new_records = (char*) realloc(rec->records, (size_t) capacity * rec->recordsize);
+    if (new_records == NULL) return -1;
+    rec->records = new_records;
+    int* new_statuses = (int*) realloc(rec->statuses, (size_t) capacity * sizeof(int));
+    if (new_statuses == NULL) return -1;
+    rec->statuses = new_statuses;
+    rec->capacity = capacity;
+  }
+  memcpy(rec->records + (size_t) rec->count * rec->recordsize, records, (size_t) numrecords * rec->recordsize);
+  for (int r = 0; r < numrecords; r++) {
+    rec->statuses[rec->count++] = status;
+  }
+  return 0;
+}
+
+/**
+ * @brief Reads the records of all data blocks in file order, including
+ *   deleted and orphaned ones.
+ *
+ * The blocks are read from first to last with `PX_scan_physical()` instead
+ * of following the block list. The records of the requested statuses are
+ * copied first and then converted like those of a filtered read. If a block
+ * cannot be read, the records found before it are returned with a warning.
  *
  * @param pxdoc_extptr An R external pointer to the open Paradox database.
- * @return An R list (`VECSXP`), with named elements representing columns.
- * Returns `R_NilValue` if the file is empty.
+ * @param columns_sexp `NULL` to read all fields, or an integer vector of
+ *   0-based field indices.
+ * @param status_sexp A logical vector of length 3, whether to return the live,
+ *   deleted and orphaned records.
+ * @param factors_sexp Whether to return Alpha columns with few distinct values as factors.
+ * @param bcd_text_sexp Whether to return BCD columns as text instead of doubles.
+ * @return An R list (`VECSXP`), with named elements representing columns. Its
+ *   attribute `px_status` holds the status of each record, 0 for live, 1 for
+ *   deleted and 2 for orphaned records.
  */
-SEXP pxlib_get_data_c(SEXP pxdoc_extptr) {
-  // Local static variables - optimize only class vectors
-  // mkString() is already cached by R via CHARSXP pool, so we only optimize allocVector()
-  static SEXP class_hms = NULL;
-  static SEXP class_posixct = NULL;
+SEXP pxlib_recover_c(SEXP pxdoc_extptr, SEXP columns_sexp, SEXP status_sexp, SEXP factors_sexp,
+                     SEXP bcd_text_sexp) {
+  pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
+  if (TYPEOF(status_sexp) != LGLSXP || XLENGTH(status_sexp) != 3) {
+    Rf_error("Argument 'status' must be a logical vector of length 3.");
+  }
 
-  // Initialize on first call of this function
-  if (class_hms == NULL) {
-    class_hms = PROTECT(allocVector(STRSXP, 2));
-    SET_STRING_ELT(class_hms, 0, mkChar("hms"));
-    SET_STRING_ELT(class_hms, 1, mkChar("difftime"));
-    R_PreserveObject(class_hms);
-    UNPROTECT(1);
+  int num_fields;
+  int* offsets;
+  pxfield_t* fields = select_fields(pxdoc, columns_sexp, &num_fields, &offsets);
 
-    class_posixct = PROTECT(allocVector(STRSXP, 2));
-    SET_STRING_ELT(class_posixct, 0, mkChar("POSIXct"));
-    SET_STRING_ELT(class_posixct, 1, mkChar("POSIXt"));
-    R_PreserveObject(class_posixct);
-    UNPROTECT(1);
+  // --- Step 1: Copy the records of all blocks in file order ---
+  px_recovery_t rec;
+  memset(&rec, 0, sizeof(rec));
+  for (int k = 0; k < 3; k++) {
+    rec.keep[k] = LOGICAL(status_sexp)[k] == TRUE;
+  }
+  rec.recordsize = (size_t) PX_get_recordsize(pxdoc);
+  int ret = PX_scan_physical(pxdoc, recover_block_cb, &rec);
+  // The records are moved to memory released when the .Call returns.
+  int num_records = rec.count;
+  char* records = NULL;
+  int* statuses = NULL;
+  if (num_records > 0) {
+    records = R_alloc((size_t) num_records, (int) rec.recordsize);
+    statuses = (int*) R_alloc(num_records, sizeof(int));
+    memcpy(records, rec.records, (size_t) num_records * rec.recordsize);
+    memcpy(statuses, rec.statuses, (size_t) num_records * sizeof(int));
+  }
+  free(rec.records);
+  free(rec.statuses);
+  if (ret != 0) {
+    if (num_records == 0) {
+      Rf_error("Failed to read the data blocks of the Paradox file.");
+    }
+    Rf_warning("Not all data blocks of the Paradox file could be read, returning the %d records found before.",
+               num_records);
+  }
+
+  // --- Step 2: Convert the records like a filtered read ---
+  SEXP data_list = PROTECT(alloc_columns(columns_sexp, fields, num_fields, num_records, 0,
+                                         asLogical(bcd_text_sexp) == TRUE, 0));
+  px_fill_state_t state;
+  init_fill_state(&state, data_list, fields, num_fields, offsets, 0, NULL, num_records,
+                  asLogical(factors_sexp) == TRUE, 0);
+  if (num_records > 0) {
+    decode_kernel_fields(&state, 0, records, num_records, rec.recordsize);
+    if (state.has_generic) {
+      convert_generic_fields(pxdoc, &state, 0, records, num_records, rec.recordsize, state.offsets);
+    }
+  }
+  state.num_filled = num_records;
+  finish_columns(&state, num_records);
+
+  // --- Step 3: Attach the status of each record ---
+  SEXP status = PROTECT(allocVector(INTSXP, num_records));
+  if (num_records > 0) {
+    memcpy(INTEGER(status), statuses, (size_t) num_records * sizeof(int));
   }
+  setAttrib(data_list, install("px_status"), status);
 
+  UNPROTECT(2); // Unprotect status and data_list.
+  return data_list;
+}
+
+// --- Grouped aggregates ---
+
+/**
+ * @brief Computes grouped counts, sums, minimums and maximums in the block scan.
+ *
+ * The records are added to their groups by `px_aggregate_scan()` on the raw
+ * data of the blocks, by several threads if requested, and only records that
+ * pass the filter are counted. The keys are decoded once per group, after
+ * the scan.
+ *
+ * @param pxdoc_extptr An R external pointer to the open Paradox database.
+ * @param by_sexp `NULL`, or an integer vector with the 0-based fields to
+ *   group by.
+ * @param ops_sexp A character vector with the aggregate of each measure,
+ *   `"sum"`, `"min"` or `"max"`.
+ * @param fields_sexp An integer vector with the 0-based field of each measure.
+ * @param count_sexp Whether to return the number of records of each group.
+ * @param filter_sexp `NULL`, or a list of conditions the counted records
+ *   must meet, see `px_filter_new()`.
+ * @param threads_sexp The number of threads reading the data blocks.
+ * @return An R list (`VECSXP`) with a column per key field, the counts in
+ *   `n` and a column per measure, named like `"sum_<field>"`, with a row per
+ *   group in the order of the keys. Without keys, there is a single row.
+ */
+SEXP pxlib_aggregate_c(SEXP pxdoc_extptr, SEXP by_sexp, SEXP ops_sexp, SEXP fields_sexp, SEXP count_sexp,
+                       SEXP filter_sexp, SEXP threads_sexp) {
   pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
-  
+  int threads = asInteger(threads_sexp);
+  if (threads == NA_INTEGER || threads < 1) {
+    Rf_error("Argument 'threads' must be a positive number.");
+  }
+  int with_count = asLogical(count_sexp) == TRUE;
+
+  // --- Step 1: Resolve the aggregate and give every thread a filter of its own ---
+  px_aggregate_t* agg = px_aggregate_new(pxdoc, by_sexp, ops_sexp, fields_sexp);
+  px_filter_t** filters = NULL;
+  if (!Rf_isNull(filter_sexp)) {
+    filters = (px_filter_t**) R_alloc(threads, sizeof(px_filter_t*));
+    filters[0] = px_filter_new(pxdoc, filter_sexp);
+    for (int t = 1; t < threads; t++) {
+      filters[t] = px_filter_clone(filters[0]);
+    }
+  }
+
+  // --- Step 2: Scan all records into groups ---
+  pxscanpos_t pos;
+  PX_scan_init(pxdoc, &pos);
+  int num_scanned = 0;
+  px_groups_t* groups = px_aggregate_scan(pxdoc, agg, &pos, threads, filters, &num_scanned);
+  if (groups == NULL) {
+    Rf_error("Failed to read the data blocks of the Paradox file.");
+  }
   int num_records = PX_get_num_records(pxdoc);
-  int num_fields = PX_get_num_fields(pxdoc);
-  
-  if (num_records <= 0) {
-    return R_NilValue;
+  if (num_scanned != num_records) {
+    px_groups_free(groups);
+    Rf_error("Failed to retrieve record #%d.", num_scanned + 1);
   }
-  
-  pxfield_t* fields = PX_get_fields(pxdoc);
-  if (fields == NULL) {
-    Rf_error("Could not retrieve field definitions from Paradox file.");
+
+  // --- Step 3: Copy the groups in the order of their keys, released when the .Call returns ---
+  int num_keys = Rf_isNull(by_sexp) ? 0 : LENGTH(by_sexp);
+  int num_measures = LENGTH(fields_sexp);
+  size_t key_size = (size_t) px_aggregate_key_size(agg);
+  int num_groups = px_groups_size(groups);
+  int* order = px_groups_order(groups);
+  // Without keys all records form one group, even if there are none.
+  int num_rows = num_keys == 0 ? 1 : num_groups;
+  char* keys = R_alloc(num_rows, key_size > 0 ? (int) key_size : 1);
+  int* counts = (int*) R_alloc(num_rows, sizeof(int));
+  double* values = (double*) R_alloc((size_t) num_rows * (num_measures > 0 ? num_measures : 1), sizeof(double));
+  for (int i = 0; i < num_rows; i++) {
+    int g = i < num_groups ? order[i] : -1;
+    if (key_size > 0) {
+      memcpy(keys + (size_t) i * key_size, px_groups_key(groups, g), key_size);
+    }
+    counts[i] = g >= 0 ? px_groups_count(groups, g) : 0;
+    for (int m = 0; m < num_measures; m++) {
+      values[(size_t) i * num_measures + m] = g >= 0 ? px_groups_value(groups, g, m)
+                                                      : px_aggregate_empty_value(agg, m);
+    }
   }
-  
-  // data_list will hold all the column vectors. It must be protected from GC.
-  SEXP data_list = PROTECT(allocVector(VECSXP, num_fields));
-  
-  // --- Step 1: Allocate R vectors (columns) based on Paradox field types ---
-  for (int j = 0; j < num_fields; j++) {
+  px_groups_free(groups);
+
+  // --- Step 4: Decode the keys and make the columns ---
+  pxfield_t* fields = PX_get_fields(pxdoc);
+  int num_cols = num_keys + with_count + num_measures;
+  SEXP data_list = PROTECT(allocVector(VECSXP, num_cols));
+  SEXP col_names = PROTECT(allocVector(STRSXP, num_cols));
+  int col = 0;
+  for (int k = 0, offset = 0; k < num_keys; k++) {
+    const pxfield_t* field = &fields[INTEGER(by_sexp)[k]];
     SEXP column;
-    // A switch statement determines the appropriate R vector type (SEXP) for each Paradox field.
-    switch(fields[j].px_ftype) {
-    // Binary types are mapped to a VECSXP (list), which will hold raw vectors.
-    case pxfBLOb: case pxfOLE: case pxfGraphic: case pxfBytes:
-      column = PROTECT(allocVector(VECSXP, num_records)); break;
-    // Integer types.
-    case pxfShort: case pxfLong: case pxfAutoInc:
-      column = PROTECT(allocVector(INTSXP, num_records)); break;
-    // Floating-point types. Dates and times are also stored as doubles.
-    case pxfNumber: case pxfCurrency: case pxfDate: case pxfTime: case pxfTimestamp:
-      column = PROTECT(allocVector(REALSXP, num_records)); break;
-    // Logical type.
-    case pxfLogical:
-      column = PROTECT(allocVector(LGLSXP, num_records)); break;
-    // Text types and unhandled types default to character strings.
-    // BCD is returned as a string by pxlib.
-    case pxfAlpha: case pxfMemoBLOb: case pxfFmtMemoBLOb: case pxfBCD: default:
-      column = PROTECT(allocVector(STRSXP, num_records)); break;
+    if (field->px_ftype == pxfAlpha) {
+      column = PROTECT(allocVector(STRSXP, num_rows));
+      for (int i = 0; i < num_rows; i++) {
+        int level;
+        SET_STRING_ELT(column, i, px_decode_alpha(pxdoc, NULL, keys + (size_t) i * key_size + offset,
+                                                  field->px_flen, &level));
+      }
+    } else {
+      column = PROTECT(allocVector(column_type(field->px_ftype, 0, 0), num_rows));
+      if (num_rows > 0) {
+        px_decode_column(field->px_ftype, field->px_fdc, keys + offset, key_size, num_rows, column_data(column));
+      }
+      set_column_class(column, field->px_ftype);
     }
-    SET_VECTOR_ELT(data_list, j, column);
-    // The column is now part of data_list, which is protected, so we can unprotect the 'column' variable.
+    SET_VECTOR_ELT(data_list, col, column);
+    SET_STRING_ELT(col_names, col++, mkChar(field->px_fname));
     UNPROTECT(1);
+    offset += field->px_flen;
   }
-  
-  // --- Step 2: Iterate through records and populate the R column vectors. ---
-  for (int i = 0; i < num_records; i++) {
-    pxval_t** record_values = PX_retrieve_record(pxdoc, i);
-    if (record_values == NULL) {
-      UNPROTECT(1); // Unprotect data_list before erroring.
-      Rf_error("Failed to retrieve record #%d.", i + 1);
+  if (with_count) {
+    SEXP column = PROTECT(allocVector(INTSXP, num_rows));
+    if (num_rows > 0) {
+      memcpy(INTEGER(column), counts, (size_t) num_rows * sizeof(int));
     }
-    
-    for (int j = 0; j < num_fields; j++) {
-      // Convert the Paradox value to an R SEXP.
-      SEXP r_val = px_to_sexp(pxdoc, record_values[j], fields[j].px_ftype);
-      SEXP column = VECTOR_ELT(data_list, j);
-      // Place the converted value into the correct position in the column vector.
-      switch(TYPEOF(column)) {
-      // For BLOBs (list of raw vectors)
-      case VECSXP:  SET_VECTOR_ELT(column, i, r_val); break;
-      // For character strings
-      case STRSXP:  SET_STRING_ELT(column, i, Rf_isNull(r_val) ? NA_STRING : r_val); break;
-      // For integers
-      case INTSXP:  INTEGER(column)[i] = Rf_isNull(r_val) ? NA_INTEGER : asInteger(r_val); break;
-      // For doubles (numeric, date, time)
-      case REALSXP: REAL(column)[i] = Rf_isNull(r_val) ? NA_REAL : asReal(r_val); break;
-      // For logicals
-      case LGLSXP:  LOGICAL(column)[i] = Rf_isNull(r_val) ? NA_LOGICAL : asLogical(r_val); break;
-      // This case should not be reached with the current logic.
-      default:      Rf_warning("Unhandled R SEXP type for column %d, record %d.", j + 1, i + 1); break;
+    SET_VECTOR_ELT(data_list, col, column);
+    SET_STRING_ELT(col_names, col++, mkChar("n"));
+    UNPROTECT(1);
+  }
+  for (int m = 0; m < num_measures; m++) {
+    const pxfield_t* field = &fields[INTEGER(fields_sexp)[m]];
+    const char* op = CHAR(STRING_ELT(ops_sexp, m));
+    // Sums are doubles, minimums and maximums keep the type of the field.
+    int is_sum = strcmp(op, "sum") == 0;
+    SEXPTYPE type = is_sum ? REALSXP : column_type(field->px_ftype, 0, 0);
+    SEXP column = PROTECT(allocVector(type, num_rows));
+    for (int i = 0; i < num_rows; i++) {
+      double x = values[(size_t) i * num_measures + m];
+      if (type == REALSXP) {
+        REAL(column)[i] = x;
+      } else if (type == LGLSXP) {
+        LOGICAL(column)[i] = ISNAN(x) ? NA_LOGICAL : (int) x;
+      } else {
+        INTEGER(column)[i] = ISNAN(x) ? NA_INTEGER : (int) x;
       }
-      // pxlib requires manual memory management for retrieved values.
-      FREE_PXVAL(pxdoc, record_values[j]);
     }
-    // Free the memory for the record's value array.
-    pxdoc->free(pxdoc, record_values);
-  }
-  
-  // --- Step 3: Set column names for the data_list ---
-  SEXP col_names = PROTECT(allocVector(STRSXP, num_fields));
-  for (int j = 0; j < num_fields; j++) {
-    SET_STRING_ELT(col_names, j, mkChar(fields[j].px_fname));
+    if (!is_sum) {
+      set_column_class(column, field->px_ftype);
+    }
+    char* name = R_alloc(strlen(op) + strlen(field->px_fname) + 2, 1);
+    snprintf(name, strlen(op) + strlen(field->px_fname) + 2, "%s_%s", op, field->px_fname);
+    SET_VECTOR_ELT(data_list, col, column);
+    SET_STRING_ELT(col_names, col++, mkChar(name));
+    UNPROTECT(1);
   }
-  // No special class needed for other types.
   setAttrib(data_list, R_NamesSymbol, col_names);
-  
-  // --- Step 4: Set special S3 classes for date/time types for proper R dispatch. ---
-  for (int j = 0; j < num_fields; j++) {
-    SEXP column = VECTOR_ELT(data_list, j);
-    switch(fields[j].px_ftype) {
-    case pxfDate:
-      // mkString already cached by R via CHARSXP pool - leave as is
-      setAttrib(column, R_ClassSymbol, mkString("Date"));
-      break;
-    case pxfTime:
-      // Use cached class vector
-      setAttrib(column, R_ClassSymbol, class_hms);
-      // mkString is cached - leave as is
-      setAttrib(column, install("units"), mkString("secs"));
-      break;
-    case pxfTimestamp:
-      // Use cached class vector
-      setAttrib(column, R_ClassSymbol, class_posixct);
-      // mkString is cached - leave as is
-      setAttrib(column, install("tzone"), mkString("UTC"));
-      break;
-    default: break;
-    }
-  }
-  
-  UNPROTECT(2); // Unprotect data_list and col_names.
+
+  UNPROTECT(2); // Unprotect col_names and data_list.
   return data_list;
 }
 
+// A BLOB reference of pxlib_fetch_blobs_c() with its place in the result.
+typedef struct {
+  int in_record; // 1 if the data is stored in the record itself, 2 if the BLOB is empty.
+  double offset;
+  int recno;
+  int i;
+} px_blob_read_t;
+
+// Orders the reads by .MB offset, followed by the BLOBs stored in records by record number.
+static int compare_blob_reads(const void* a, const void* b) {
+  const px_blob_read_t* x = (const px_blob_read_t*) a;
+  const px_blob_read_t* y = (const px_blob_read_t*) b;
+  if (x->in_record != y->in_record) return x->in_record - y->in_record;
+  if (x->offset != y->offset) return x->offset < y->offset ? -1 : 1;
+  if (x->recno != y->recno) return x->recno < y->recno ? -1 : 1;
+  return x->i - y->i;
+}
+
+/**
+ * @brief Reads the data of BLOB references returned by `blobs = "lazy"`.
+ *
+ * The BLOBs are read in the order of their offset in the .MB file, so that
+ * the file is read front to back, and returned in the order of the
+ * references. For BLOBs stored in the .MB file, the leader is rebuilt from
+ * the reference and decoded by `PX_convert_field()` as usual. Small BLOBs
+ * that are stored in the record itself are read from the record.
+ *
+ * @param pxdoc_extptr An R external pointer to the open Paradox database.
+ * @param field_sexp The 0-based position of the field the references belong to.
+ * @param recno_sexp Integer vector of 1-based record numbers.
+ * @param offset_sexp Double vector of .MB offsets.
+ * @param index_sexp Integer vector of indices within suballocated blocks.
+ * @param size_sexp Integer vector of BLOB sizes.
+ * @param mod_nr_sexp Integer vector of modification numbers.
+ * @return A character vector for memo fields, otherwise a list of raw vectors,
+ *   with `NA` or `NULL` for empty BLOBs.
+ */
+SEXP pxlib_fetch_blobs_c(SEXP pxdoc_extptr, SEXP field_sexp, SEXP recno_sexp, SEXP offset_sexp,
+                         SEXP index_sexp, SEXP size_sexp, SEXP mod_nr_sexp) {
+  pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
+
+  int num_fields = PX_get_num_fields(pxdoc);
+  pxfield_t* fields = PX_get_fields(pxdoc);
+  int field = asInteger(field_sexp);
+  if (fields == NULL || field == NA_INTEGER || field < 0 || field >= num_fields ||
+      !is_blob_type(fields[field].px_ftype)) {
+    Rf_error("The references do not belong to a memo or BLOB field.");
+  }
+  R_xlen_t n = XLENGTH(recno_sexp);
+  if (TYPEOF(recno_sexp) != INTSXP || TYPEOF(offset_sexp) != REALSXP || TYPEOF(index_sexp) != INTSXP ||
+      TYPEOF(size_sexp) != INTSXP || TYPEOF(mod_nr_sexp) != INTSXP || XLENGTH(offset_sexp) != n ||
+      XLENGTH(index_sexp) != n || XLENGTH(size_sexp) != n || XLENGTH(mod_nr_sexp) != n) {
+    Rf_error("Invalid BLOB references.");
+  }
+  pxfield_t* pxf = &fields[field];
+  int field_offset = 0;
+  for (int j = 0; j < field; j++) {
+    field_offset += fields[j].px_flen;
+  }
+  int leader = pxf->px_flen - 10;
+  int num_records = PX_get_num_records(pxdoc);
+
+  px_blob_read_t* reads = (px_blob_read_t*) R_alloc(n > 0 ? n : 1, sizeof(px_blob_read_t));
+  for (R_xlen_t i = 0; i < n; i++) {
+    int recno = INTEGER(recno_sexp)[i];
+    int size = INTEGER(size_sexp)[i];
+    if (recno == NA_INTEGER || recno < 1 || recno > num_records || size == NA_INTEGER ||
+        ISNAN(REAL(offset_sexp)[i])) {
+      Rf_error("Invalid BLOB reference #%lld.", (long long) i + 1);
+    }
+    // Graphics count 8 extra bytes in their size, see _px_get_data_blob().
+    int blobsize = pxf->px_ftype == pxfGraphic ? size - 8 : size;
+    reads[i].in_record = blobsize <= 0 ? 2 : blobsize <= leader;
+    reads[i].offset = REAL(offset_sexp)[i];
+    reads[i].recno = recno;
+    reads[i].i = (int) i;
+  }
+  qsort(reads, (size_t) n, sizeof(px_blob_read_t), compare_blob_reads);
+
+  int is_memo = pxf->px_ftype == pxfMemoBLOb || pxf->px_ftype == pxfFmtMemoBLOb;
+  SEXP result = PROTECT(allocVector(is_memo ? STRSXP : VECSXP, n));
+  char* data = R_alloc(pxf->px_flen, 1);
+  char* record = NULL;
+  for (R_xlen_t k = 0; k < n; k++) {
+    R_xlen_t i = reads[k].i;
+    char* field_data = data;
+    if (reads[k].in_record == 2) {
+      if (is_memo) SET_STRING_ELT(result, i, NA_STRING);
+      continue;
+    }
+    if (reads[k].in_record) {
+      if (record == NULL) {
+        record = R_alloc(PX_get_recordsize(pxdoc), 1);
+      }
+      if (PX_get_record(pxdoc, reads[k].recno - 1, record) == NULL) {
+        UNPROTECT(1);
+        Rf_error("Failed to retrieve record #%d.", reads[k].recno);
+      }
+      field_data = record + field_offset;
+    } else {
+      // Only the leader is needed to locate the BLOB in the .MB file.
+      memset(data, 0, pxf->px_flen);
+      put_long_le(&data[leader], (long) reads[k].offset | INTEGER(index_sexp)[i]);
+      put_long_le(&data[leader + 4], INTEGER(size_sexp)[i]);
+      put_short_le(&data[leader + 8], (short int) INTEGER(mod_nr_sexp)[i]);
+    }
+    pxval_t val;
+    memset(&val, 0, sizeof(val));
+    PX_convert_field(pxdoc, pxf, field_data, &val);
+    SEXP r_val = px_to_sexp(pxdoc, &val, pxf->px_ftype);
+    if (is_memo) {
+      SET_STRING_ELT(result, i, Rf_isNull(r_val) ? NA_STRING : r_val);
+    } else {
+      SET_VECTOR_ELT(result, i, r_val);
+    }
+  }
+  UNPROTECT(1);
+  return result;
+}
+
 /**
  * @brief Converts a single pxlib value (pxval_t) to a scalar R SEXP.
  *
@@ -374,41 +2611,41 @@ static SEXP px_to_sexp(pxdoc_t* pxdoc, pxval_t* val, int px_ftype) {
   case pxfAlpha:
     if (val->value.str.val == NULL) return NA_STRING;
     SEXP r_string = mkChar(val->value.str.val);
-    pxdoc->free(pxdoc, val->value.str.val);
+    PX_arena_free(pxdoc, val->value.str.val);
     return r_string;
   case pxfBCD:
     if (strcmp(val->value.str.val, "-??????????????????????????.??????") == 0) {
       //Free the memory even if the value is null-like.
-      pxdoc->free(pxdoc, val->value.str.val);
+      PX_arena_free(pxdoc, val->value.str.val);
       return R_NilValue;
     }
     r_string = mkChar(val->value.str.val);
-    pxdoc->free(pxdoc, val->value.str.val);
+    PX_arena_free(pxdoc, val->value.str.val);
     return r_string;
   case pxfMemoBLOb:
   case pxfFmtMemoBLOb:
     if (val->value.str.val == NULL) return R_NilValue;
     // pxlib does not guarantee null-termination for memo fields
-    SEXP memo_string = mkCharLen(val->value.str.val, val->value.str.len);
-    pxdoc->free(pxdoc, val->value.str.val);
+    SEXP memo_string = px_decode_text(pxdoc, val->value.str.val, val->value.str.len);
+    PX_arena_free(pxdoc, val->value.str.val);
     return memo_string;
     // --- True Binary Types ---
   case pxfBytes: {
     r_string = mkCharLen(val->value.str.val, val->value.str.len);
-    pxdoc->free(pxdoc, val->value.str.val);
+    PX_arena_free(pxdoc, val->value.str.val);
     return r_string;
   }
   case pxfBLOb: case pxfGraphic: case pxfOLE:
     if (val->value.str.len == 0) {
       if(val->value.str.val != NULL) {
-        pxdoc->free(pxdoc, val->value.str.val);
+        PX_arena_free(pxdoc, val->value.str.val);
       }
       return R_NilValue;
     }
     SEXP raw_vec = PROTECT(allocVector(RAWSXP, val->value.str.len));
     memcpy(RAW(raw_vec), val->value.str.val, val->value.str.len);
     UNPROTECT(1);
-    pxdoc->free(pxdoc, val->value.str.val);
+    PX_arena_free(pxdoc, val->value.str.val);
     return raw_vec;
     // --- Other Types (Numeric, Logical, Date/Time) ---
   case pxfShort: case pxfLong: case pxfAutoInc:
@@ -482,16 +2719,25 @@ SEXP pxlib_get_metadata_c(SEXP pxdoc_extptr) {
   // Local static variables for name vectors
   static SEXP names_metadata = NULL;
   static SEXP names_fields = NULL;
+  static SEXP names_blob_cache = NULL;
 
   // Initialize on first call
   if (names_metadata == NULL) {
-    names_metadata = PROTECT(allocVector(STRSXP, 3));
+    names_metadata = PROTECT(allocVector(STRSXP, 4));
     SET_STRING_ELT(names_metadata, 0, mkChar("num_records"));
     SET_STRING_ELT(names_metadata, 1, mkChar("num_fields"));
     SET_STRING_ELT(names_metadata, 2, mkChar("fields"));
+    SET_STRING_ELT(names_metadata, 3, mkChar("blob_cache"));
     R_PreserveObject(names_metadata);
     UNPROTECT(1);
 
+    names_blob_cache = PROTECT(allocVector(STRSXP, 3));
+    SET_STRING_ELT(names_blob_cache, 0, mkChar("size"));
+    SET_STRING_ELT(names_blob_cache, 1, mkChar("hits"));
+    SET_STRING_ELT(names_blob_cache, 2, mkChar("misses"));
+    R_PreserveObject(names_blob_cache);
+    UNPROTECT(1);
+
     names_fields = PROTECT(allocVector(STRSXP, 3));
     SET_STRING_ELT(names_fields, 0, mkChar("name"));
     SET_STRING_ELT(names_fields, 1, mkChar("type"));
@@ -510,7 +2756,7 @@ SEXP pxlib_get_metadata_c(SEXP pxdoc_extptr) {
   }
   
   // --- Build the Result List for R ---
-  SEXP result_list = PROTECT(allocVector(VECSXP, 3));
+  SEXP result_list = PROTECT(allocVector(VECSXP, 4));
   setAttrib(result_list, R_NamesSymbol, names_metadata); // Use cached names
   
   SET_VECTOR_ELT(result_list, 0, ScalarInteger(PX_get_num_records(pxdoc)));
@@ -541,8 +2787,144 @@ SEXP pxlib_get_metadata_c(SEXP pxdoc_extptr) {
   setAttrib(fields_df, R_ClassSymbol, mkString("data.frame"));
   
   SET_VECTOR_ELT(result_list, 2, fields_df);
+
+  // --- Statistics of the block cache of the BLOB file, if one is attached ---
+  pxblob_t* pxblob = pxdoc->px_blob;
+  if (pxblob != NULL && pxblob->mb_stream != NULL) {
+    SEXP blob_cache = allocVector(REALSXP, 3);
+    SET_VECTOR_ELT(result_list, 3, blob_cache);
+    REAL(blob_cache)[0] = (double) pxblob->blockcachelen;
+    REAL(blob_cache)[1] = (double) pxblob->blockcachehits;
+    REAL(blob_cache)[2] = (double) pxblob->blockcachemisses;
+    setAttrib(blob_cache, R_NamesSymbol, names_blob_cache);
+  }
   
   UNPROTECT(6); // result_list, fields_df, name_col, type_col, size_col, row_names
   
   return result_list;
 }
+
+/**
+ * @brief Enables or disables the counters of the read path of a document.
+ *
+ * Enabling them resets the counters to zero. While disabled, the read path
+ * only checks a NULL pointer per block.
+ *
+ * @param pxdoc_extptr The R external pointer to the open Paradox database.
+ * @param enable_sexp An R logical SEXP, `TRUE` to enable the counters.
+ * @return R_NilValue.
+ */
+SEXP pxlib_set_stats_c(SEXP pxdoc_extptr, SEXP enable_sexp) {
+  pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
+  if (PX_set_value(pxdoc, "stats", asLogical(enable_sexp) == TRUE ? 1.0f : 0.0f) < 0) {
+    Rf_error("Could not enable the statistics of the Paradox file.");
+  }
+  return R_NilValue;
+}
+
+/**
+ * @brief Returns the counters of the read path of a document.
+ *
+ * @param pxdoc_extptr The R external pointer to the open Paradox database.
+ * @param reset_sexp An R logical SEXP, `TRUE` to reset the counters to zero
+ *   after reading them.
+ * @return A named double vector with the counters and the times in seconds,
+ *   or `NULL` if the counters are not enabled.
+ */
+SEXP pxlib_get_stats_c(SEXP pxdoc_extptr, SEXP reset_sexp) {
+  static const char* names[] = {
+    "blocks_read", "block_cache_hits", "block_cache_misses", "bytes_read", "bytes_decrypted",
+    "mb_seeks", "mb_reads", "mb_bytes_read", "records_decoded",
+    "io_seconds", "decrypt_seconds", "blob_seconds", "decode_seconds"
+  };
+  pxdoc_t* pxdoc = check_pxdoc_ptr(pxdoc_extptr);
+  pxstats_t* stats = PX_get_stats(pxdoc);
+  if (stats == NULL) {
+    return R_NilValue;
+  }
+
+  const int n = (int) (sizeof(names) / sizeof(names[0]));
+  SEXP result = PROTECT(allocVector(REALSXP, n));
+  SEXP result_names = PROTECT(allocVector(STRSXP, n));
+  double values[] = {
+    (double) stats->blocksread, (double) stats->blockcachehits, (double) stats->blockcachemisses,
+    (double) stats->bytesread, (double) stats->bytesdecrypted, (double) stats->mbseeks,
+    (double) stats->mbreads, (double) stats->mbbytesread, (double) stats->recordsdecoded,
+    stats->nsio / 1e9, stats->nsdecrypt / 1e9, stats->nsblob / 1e9, stats->nsdecode / 1e9
+  };
+  for (int i = 0; i < n; i++) {
+    REAL(result)[i] = values[i];
+    SET_STRING_ELT(result_names, i, mkChar(names[i]));
+  }
+  setAttrib(result, R_NamesSymbol, result_names);
+  if (asLogical(reset_sexp) == TRUE) {
+    memset(stats, 0, sizeof(pxstats_t));
+  }
+
+  UNPROTECT(2); // result, result_names
+  return result;
+}
+
+/**
+ * @brief Writes a synthetic Paradox table, see `px_generate_table()`.
+ *
+ * Used by the benchmarks in `inst/bench` and the tests to get tables of any
+ * size; the values themselves are meaningless.
+ *
+ * @param path_sexp An R character string SEXP with the path of the .db file.
+ * @param blob_path_sexp An R character string SEXP with the path of the .mb file.
+ * @param kinds_sexp An R character vector SEXP with the kind of each field.
+ * @param n_records_sexp An R numeric SEXP, the number of records.
+ * @param block_size_sexp An R numeric SEXP, the block size in KB, or 0 for the default.
+ * @param password_sexp NULL or an R character string SEXP, the password to encrypt with.
+ * @param null_rate_sexp An R numeric SEXP, the fraction of NULL values.
+ * @param blob_rate_sexp An R numeric SEXP, the fraction of memo and BLOB values that are set.
+ * @param seed_sexp An R numeric SEXP, the seed of the values.
+ * @return `NULL`, invisibly; errors are raised as R errors.
+ */
+SEXP pxlib_generate_table_c(SEXP path_sexp, SEXP blob_path_sexp, SEXP kinds_sexp, SEXP n_records_sexp,
+                            SEXP block_size_sexp, SEXP password_sexp, SEXP null_rate_sexp,
+                            SEXP blob_rate_sexp, SEXP seed_sexp) {
+  // --- Step 1: Validate the arguments ---
+  if (TYPEOF(path_sexp) != STRSXP || LENGTH(path_sexp) != 1 || STRING_ELT(path_sexp, 0) == NA_STRING ||
+      TYPEOF(blob_path_sexp) != STRSXP || LENGTH(blob_path_sexp) != 1 ||
+      STRING_ELT(blob_path_sexp, 0) == NA_STRING) {
+    Rf_error("Paths must be single, non-NA character strings.");
+  }
+  if (TYPEOF(kinds_sexp) != STRSXP || LENGTH(kinds_sexp) == 0 || LENGTH(kinds_sexp) > 255) {
+    Rf_error("The table must have between 1 and 255 fields.");
+  }
+  int num_fields = LENGTH(kinds_sexp);
+  int* kinds = (int*) R_alloc(num_fields, sizeof(int));
+  for (int j = 0; j < num_fields; j++) {
+    SEXP kind = STRING_ELT(kinds_sexp, j);
+    kinds[j] = kind == NA_STRING ? -1 : px_generate_kind(CHAR(kind));
+    if (kinds[j] < 0) {
+      Rf_error("Unknown field kind '%s'.", kind == NA_STRING ? "NA" : CHAR(kind));
+    }
+  }
+
+  if (!Rf_isNull(password_sexp) && (TYPEOF(password_sexp) != STRSXP || LENGTH(password_sexp) != 1 ||
+                                     STRING_ELT(password_sexp, 0) == NA_STRING)) {
+    Rf_error("Password must be NULL or a single, non-NA character string.");
+  }
+
+  px_generate_options_t options;
+  options.num_records = asInteger(n_records_sexp);
+  options.block_size = asInteger(block_size_sexp);
+  options.password = Rf_isNull(password_sexp) ? NULL : CHAR(STRING_ELT(password_sexp, 0));
+  options.null_rate = asReal(null_rate_sexp);
+  options.blob_rate = asReal(blob_rate_sexp);
+  options.seed = (unsigned int) asReal(seed_sexp);
+  if (options.num_records == NA_INTEGER || options.num_records < 0 || options.block_size == NA_INTEGER) {
+    Rf_error("The number of records and the block size must be non-negative integers.");
+  }
+
+  // --- Step 2: Write the table ---
+  char message[256];
+  if (px_generate_table(CHAR(STRING_ELT(path_sexp, 0)), CHAR(STRING_ELT(blob_path_sexp, 0)), kinds,
+                        num_fields, &options, message, sizeof(message)) < 0) {
+    Rf_error("%s", message);
+  }
+  return R_NilValue;
+}
@@ -55,6 +55,9 @@
 #define min(a,b) ((a)<(b) ? (a) : (b))
 #endif
 
+#define PX_MB_CACHESIZE 16 /* Default number of blocks in the cache of a blob file */
+#define PX_READAHEAD 16 /* Default number of data blocks announced ahead of a scan */
+
 
 /* PX_get_majorversion() {{{
  */
@@ -179,6 +182,7 @@ PX_new3(void  (*errorhandler)(pxdoc_t *p, int type, const char *msg, void *data)
 
 	pxdoc->px_head = NULL;
 	pxdoc->px_pindex = NULL;
+	pxdoc->px_keyindex = NULL;
 
 	pxdoc->last_position = -1;
 
@@ -187,9 +191,17 @@ PX_new3(void  (*errorhandler)(pxdoc_t *p, int type, const char *msg, void *data)
 
 	pxdoc->targetencoding = NULL;
 	pxdoc->inputencoding = NULL;
+	pxdoc->sourceencoding = NULL;
+	pxdoc->out_codetable = NULL;
 	pxdoc->px_data = NULL;
 	pxdoc->px_datalen = 0;
 	pxdoc->curblocknr = 0;
+	pxdoc->readaheadblocks = PX_READAHEAD;
+	pxdoc->deferindex = px_false;
+	pxdoc->px_indexdeferred = px_false;
+	pxdoc->px_arena = NULL;
+	pxdoc->px_recbuf = NULL;
+	pxdoc->px_stats = NULL;
 
 	return pxdoc;
 }
@@ -265,6 +277,63 @@ PX_set_io_stream(pxdoc_t *pxdoc,
 }
 /* }}} */
 
+/* px_free_record_map() {{{
+ * Frees the record map of the self build primary index. It must be
+ * called whenever the index is modified or replaced, which makes
+ * px_get_record_pos_with_index() fall back to walking the index.
+ */
+static void px_free_record_map(pxdoc_t *pxdoc) {
+	if(pxdoc->px_recmap) {
+		pxdoc->free(pxdoc, pxdoc->px_recmap);
+		pxdoc->px_recmap = NULL;
+	}
+	pxdoc->px_recmaplen = 0;
+	pxdoc->px_recmaplast = 0;
+}
+/* }}} */
+
+/* px_find_record_map() {{{
+ * Returns the entry of the record map holding the record recno, or
+ * -1 if there is none. The entry of the last lookup and the one after
+ * it are checked first, so sequential access takes constant time.
+ * Otherwise the entry is found by binary search over the first record
+ * numbers of the blocks.
+ */
+static int px_find_record_map(pxdoc_t *pxdoc, int recno) {
+	pxrecmap_t *map;
+	int lo, hi, i;
+
+	map = pxdoc->px_recmap;
+	if(map == NULL || pxdoc->px_recmaplen <= 0 || recno < 0)
+		return -1;
+
+	for(i=pxdoc->px_recmaplast; i<pxdoc->px_recmaplast+2 && i<pxdoc->px_recmaplen; i++) {
+		if(recno >= map[i].recno && recno < map[i].recno+map[i].numrecords) {
+			pxdoc->px_recmaplast = i;
+			return i;
+		}
+	}
+
+	/* Find the last block starting at or before recno. Empty blocks
+	 * have the same first record as their successor and are skipped.
+	 */
+	lo = 0;
+	hi = pxdoc->px_recmaplen-1;
+	while(lo < hi) {
+		i = lo + (hi-lo+1)/2;
+		if(map[i].recno <= recno)
+			lo = i;
+		else
+			hi = i-1;
+	}
+	if(recno >= map[lo].recno && recno < map[lo].recno+map[lo].numrecords) {
+		pxdoc->px_recmaplast = lo;
+		return lo;
+	}
+	return -1;
+}
+/* }}} */
+
 /* build_primary_index() {{{
  * Build a primary index.
  */
@@ -272,6 +341,7 @@ static int build_primary_index(pxdoc_t *pxdoc) {
 	pxhead_t *pxh;
 	pxstream_t *pxs;
 	pxpindex_t *pindex;
+	pxrecmap_t *recmap;
 	int blocknumber, numrecords;
 	unsigned blockcount;
 
@@ -289,12 +359,22 @@ static int build_primary_index(pxdoc_t *pxdoc) {
 	if(pxdoc->px_indexdata) {
 		pxdoc->free(pxdoc, pxdoc->px_indexdata);
 	}
+	px_free_record_map(pxdoc);
 	/* Allocate memory for internal list of index entries */
 //	fprintf(stderr, "fileblocks = %d\n", pxh->px_fileblocks);
 	if(NULL == (pindex = pxdoc->malloc(pxdoc, pxh->px_fileblocks*sizeof(pxpindex_t), _("Allocate memory for self build internal primary index.")))) {
 		px_error(pxdoc, PX_MemoryError, _("Could not allocate memory for self build internal index."));
 		return -1;
 	}
+	/* The record map stores the first record number and the location of
+	 * each block, so that records can be found without walking the index
+	 * and reading the block header again.
+	 */
+	if(NULL == (recmap = pxdoc->malloc(pxdoc, (pxh->px_fileblocks+1)*sizeof(pxrecmap_t), _("Allocate memory for record map.")))) {
+		px_error(pxdoc, PX_MemoryError, _("Could not allocate memory for record map."));
+		pxdoc->free(pxdoc, pindex);
+		return -1;
+	}
 
 	/* Build Index of Level 1 */
 	pxdoc->px_indexdata = pindex;
@@ -307,6 +387,8 @@ static int build_primary_index(pxdoc_t *pxdoc) {
 		if(get_datablock_head(pxdoc, pxs, blocknumber, &datablockhead) < 0) {
 			px_error(pxdoc, PX_RuntimeError, _("Could not get head of data block nr. %d."), blocknumber);
 			pxdoc->free(pxdoc, pindex);
+			pxdoc->free(pxdoc, recmap);
+			pxdoc->px_indexdata = NULL;
 			return -1;
 		}
 		/* The data can be NULL because we don't support searching for field
@@ -321,9 +403,21 @@ static int build_primary_index(pxdoc_t *pxdoc) {
 		}
 		pindex[blockcount].myblocknumber = 0;
 		pindex[blockcount].level = 1;
+
+		recmap[blockcount].recno = numrecords - pindex[blockcount].numrecords;
+		recmap[blockcount].numrecords = pindex[blockcount].numrecords;
+		recmap[blockcount].entry = blockcount;
+		recmap[blockcount].blocknumber = blocknumber;
+		recmap[blockcount].prev = get_short_le((const char *) &datablockhead.prevBlock);
+		recmap[blockcount].next = get_short_le((const char *) &datablockhead.nextBlock);
+		recmap[blockcount].blockpos = pxh->px_headersize + (long) (blocknumber-1)*pxh->px_maxtablesize*0x400;
+
 		blocknumber = get_short_le((const char *) &datablockhead.nextBlock);
 		blockcount++;
 	}
+	pxdoc->px_recmap = recmap;
+	pxdoc->px_recmaplen = blockcount;
+	pxdoc->px_recmaplast = 0;
 	/* Check if the number of records in the blocks sums up to number
 	 * of records in the header
 	 */
@@ -340,7 +434,9 @@ static int build_primary_index(pxdoc_t *pxdoc) {
 //			fprintf(stderr, "next blocknumber after creating primary index: %d\n", blocknumber);
 			if(get_datablock_head(pxdoc, pxs, blocknumber, &datablockhead) < 0) {
 				px_error(pxdoc, PX_RuntimeError, _("Could not get head of data block nr. %d."), blocknumber);
+				px_free_record_map(pxdoc);
 				pxdoc->free(pxdoc, pindex);
+				pxdoc->px_indexdata = NULL;
 				return -1;
 			}
 			/* The data can be NULL because we don't support searching for field
@@ -358,6 +454,30 @@ static int build_primary_index(pxdoc_t *pxdoc) {
 }
 /* }}} */
 
+/* PX_load_index() {{{
+ * Build the self build index of a file which has been opened with
+ * 'deferindex' set. Does nothing if it has been built already. All
+ * functions reading records call it, so it only needs to be called
+ * by code which accesses px_indexdata or px_recmap directly.
+ */
+PXLIB_API int PXLIB_CALL
+PX_load_index(pxdoc_t *pxdoc) {
+	if(pxdoc == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
+		return -1;
+	}
+
+	if(!pxdoc->px_indexdeferred) {
+		return 0;
+	}
+	pxdoc->px_indexdeferred = px_false;
+	if(build_primary_index(pxdoc) < 0) {
+		return -1;
+	}
+	return 0;
+}
+/* }}} */
+
 /* PX_open_stream() {{{
  * Read from a Paradox DB file, which has an already open stream.
  */
@@ -389,6 +509,7 @@ PX_open_stream(pxdoc_t *pxdoc, void *stream) {
 
 	/* Build primary index. This index misses all index blocks with a level
 	 * greater than 1. Since they are not used currently this is of no harm.
+	 * With 'deferindex' set it is built by PX_load_index() on first access.
 	 */
 	pxh = pxdoc->px_head;
 	if(pxh->px_filetype == pxfFileTypIndexDB ||
@@ -397,7 +518,9 @@ PX_open_stream(pxdoc_t *pxdoc, void *stream) {
 	   pxh->px_filetype == pxfFileTypIncSecIndex ||
 	   pxh->px_filetype == pxfFileTypNonIncSecIndexG ||
 	   pxh->px_filetype == pxfFileTypIncSecIndexG) {
-		if(build_primary_index(pxdoc) < 0) {
+		if(pxdoc->deferindex) {
+			pxdoc->px_indexdeferred = px_true;
+		} else if(build_primary_index(pxdoc) < 0) {
 			return -1;
 		}
 	}
@@ -437,6 +560,7 @@ PX_open_gsf(pxdoc_t *pxdoc, GsfInput *gsf) {
 
 	/* Build primary index. This index misses all index blocks with a level
 	 * greater than 1. Since they are not used currently this is of no harm.
+	 * With 'deferindex' set it is built by PX_load_index() on first access.
 	 */
 	pxh = pxdoc->px_head;
 	if(pxh->px_filetype == pxfFileTypIndexDB ||
@@ -445,7 +569,9 @@ PX_open_gsf(pxdoc_t *pxdoc, GsfInput *gsf) {
 	   pxh->px_filetype == pxfFileTypIncSecIndex ||
 	   pxh->px_filetype == pxfFileTypNonIncSecIndexG ||
 	   pxh->px_filetype == pxfFileTypIncSecIndexG) {
-		if(build_primary_index(pxdoc) < 0) {
+		if(pxdoc->deferindex) {
+			pxdoc->px_indexdeferred = px_true;
+		} else if(build_primary_index(pxdoc) < 0) {
 			return -1;
 		}
 	}
@@ -454,23 +580,12 @@ PX_open_gsf(pxdoc_t *pxdoc, GsfInput *gsf) {
 /* }}} */
 #endif /* HAVE_GSF */
 
-/* PX_open_fp() {{{
- * Read from a Paradox DB file, which has already been opend with fopen.
+/* px_open_read_stream() {{{
+ * Read the header of a Paradox DB file from an already created
+ * stream and build the primary index.
  */
-PXLIB_API int PXLIB_CALL
-PX_open_fp(pxdoc_t *pxdoc, FILE *fp) {
+static int px_open_read_stream(pxdoc_t *pxdoc, pxstream_t *pxs) {
 	pxhead_t *pxh;
-	pxstream_t *pxs;
-
-	if(pxdoc == NULL) {
-		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
-		return -1;
-	}
-
-	if(NULL == (pxs = px_stream_new_file(pxdoc, pxfFileRead, px_false, fp))) {
-		px_error(pxdoc, PX_MemoryError, _("Could not create new file io stream."));
-		return -1;
-	}
 
 	pxdoc->px_stream = pxs;
 
@@ -487,6 +602,7 @@ PX_open_fp(pxdoc_t *pxdoc, FILE *fp) {
 
 	/* Build primary index. This index misses all index blocks with a level
 	 * greater than 1. Since they are not used currently this is of no harm.
+	 * With 'deferindex' set it is built by PX_load_index() on first access.
 	 */
 	pxh = pxdoc->px_head;
 	if(pxh->px_filetype == pxfFileTypIndexDB ||
@@ -495,7 +611,9 @@ PX_open_fp(pxdoc_t *pxdoc, FILE *fp) {
 	   pxh->px_filetype == pxfFileTypIncSecIndex ||
 	   pxh->px_filetype == pxfFileTypNonIncSecIndexG ||
 	   pxh->px_filetype == pxfFileTypIncSecIndexG) {
-		if(build_primary_index(pxdoc) < 0) {
+		if(pxdoc->deferindex) {
+			pxdoc->px_indexdeferred = px_true;
+		} else if(build_primary_index(pxdoc) < 0) {
 			return -1;
 		}
 	}
@@ -503,6 +621,27 @@ PX_open_fp(pxdoc_t *pxdoc, FILE *fp) {
 }
 /* }}} */
 
+/* PX_open_fp() {{{
+ * Read from a Paradox DB file, which has already been opend with fopen.
+ */
+PXLIB_API int PXLIB_CALL
+PX_open_fp(pxdoc_t *pxdoc, FILE *fp) {
+	pxstream_t *pxs;
+
+	if(pxdoc == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
+		return -1;
+	}
+
+	if(NULL == (pxs = px_stream_new_file(pxdoc, pxfFileRead, px_false, fp))) {
+		px_error(pxdoc, PX_MemoryError, _("Could not create new file io stream."));
+		return -1;
+	}
+
+	return px_open_read_stream(pxdoc, pxs);
+}
+/* }}} */
+
 /* PX_open_file() {{{
  * Read from a Paradox DB file. Open the file itself. Use PX_open_fp()
  * if the file has been open already with fopen().
@@ -533,6 +672,38 @@ PX_open_file(pxdoc_t *pxdoc, const char *filename) {
 }
 /* }}} */
 
+/* PX_open_file_mmap() {{{
+ * Open a Paradox DB file for reading through a memory mapping of the
+ * whole file. Blocks of unencrypted files are then accessed without
+ * any copying or system calls. If the file cannot be mapped, it is
+ * opened like with PX_open_file().
+ */
+PXLIB_API int PXLIB_CALL
+PX_open_file_mmap(pxdoc_t *pxdoc, const char *filename) {
+	pxstream_t *pxs;
+
+	if(pxdoc == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
+		return -1;
+	}
+
+	if(NULL == (pxs = px_stream_new_mmap(pxdoc, pxfFileRead, px_true, filename))) {
+		return PX_open_file(pxdoc, filename);
+	}
+
+	if(0 > px_open_read_stream(pxdoc, pxs)) {
+		px_error(pxdoc, PX_RuntimeError, _("Could not open paradox database."));
+		px_stream_close(pxdoc, pxs);
+		pxdoc->free(pxdoc, pxs);
+		pxdoc->px_stream = NULL;
+		return -1;
+	}
+
+	pxdoc->px_name = px_strdup(pxdoc, filename);
+	return 0;
+}
+/* }}} */
+
 /* PX_create_fp() {{{
  * Create a new paradox database.
  */
@@ -712,12 +883,64 @@ PX_set_value(pxdoc_t *pxdoc, const char *name, float value) {
 		return -1;
 	}
 
+	/* Values which do not change the file can be set on any file */
+	if(strcmp(name, "mbcachesize") == 0) {
+		if(pxdoc->px_blob == NULL) {
+			px_error(pxdoc, PX_Warning, _("No blob file has been set."));
+			return -1;
+		}
+		if(value < 0) {
+			px_error(pxdoc, PX_Warning, _("Size of block cache must be greater than or equal to 0."));
+			return -1;
+		}
+		return(px_mb_cache_resize(pxdoc->px_blob, (int) value));
+	} else if(strcmp(name, "readahead") == 0) {
+		if(value < 0) {
+			px_error(pxdoc, PX_Warning, _("Number of blocks to read ahead must be greater than or equal to 0."));
+			return -1;
+		}
+		pxdoc->readaheadblocks = (int) value;
+		return(0);
+	} else if(strcmp(name, "deferindex") == 0) {
+		/* Only has an effect if set before the file is opened */
+		pxdoc->deferindex = value != 0 ? px_true : px_false;
+		return(0);
+	} else if(strcmp(name, "stats") == 0) {
+		/* Enabling resets the counters, disabling frees them */
+		if(value != 0) {
+			if(pxdoc->px_stats == NULL &&
+			   NULL == (pxdoc->px_stats = pxdoc->malloc(pxdoc, sizeof(pxstats_t), _("Allocate memory for statistics.")))) {
+				px_error(pxdoc, PX_MemoryError, _("Could not allocate memory for statistics."));
+				return -1;
+			}
+			memset(pxdoc->px_stats, 0, sizeof(pxstats_t));
+		} else if(pxdoc->px_stats != NULL) {
+			pxdoc->free(pxdoc, pxdoc->px_stats);
+			pxdoc->px_stats = NULL;
+		}
+		return(0);
+	}
+
 	if(!(pxdoc->px_stream->mode & pxfFileWrite)) {
 		px_error(pxdoc, PX_Warning, _("File is not writable. Setting '%s' has no effect."), name);
 		return -1;
 	}
 
-	if(strcmp(name, "numprimkeys") == 0) {
+	if(strcmp(name, "maxtablesize") == 0) {
+		/* The block size in KB can only be changed before the first block is written */
+		if(value < 1 || value > 32 || (int) value * 0x400 - (int) sizeof(TDataBlock) < pxdoc->px_head->px_recordsize) {
+			px_error(pxdoc, PX_Warning, _("Block size must be between 1 and 32 KB and hold at least one record."));
+			return -1;
+		}
+		if(pxdoc->px_head->px_fileblocks > 0) {
+			px_error(pxdoc, PX_Warning, _("Block size cannot be changed once records have been written."));
+			return -1;
+		}
+		pxdoc->px_head->px_maxtablesize = (int) value;
+		if(put_px_head(pxdoc, pxdoc->px_head, pxdoc->px_stream) < 0) {
+			return -1;
+		}
+	} else if(strcmp(name, "numprimkeys") == 0) {
 		if(value < 0) {
 			px_error(pxdoc, PX_Warning, _("Number of primary keys must be greater than or equal to 0."), name);
 			return -1;
@@ -800,6 +1023,18 @@ PX_get_value(pxdoc_t *pxdoc, const char *name, float *value) {
 	} else if(strcmp(name, "firstblock") == 0) {
 		*value = (float) pxdoc->px_head->px_firstblock;
 		return(0);
+	} else if(strcmp(name, "mbcachesize") == 0) {
+		*value = pxdoc->px_blob ? (float) pxdoc->px_blob->blockcachelen : 0.0f;
+		return(0);
+	} else if(strcmp(name, "readahead") == 0) {
+		*value = (float) pxdoc->readaheadblocks;
+		return(0);
+	} else if(strcmp(name, "deferindex") == 0) {
+		*value = (float) pxdoc->deferindex;
+		return(0);
+	} else if(strcmp(name, "stats") == 0) {
+		*value = pxdoc->px_stats != NULL ? 1.0f : 0.0f;
+		return(0);
 	} else if(strcmp(name, "lastblock") == 0) {
 		*value = (float) pxdoc->px_head->px_lastblock;
 		return(0);
@@ -821,6 +1056,22 @@ PX_get_value(pxdoc_t *pxdoc, const char *name, float *value) {
 }
 /* }}} */
 
+/* PX_get_stats() {{{
+ * Returns the counters of the read path, which are enabled by setting
+ * the value "stats" to 1 and reset by setting it again. The counters
+ * belong to the document and must not be freed. Returns NULL if they
+ * are not enabled.
+ */
+PXLIB_API pxstats_t* PXLIB_CALL
+PX_get_stats(pxdoc_t *pxdoc) {
+	if(pxdoc == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
+		return NULL;
+	}
+	return pxdoc->px_stats;
+}
+/* }}} */
+
 /* PX_set_parameter() {{{
  * Sets a string value
  */
@@ -851,6 +1102,10 @@ PX_set_parameter(pxdoc_t *pxdoc, const char *name, const char *value) {
 		}
 	} else if(strcmp(name, "password") == 0) {
 		pxdoc->px_head->px_encryption = px_passwd_checksum(value);
+		if(px_set_crypt_key(pxdoc, pxdoc->px_head->px_encryption) < 0) {
+			px_error(pxdoc, PX_MemoryError, _("Could not allocate memory for decryption tables."));
+			return -1;
+		}
 		if(pxdoc->px_stream->mode & pxfFileWrite) {
 			if(put_px_head(pxdoc, pxdoc->px_head, pxdoc->px_stream) < 0) {
 				return -1;
@@ -884,6 +1139,14 @@ PX_set_parameter(pxdoc_t *pxdoc, const char *name, const char *value) {
 			px_error(pxdoc, PX_RuntimeError, _("Input encoding could not be set."));
 			return -1;
 		}
+	} else if(strcmp(name, "sourceencoding") == 0) {
+		if(pxdoc->sourceencoding)
+			pxdoc->free(pxdoc, pxdoc->sourceencoding);
+		pxdoc->sourceencoding = px_strdup(pxdoc, value);
+		if(pxdoc->targetencoding && 0 > px_set_targetencoding(pxdoc)) {
+			px_error(pxdoc, PX_RuntimeError, _("Target encoding could not be set."));
+			return -1;
+		}
 	} else if(strcmp(name, "warning") == 0) {
 		if(strcmp(value, "true") == 0) {
 			pxdoc->warnings = px_true;
@@ -919,22 +1182,21 @@ PX_get_parameter(pxdoc_t *pxdoc, const char *name, char **value) {
 	} else if(strcmp(name, "inputencoding") == 0) {
 		*value = pxdoc->inputencoding;
 		return(0);
+	} else if(strcmp(name, "sourceencoding") == 0) {
+		*value = pxdoc->sourceencoding;
+		return(0);
 	}
 	px_error(pxdoc, PX_Warning, _("No such parameter name."));
 	return(-2);
 }
 /* }}} */
 
-/* PX_add_primary_index() {{{
- * Use a primary index for an DB file. The index has to be opened before
- * with PX_open_fp() PX_open_file(). After adding an index it will be
- * used for accessing database records.
- * If this function has been called before for the same DB file, the
- * old index will be deleted first. Make sure to actually read the
- * index with PX_read_primary_index() and not just open it.
+/* px_check_primary_index() {{{
+ * Checks whether the primary index pindex, which has been read with
+ * PX_read_primary_index(), belongs to the database pxdoc.
+ * Returns 0 if it does, otherwise -1.
  */
-PXLIB_API int PXLIB_CALL
-PX_add_primary_index(pxdoc_t *pxdoc, pxdoc_t *pindex) {
+static int px_check_primary_index(pxdoc_t *pxdoc, pxdoc_t *pindex) {
 	pxfield_t *pfielddb, *pfieldpx;
 	pxpindex_t *pindex_data;
 	int records, i;
@@ -1005,6 +1267,23 @@ PX_add_primary_index(pxdoc_t *pxdoc, pxdoc_t *pindex) {
 		px_error(pxdoc, PX_RuntimeError, _("Index file is for database with %d records, but database has %d records."), records, pxdoc->px_head->px_numrecords);
 		return -1;
 	}
+	return 0;
+}
+/* }}} */
+
+/* PX_add_primary_index() {{{
+ * Use a primary index for an DB file. The index has to be opened before
+ * with PX_open_fp() PX_open_file(). After adding an index it will be
+ * used for accessing database records.
+ * If this function has been called before for the same DB file, the
+ * old index will be deleted first. Make sure to actually read the
+ * index with PX_read_primary_index() and not just open it.
+ */
+PXLIB_API int PXLIB_CALL
+PX_add_primary_index(pxdoc_t *pxdoc, pxdoc_t *pindex) {
+	if(px_check_primary_index(pxdoc, pindex) < 0) {
+		return -1;
+	}
 
 	/* Delete an existing primary index file */
 	if(pxdoc->px_pindex) {
@@ -1012,8 +1291,51 @@ PX_add_primary_index(pxdoc_t *pxdoc, pxdoc_t *pindex) {
 	}
 	pxdoc->px_pindex = pindex;
 	pxdoc->px_indexdata = pindex->px_data;
+	pxdoc->px_indexdeferred = px_false;
 	pxdoc->px_indexdatalen = pindex->px_head->px_numrecords;
+	px_free_record_map(pxdoc);
+
+	return 0;
+}
+/* }}} */
+
+/* px_read_index_cb() {{{
+ * Copies the records of a block of a primary index file into the
+ * entries of the index, see PX_read_primary_index().
+ */
+typedef struct {
+	pxpindex_t *entries;
+	int datalen;
+	pxscanpos_t *pos;
+	int count;
+} pxindexreader_t;
+
+static int
+px_read_index_cb(pxdoc_t *pindex, int recno, char *records, int numrecords, void *user_data) {
+	pxindexreader_t *reader = (pxindexreader_t *) user_data;
+	int i;
+
+	for(i=0; i<numrecords; i++) {
+		pxpindex_t *entry = &reader->entries[recno+i];
+		char *data = records+i*pindex->px_head->px_recordsize;
+		short int value;
 
+		/* Copy the data part for later sorting */
+		if(NULL == (entry->data = pindex->malloc(pindex, reader->datalen, _("Allocate memory for data part of index record.")))) {
+			return -1;
+		}
+		memcpy(entry->data, data, reader->datalen);
+		/* Get the index data */
+		PX_get_data_short(pindex, &data[reader->datalen], 2, &value);
+		entry->blocknumber = value;
+		PX_get_data_short(pindex, &data[reader->datalen+2], 2, &value);
+		entry->numrecords = value;
+		PX_get_data_short(pindex, &data[reader->datalen+4], 2, &value);
+		entry->dummy = value;
+		/* The scan position is still on the block of the records. */
+		entry->myblocknumber = reader->pos->blocknumber;
+		reader->count++;
+	}
 	return 0;
 }
 /* }}} */
@@ -1026,7 +1348,8 @@ PX_read_primary_index(pxdoc_t *pindex) {
 	pxpindex_t *pindex_data;
 	pxhead_t *pxh;
 	pxfield_t *pxf;
-	char *data;
+	pxindexreader_t reader;
+	pxscanpos_t pos;
 	int i, j, datalen;
 
 	if(pindex == NULL ||
@@ -1047,12 +1370,6 @@ PX_read_primary_index(pxdoc_t *pindex) {
 	pindex_data = (pxpindex_t *) pindex->px_data;
 	memset(pindex_data, 0, pxh->px_numrecords*sizeof(pxpindex_t));
 
-	if((data = (char *) pindex->malloc(pindex, pxh->px_recordsize, _("Allocate memory for data of index record."))) == NULL) {
-		px_error(pindex, PX_RuntimeError, _("Could not allocate memory for primary index data."));
-		pindex->free(pindex, pindex->px_data);
-		return -1;
-	}
-
 	/* Read over the field data.
 	 * px_numfields does not count the fields with information about
 	 * block position and num of records per block. It is only the
@@ -1065,37 +1382,26 @@ PX_read_primary_index(pxdoc_t *pindex) {
 	}
 	if(datalen != pxh->px_recordsize-6) {
 		px_error(pindex, PX_RuntimeError, _("Inconsistency in length of primary index record. Expected %d but calculated %d."), pxh->px_recordsize-6, datalen);
-		pindex->free(pindex, data);
 		pindex->free(pindex, pindex->px_data);
 		pindex->px_data = NULL;
 		return(-1);
 	}
-	for(j=0; j<pxh->px_numrecords; j++) {
-		pxdatablockinfo_t pxdbinfo;
-		int isdeleted=0;
-		if(PX_get_record2(pindex, j, data, &isdeleted, &pxdbinfo)) {
-			short int value;
-			/* Copy the data part for later sorting */
-			pindex_data[j].data = pindex->malloc(pindex, datalen, _("Allocate memory for data part of index record."));
-			memcpy(pindex_data[j].data, data, datalen);
-			/* Get the index data */
-			PX_get_data_short(pindex, &data[datalen], 2, &value);
-			pindex_data[j].blocknumber = value;
-			PX_get_data_short(pindex, &data[datalen+2], 2, &value);
-			pindex_data[j].numrecords = value;
-			PX_get_data_short(pindex, &data[datalen+4], 2, &value);
-			pindex_data[j].dummy = value;
-			pindex_data[j].myblocknumber = pxdbinfo.number;
-		} else {
-			px_error(pindex, PX_RuntimeError, _("Could not read record no. %d of primary index data."), j);
-			/* Free so far allocated data memory */
-			for(j--; j>=0; j--)
-				pindex->free(pindex, pindex_data->data);
-			pindex->free(pindex, data);
-			pindex->free(pindex, pindex->px_data);
-			pindex->px_data = NULL;
-			return -1;
-		}
+	/* Read the index block by block. Fetching each record by its number
+	 * would follow the block list from the start every time. */
+	reader.entries = pindex_data;
+	reader.datalen = datalen;
+	reader.pos = &pos;
+	reader.count = 0;
+	PX_scan_init(pindex, &pos);
+	if(PX_scan_range(pindex, &pos, -1, px_read_index_cb, &reader) != 0 ||
+	   reader.count != pxh->px_numrecords) {
+		px_error(pindex, PX_RuntimeError, _("Could not read record no. %d of primary index data."), reader.count);
+		/* Free so far allocated data memory */
+		for(j=0; j<reader.count; j++)
+			pindex->free(pindex, pindex_data[j].data);
+		pindex->free(pindex, pindex->px_data);
+		pindex->px_data = NULL;
+		return -1;
 	}
 	/* find level of index blocks. Index blocks of level 1 contain references
 	 * to data blocks. Index blocks of level n+1 contain references to index
@@ -1132,7 +1438,88 @@ PX_read_primary_index(pxdoc_t *pindex) {
 //		printf("%d\t%d\n", pindex_data[j].myblocknumber, pindex_data[j].level);
 //	}
 
-	pindex->free(pindex, data);
+	return 0;
+}
+/* }}} */
+
+/* px_free_index_entries() {{{
+ * Frees the key data of the entries of a primary index read with
+ * PX_read_primary_index(), which PX_delete() does not free.
+ */
+static void px_free_index_entries(pxdoc_t *pindex) {
+	pxpindex_t *pindex_data = (pxpindex_t *) pindex->px_data;
+	int j;
+
+	if(pindex_data == NULL)
+		return;
+	for(j=0; j<pindex->px_datalen; j++) {
+		if(pindex_data[j].data)
+			pindex->free(pindex, pindex_data[j].data);
+		pindex_data[j].data = NULL;
+	}
+}
+/* }}} */
+
+/* px_delete_key_index() {{{
+ * Deletes the primary index file used for key lookups.
+ */
+static void px_delete_key_index(pxdoc_t *pxdoc) {
+	if(pxdoc->px_keyindex == NULL)
+		return;
+	px_free_index_entries(pxdoc->px_keyindex);
+	PX_delete(pxdoc->px_keyindex);
+	pxdoc->px_keyindex = NULL;
+}
+/* }}} */
+
+/* PX_set_key_index_file() {{{
+ * Reads the primary index file (.PX) of a keyed database for looking up
+ * records by their key with PX_plan_key_range(). Unlike with
+ * PX_add_primary_index() the self build index remains in use for all
+ * other accesses, so records keep their numbers and are scanned in the
+ * order of the block list. The index is read completely and the file is
+ * closed again. A previously set index is deleted.
+ * Returns 0 on success, otherwise -1.
+ */
+PXLIB_API int PXLIB_CALL
+PX_set_key_index_file(pxdoc_t *pxdoc, const char *filename) {
+	pxdoc_t *pindex;
+
+	if(pxdoc == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
+		return -1;
+	}
+
+	if(pxdoc->px_head == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Header of file has not been read."));
+		return -1;
+	}
+
+	if(NULL == (pindex = PX_new3(pxdoc->errorhandler, pxdoc->malloc, pxdoc->realloc, pxdoc->free, pxdoc->errorhandler_user_data))) {
+		px_error(pxdoc, PX_RuntimeError, _("Could not create new primary index object."));
+		return -1;
+	}
+
+	if(PX_open_file(pindex, filename) < 0) {
+		px_error(pxdoc, PX_RuntimeError, _("Could not open primary index file."));
+		PX_delete(pindex);
+		return -1;
+	}
+
+	if(PX_read_primary_index(pindex) < 0) {
+		PX_delete(pindex);
+		return -1;
+	}
+	PX_close(pindex);
+
+	if(px_check_primary_index(pxdoc, pindex) < 0) {
+		px_free_index_entries(pindex);
+		PX_delete(pindex);
+		return -1;
+	}
+
+	px_delete_key_index(pxdoc);
+	pxdoc->px_keyindex = pindex;
 	return 0;
 }
 /* }}} */
@@ -1171,6 +1558,7 @@ PX_write_primary_index(pxdoc_t *pxdoc, pxdoc_t *pxindex) {
 	}
 
 	if(NULL == pxdoc->px_indexdata) {
+		pxdoc->px_indexdeferred = px_false;
 		if(build_primary_index(pxdoc) < 0) {
 			return -1;
 		}
@@ -1238,6 +1626,9 @@ PX_write_primary_index(pxdoc_t *pxdoc, pxdoc_t *pxindex) {
  * index. The record number is not an absolut value. Accessing a
  * database file with and without the index may result in different
  * record numbers for the same record.
+ * If the self build index has not been modified since it was build,
+ * the block is looked up in its record map instead, which neither
+ * walks the index nor reads the block header again.
  * Returns 1 if record could be found, otherwise 0
  */
 int
@@ -1258,6 +1649,23 @@ px_get_record_pos_with_index(pxdoc_t *pxdoc, int recno, int *deleted, pxdatabloc
 		return 0;
 	}
 
+	if(pxdoc->px_recmap) {
+		pxrecmap_t *map;
+
+		if((j = px_find_record_map(pxdoc, recno)) < 0)
+			return 0;
+		map = &pxdoc->px_recmap[j];
+		pxdbinfo->number = map->blocknumber;
+		pxdbinfo->recno = recno - map->recno;
+		pxdbinfo->blockpos = map->blockpos;
+		pxdbinfo->recordpos = pxdbinfo->blockpos + sizeof(TDataBlock) + pxdbinfo->recno*pxh->px_recordsize;
+		pxdbinfo->prev = map->prev;
+		pxdbinfo->next = map->next;
+		pxdbinfo->size = map->numrecords*pxh->px_recordsize;
+		pxdbinfo->numrecords = map->numrecords;
+		return 1;
+	}
+
 	numrecords = 0 ;
 	recsperdatablock = (pxh->px_maxtablesize*0x400-sizeof(TDataBlock))/pxh->px_recordsize;
 	for(j=0; j<pxdoc->px_indexdatalen; j++) {
@@ -1275,7 +1683,7 @@ px_get_record_pos_with_index(pxdoc_t *pxdoc, int recno, int *deleted, pxdatabloc
 
 				pxdbinfo->number = pindex_data[j].blocknumber;
 				pxdbinfo->recno = recno;
-				pxdbinfo->blockpos = pxh->px_headersize + (pxdbinfo->number-1)*pxh->px_maxtablesize*0x400;
+				pxdbinfo->blockpos = pxh->px_headersize + (long) (pxdbinfo->number-1)*pxh->px_maxtablesize*0x400;
 				pxdbinfo->recordpos = pxdbinfo->blockpos + sizeof(TDataBlock) + recno*pxh->px_recordsize;
 
 				/* Go to the start of the data block (skip the header) */
@@ -1434,7 +1842,7 @@ px_find_slot_with_index(pxdoc_t *pxdoc, pxdatablockinfo_t *pxdbinfo) {
 
 				pxdbinfo->number = pindex_data[j].blocknumber;
 				pxdbinfo->recno = pindex_data[j].numrecords;
-				pxdbinfo->blockpos = pxh->px_headersize + (pxdbinfo->number-1)*pxh->px_maxtablesize*0x400;
+				pxdbinfo->blockpos = pxh->px_headersize + (long) (pxdbinfo->number-1)*pxh->px_maxtablesize*0x400;
 				pxdbinfo->recordpos = pxdbinfo->blockpos + sizeof(TDataBlock) + pxdbinfo->recno*pxh->px_recordsize;
 
 				/* Go to the start of the data block (skip the header) */
@@ -1544,6 +1952,9 @@ void
 px_list_index(pxdoc_t *pxdoc) {
 	pxpindex_t *pindex;
 	int i;
+	if(PX_load_index(pxdoc) < 0) {
+		return;
+	}
 	pindex = pxdoc->px_indexdata;
 	Rprintf("    | blocknr | numrecs \n");
 	Rprintf("------------------------\n");
@@ -1759,6 +2170,10 @@ PX_get_record2(pxdoc_t *pxdoc, int recno, char *data, int *deleted, pxdatablocki
 	}
 	pxh = pxdoc->px_head;
 
+	if(PX_load_index(pxdoc) < 0) {
+		return NULL;
+	}
+
 	/* Allow to read records up to the theoretical number of records
 	 * in the file or the actual number of records depending on 'deleted'.
 	 * If a primary index exists do not care about 'deleted' and read
@@ -1782,309 +2197,1191 @@ PX_get_record2(pxdoc_t *pxdoc, int recno, char *data, int *deleted, pxdatablocki
 			memcpy(pxdbinfo, &tmppxdbinfo, sizeof(pxdatablockinfo_t));
 		}
 
-		if((ret = pxdoc->seek(pxdoc, pxdoc->px_stream, tmppxdbinfo.recordpos, SEEK_SET)) < 0) {
-			px_error(pxdoc, PX_RuntimeError, _("Could not fseek start of record data."));
-			return NULL;
-		}
-		if((ret = (int)pxdoc->read(pxdoc, pxdoc->px_stream, pxh->px_recordsize, data)) < 0) {
-			px_error(pxdoc, PX_RuntimeError, _("Could not read data of record."));
-			return NULL;
+		if((ret = pxdoc->seek(pxdoc, pxdoc->px_stream, tmppxdbinfo.recordpos, SEEK_SET)) < 0) {
+			px_error(pxdoc, PX_RuntimeError, _("Could not fseek start of record data."));
+			return NULL;
+		}
+		if((ret = (int)pxdoc->read(pxdoc, pxdoc->px_stream, pxh->px_recordsize, data)) < 0) {
+			px_error(pxdoc, PX_RuntimeError, _("Could not read data of record."));
+			return NULL;
+		}
+		return data;
+	} else {
+		px_error(pxdoc, PX_RuntimeError, _("Could not find record in database."));
+		return NULL;
+	}
+}
+/* }}} */
+
+/* PX_put_recordn() {{{
+ * Store a record into the paradox file. The record can be saved at
+ * any position. If the position is beyond the last datablock, then
+ * new datablocks will be added until the position lies in a
+ * datablock. You may use this function to end a datablock and
+ * start a new one. If the position is in the middle of a data block
+ * without any records before this position, the position will be
+ * recalculated and the record is placed after the last record in
+ * that datablock.
+ * Returns the next postion or -1 in case of an error.
+ */
+PXLIB_API int PXLIB_CALL
+PX_put_recordn(pxdoc_t *pxdoc, char *data, int recpos) {
+	pxhead_t *pxh;
+	unsigned itmp, datablocknr;
+	int recsperdatablock, recdatablocknr;
+	int update; /* Will be set by px_add_data_to_block() if an existing
+				   record is updated */
+
+	if(pxdoc == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
+		return -1;
+	}
+
+	if(pxdoc->px_head == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("File has no header."));
+		return -1;
+	}
+	pxh = pxdoc->px_head;
+
+//	fprintf(stderr, "Putting record at position %d\n", recpos);
+
+	/* All the following calculation assume sequentially writing of
+	 * records and filling a datablock first before starting a new one.
+	 * This should be fixed. Better would be, if we keep record
+	 * in px_data (like a primary index) which datablocks are available
+	 * an how much space they still have.
+	 */
+	/* Check if record still fits into a existing data block */
+	recsperdatablock = (pxh->px_maxtablesize*0x400-sizeof(TDataBlock)) / pxh->px_recordsize;
+	/* Calculate the number of the data block for this record.
+	 * Datablock numbers start at 1. */
+	datablocknr = (recpos / recsperdatablock) + 1;
+	/* Calculate the position within the datablock */
+	recdatablocknr = recpos % recsperdatablock;
+
+//	fprintf(stderr, "Data goes into block %d at record no %d (%d)\n", datablocknr, recdatablocknr, recsperdatablock);
+	/* add as many datablocks as require to store the record at the
+	 * desired position. */
+	itmp = datablocknr;
+	while(datablocknr > pxh->px_fileblocks) {
+//		fprintf(stderr, "We need an new datablock\n");
+		itmp = put_px_datablock(pxdoc, pxh, pxh->px_lastblock, pxdoc->px_stream);
+		if(itmp < 0) {
+			px_error(pxdoc, PX_RuntimeError, _("Could not write new data block."));
+			return -1;
+		}
+//		fprintf(stderr, "Added data block no. %d\n", itmp);
+	}
+	/* The datablock number return by px_put_datablock() should be
+	 * the same as the calculated datablocknr after all datablocks
+	 * has been added.
+	 */
+	if(datablocknr != itmp) {
+		px_error(pxdoc, PX_RuntimeError, _("Inconsistency in writing data block. Expected data block nr. %d, but got %d."), datablocknr, itmp);
+		return -1;
+	}
+
+	/* write data */
+	itmp = px_add_data_to_block(pxdoc, pxh, datablocknr, recdatablocknr, data, pxdoc->px_stream, &update);
+
+	/* The record number within the data block must be the same
+	 * as the calculated one.
+	 */
+	if(itmp < 0) {
+		px_error(pxdoc, PX_RuntimeError, _("Inconsistency in writing record into data block. Expected record nr. %d, but got %d. %dth record. %dth data block. %d records per block."), recdatablocknr, itmp, pxh->px_numrecords+1, datablocknr, recsperdatablock);
+		return -1;
+	}
+	
+	if(itmp != recdatablocknr) {
+		px_error(pxdoc, PX_Warning, _("Position of record has been recalculated. Requested position was %d, new position is %d."), recpos, (datablocknr-1) * recsperdatablock + itmp);
+	}
+
+	/* Update header:
+	 * Modify the last_postion only if a record was added at the end.
+	 * increment the record count only if a record was added not updated */
+	if(recpos >= pxh->px_numrecords) {
+		pxdoc->last_position = (datablocknr-1) * recsperdatablock + itmp;
+	}
+	if(update == 0) {
+		pxh->px_numrecords++;
+	}
+
+	put_px_head(pxdoc, pxh, pxdoc->px_stream);
+	return(pxdoc->last_position+1);
+}
+/* }}} */
+
+/* PX_put_record() {{{
+ * Stores a record into the paradox file. It uses the next free
+ * slot in the database.
+ * Returns the next postion (recpos+1) or -1 in case of an error.
+ */
+PXLIB_API int PXLIB_CALL
+PX_put_record(pxdoc_t *pxdoc, char *data) {
+	return(PX_put_recordn(pxdoc, data, pxdoc->last_position+1));
+}
+/* }}} */
+
+/* PX_convert_field() {{{
+ * Convert the raw data of a single field into a field value. The
+ * value must have been initialized with zeros, e.g. by MAKE_PXVAL().
+ * Strings and blobs are allocated with the memory allocation functions
+ * of the database, or taken from its arena, and must be freed by the
+ * caller with PX_arena_free().
+ */
+PXLIB_API void PXLIB_CALL
+PX_convert_field(pxdoc_t *pxdoc, pxfield_t *pxf, char *data, pxval_t *val) {
+	val->type = pxf->px_ftype;
+	switch(pxf->px_ftype) {
+		case pxfAlpha: {
+			char *value;
+			int ret;
+			if(0 < (ret = PX_get_data_alpha(pxdoc, data, pxf->px_flen, &value))) {
+				val->value.str.val = value;
+				val->value.str.len = (int)strlen(value);
+			} else if(ret < 0) {
+				val->isnull = 1;
+				px_error(pxdoc, PX_RuntimeError, _("Could not read of field of type pxfAlpha."));
+			} else {
+				val->isnull = 1;
+			}
+			break;
+		}
+		case pxfShort: {
+			short int value;
+			if(0 < PX_get_data_short(pxdoc, data, pxf->px_flen, &value)) {
+				val->value.lval = (long) value;
+			} else {
+				val->isnull = 1;
+			}
+			break;
+			}
+		case pxfDate:
+		case pxfTime:
+		case pxfAutoInc:
+		case pxfLong: {
+			long value;
+			if(0 < PX_get_data_long(pxdoc, data, pxf->px_flen, &value)) {
+				val->value.lval = value;
+			} else {
+				val->isnull = 1;
+			}
+			break;
+			}
+		case pxfTimestamp:
+		case pxfCurrency:
+		case pxfNumber: {
+			double value;
+			if(0 < PX_get_data_double(pxdoc, data, pxf->px_flen, &value)) {
+				val->value.dval = value;
+			} 
+			break;
+			} 
+		case pxfLogical: {
+			char value;
+			if(0 < PX_get_data_byte(pxdoc, data, pxf->px_flen, &value)) {
+				val->value.lval = (long) value;
+			} else {
+				val->isnull = 1;
+			}
+			break;
+			}
+		case pxfGraphic:
+		case pxfBLOb:
+		case pxfFmtMemoBLOb:
+		case pxfMemoBLOb:
+		case pxfOLE: {
+			char *blobdata;
+			int mod_nr, size, ret;
+			if(pxf->px_ftype == pxfGraphic)
+				ret = PX_get_data_graphic(pxdoc, data, pxf->px_flen, &mod_nr, &size, &blobdata);
+			else
+				ret = PX_get_data_blob(pxdoc, data, pxf->px_flen, &mod_nr, &size, &blobdata);
+			if(ret > 0) {
+				if(blobdata) {
+					val->value.str.val = blobdata;
+					val->value.str.len = size;
+				} else {
+					val->isnull = 1;
+					px_error(pxdoc, PX_RuntimeError, _("Could not read blob data."));
+				}
+			} else if(ret == 0) {
+				val->isnull = 1;
+			} else {
+				px_error(pxdoc, PX_RuntimeError, _("Could not read blob data."));
+			}
+
+			break;
+		}
+		case pxfBytes: {
+			char *value;
+			if(0 < PX_get_data_bytes(pxdoc, data, pxf->px_flen, &value)) {
+				val->value.str.val = value;
+				val->value.str.len = pxf->px_flen;
+			} else {
+				val->isnull = 1;
+			}
+			break;
+			}
+		case pxfBCD: {
+			char *value;
+			if(0 < PX_get_data_bcd(pxdoc, (unsigned char*) data, pxf->px_fdc, &value)) {
+				val->value.str.val = value;
+				val->value.str.len = (int)strlen(value);
+			} else {
+				val->isnull = 1;
+			}
+			break;
+		}
+		default:
+			val->isnull = 1;
+			break;
+	}
+}
+/* }}} */
+
+/* PX_convert_record() {{{
+ * Convert the raw data of a record into an array of field values.
+ * The record data must have the size of a record as returned by
+ * PX_get_recordsize(), e.g. as read by PX_get_record() or handed over
+ * by PX_scan_blocks().
+ * Within a scope of the arena, see PX_arena_begin(), the array and the
+ * values are taken from the arena.
+ * Returns an array of *pxval_t or NULL in case of an error.
+ */
+PXLIB_API pxval_t ** PXLIB_CALL
+PX_convert_record(pxdoc_t *pxdoc, char *data) {
+	pxhead_t *pxh;
+	int i, offset;
+	pxval_t **dataptr;
+	pxfield_t *pxf;
+
+	if(pxdoc == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
+		return NULL;
+	}
+
+	if(pxdoc->px_head == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("File has no header."));
+		return NULL;
+	}
+	pxh = pxdoc->px_head;
+
+	/* Allocate memory for return record */
+	if(NULL == (dataptr = (pxval_t **) px_arena_malloc(pxdoc, pxh->px_numfields*sizeof(pxval_t *), _("Allocate memory for array of pointers to field values.")))) {
+		px_error(pxdoc, PX_RuntimeError, _("Could not allocate memory for array of pointers to field values."));
+		return NULL;
+	}
+	pxf = PX_get_fields(pxdoc);
+	offset = 0;
+	for(i=0; i<PX_get_num_fields(pxdoc); i++) {
+		if(NULL == (dataptr[i] = (pxval_t *) px_arena_malloc(pxdoc, sizeof(pxval_t), _("Allocate memory for pxval_t")))) {
+			px_error(pxdoc, PX_RuntimeError, _("Could not allocate memory for field value."));
+			while(--i >= 0)
+				px_arena_free(pxdoc, dataptr[i]);
+			px_arena_free(pxdoc, dataptr);
+			return NULL;
+		}
+		memset(dataptr[i], 0, sizeof(pxval_t));
+		PX_convert_field(pxdoc, pxf, &data[offset], dataptr[i]);
+		offset += pxf->px_flen;
+		pxf++;
+	}
+/*
+	if(filetype == pxfFileTypPrimIndex) {
+		short int value;
+		if(0 < PX_get_data_short(pxdoc, &data[offset], 2, &value)) {
+			fprintf(outfp, "%d", value);
+		}
+		offset += 2;
+		if(0 < PX_get_data_short(pxdoc, &data[offset], 2, &value)) {
+			fprintf(outfp, "%d", value);
+			ireccounter += value;
+		}
+		offset += 2;
+		if(0 < PX_get_data_short(pxdoc, &data[offset], 2, &value)) {
+			fprintf(outfp, "%d", value);
+		}
+		fprintf(outfp, "%d", pxdbinfo.number);
+	}
+	if(markdeleted) {
+		fprintf(outfp, "%d", isdeleted);
+	}
+*/
+	return(dataptr);
+}
+/* }}} */
+
+/* PX_retrieve_record() {{{
+ * Get a record from the paradox file. The raw record is read into a
+ * buffer kept in the document for the next call.
+ * Returns an array of *pxval_t or NULL in case of an error.
+ */
+PXLIB_API pxval_t ** PXLIB_CALL
+PX_retrieve_record(pxdoc_t *pxdoc, int recno) {
+	pxhead_t *pxh;
+	char *data;
+
+	if(pxdoc == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
+		return NULL;
+	}
+
+	if(pxdoc->px_head == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("File has no header."));
+		return NULL;
+	}
+	pxh = pxdoc->px_head;
+
+	/* Allocate memory for record once, the record size never changes
+	 * while reading.
+	 */
+	if(pxdoc->px_recbuf == NULL) {
+		if((pxdoc->px_recbuf = (char *) pxdoc->malloc(pxdoc, pxh->px_recordsize, _("Allocate memory for temporary record."))) == NULL) {
+			px_error(pxdoc, PX_RuntimeError, _("Could not allocate memory for temporary record."));
+			return NULL;
+		}
+	}
+	data = pxdoc->px_recbuf;
+
+	if(NULL != PX_get_record(pxdoc, recno, data)) {
+		return(PX_convert_record(pxdoc, data));
+	} else {
+		px_error(pxdoc, PX_RuntimeError, _("Could not read data for record with number %d."), recno);
+		return NULL;
+	}
+}
+/* }}} */
+
+/* PX_arena_begin() {{{
+ * Starts a scope of the arena of the document. Until PX_arena_end(),
+ * the strings and blobs returned by PX_convert_field() and the values
+ * of PX_convert_record() are taken from the arena instead of being
+ * allocated one by one. They stay valid until the next call of
+ * PX_arena_begin() or PX_arena_end(), which release all of them at
+ * once. They must not be passed to pxdoc->free(), but to
+ * PX_arena_free(), which only frees them outside of a scope.
+ * A scan calls this once per record or block and PX_arena_end() at the
+ * end. Each document has its own arena, so documents read on different
+ * threads do not share any memory management.
+ * The arena requires the default memory management functions.
+ * Returns 0 on success or -1 in case of an error.
+ */
+PXLIB_API int PXLIB_CALL
+PX_arena_begin(pxdoc_t *pxdoc) {
+	if(pxdoc == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
+		return -1;
+	}
+
+	if(pxdoc->free != _px_free) {
+		px_error(pxdoc, PX_RuntimeError, _("An arena cannot be used with your own memory management functions."));
+		return -1;
+	}
+
+	if(pxdoc->px_arena == NULL) {
+		if(NULL == (pxdoc->px_arena = px_arena_new(pxdoc)))
+			return -1;
+	}
+	px_arena_set_scope(pxdoc, pxdoc->px_arena, 1);
+	return 0;
+}
+/* }}} */
+
+/* PX_arena_end() {{{
+ * Ends the scope of the arena and releases all memory taken from it.
+ * The chunks of the arena are kept for the next scope.
+ */
+PXLIB_API void PXLIB_CALL
+PX_arena_end(pxdoc_t *pxdoc) {
+	if(pxdoc == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
+		return;
+	}
+
+	if(pxdoc->px_arena)
+		px_arena_set_scope(pxdoc, pxdoc->px_arena, 0);
+}
+/* }}} */
+
+/* PX_arena_free() {{{
+ * Frees a string or blob returned by PX_convert_field(). Within a scope
+ * of the arena this does nothing, see PX_arena_begin().
+ */
+PXLIB_API void PXLIB_CALL
+PX_arena_free(pxdoc_t *pxdoc, void *ptr) {
+	if(pxdoc == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
+		return;
+	}
+
+	px_arena_free(pxdoc, ptr);
+}
+/* }}} */
+
+/* PX_scan_init() {{{
+ * Initializes a scan position to the first record of the database.
+ */
+PXLIB_API void PXLIB_CALL
+PX_scan_init(pxdoc_t *pxdoc, pxscanpos_t *pos) {
+	(void) pxdoc;
+	memset(pos, 0, sizeof(pxscanpos_t));
+}
+/* }}} */
+
+/* px_scan_readahead() {{{
+ * Announces the data blocks of the primary index from entry first on,
+ * which a scan is going to read next, see px_readahead(). At most
+ * readaheadblocks blocks are announced, adjacent blocks as one range.
+ * Returns the index entry behind the last block announced.
+ */
+static int px_scan_readahead(pxdoc_t *pxdoc, int first) {
+	pxpindex_t *pindex = pxdoc->px_indexdata;
+	int i, n, start, len;
+
+	start = len = 0;
+	for(i=first, n=0; i<pxdoc->px_indexdatalen && n<pxdoc->readaheadblocks; i++) {
+		if(pindex[i].level != 1)
+			continue;
+		n++;
+		if(len > 0 && pindex[i].blocknumber == start+len) {
+			len++;
+			continue;
+		}
+		if(len > 0)
+			px_readahead(pxdoc, start, len);
+		start = pindex[i].blocknumber;
+		len = 1;
+	}
+	if(len > 0)
+		px_readahead(pxdoc, start, len);
+	return i;
+}
+/* }}} */
+
+/* px_scan_get_block() {{{
+ * Reads a data block for a scan. With the builtin read function the
+ * block is taken directly from the block cache or the memory mapping.
+ * Otherwise it is read into buffer, which must hold a complete block.
+ * Returns a pointer to the block or NULL in case of an error.
+ */
+static unsigned char *px_scan_get_block(pxdoc_t *pxdoc, int blocknumber, unsigned char *buffer) {
+	pxhead_t *pxh = pxdoc->px_head;
+	int blocksize = pxh->px_maxtablesize*0x400;
+	unsigned char *block;
+	double start = 0;
+
+	if(buffer == NULL) {
+		if(NULL == (block = px_get_block(pxdoc, blocknumber))) {
+			px_error(pxdoc, PX_RuntimeError, _("Could not read data block nr. %d."), blocknumber);
+			return NULL;
+		}
+		return block;
+	}
+	if(pxdoc->px_stats)
+		start = px_time_ns();
+	if(pxdoc->seek(pxdoc, pxdoc->px_stream, pxh->px_headersize+(long) (blocknumber-1)*blocksize, SEEK_SET) < 0) {
+		px_error(pxdoc, PX_RuntimeError, _("Could not fseek start of data block nr. %d."), blocknumber);
+		return NULL;
+	}
+	if(pxdoc->read(pxdoc, pxdoc->px_stream, blocksize, buffer) < 0) {
+		px_error(pxdoc, PX_RuntimeError, _("Could not read data block nr. %d."), blocknumber);
+		return NULL;
+	}
+	if(pxdoc->px_stats) {
+		pxdoc->px_stats->nsio += px_time_ns() - start;
+		pxdoc->px_stats->blocksread++;
+		pxdoc->px_stats->bytesread += blocksize;
+	}
+	return buffer;
+}
+/* }}} */
+
+/* px_scan_call() {{{
+ * Passes numrecords records of a block to the callback of a scan.
+ * The time spent in the callback is counted as decoding if the
+ * statistics are enabled.
+ */
+static int px_scan_call(pxdoc_t *pxdoc, px_scan_callback_t callback, int recno, char *records, int numrecords, void *user_data) {
+	pxstats_t *stats = pxdoc->px_stats;
+	double start;
+	int ret;
+
+	if(stats == NULL)
+		return callback(pxdoc, recno, records, numrecords, user_data);
+	start = px_time_ns();
+	ret = callback(pxdoc, recno, records, numrecords, user_data);
+	stats->nsdecode += px_time_ns() - start;
+	stats->recordsdecoded += numrecords;
+	return ret;
+}
+/* }}} */
+
+/* px_scan_range() {{{
+ * Implements PX_scan_range() and, if chain is set, PX_scan_chain(), see
+ * there.
+ */
+static int px_scan_range(pxdoc_t *pxdoc, pxscanpos_t *pos, int maxrecords, px_scan_callback_t callback, void *user_data, int chain) {
+	pxhead_t *pxh;
+	pxpindex_t *pindex;
+	pxrecmap_t *map;
+	unsigned char *block, *buffer;
+	int blocksize, recsperblock, passed, ret, announced;
+
+	if(pxdoc == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
+		return -1;
+	}
+
+	if(pxdoc->px_head == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("File has no header."));
+		return -1;
+	}
+	pxh = pxdoc->px_head;
+
+	if(!chain && PX_load_index(pxdoc) < 0) {
+		return -1;
+	}
+
+	if(pos == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a scan position."));
+		return -1;
+	}
+
+	if(pxh->px_recordsize <= 0 || pxh->px_numrecords <= 0) {
+		return 0;
+	}
+
+	/* Skipping with the record map jumps to the target block directly,
+	 * provided the blocks hold exactly the records of the header.
+	 */
+	map = pxdoc->px_recmap;
+	if(!chain && callback == NULL && map && pxdoc->px_recmaplen > 0 &&
+	   map[pxdoc->px_recmaplen-1].recno+map[pxdoc->px_recmaplen-1].numrecords == pxh->px_numrecords) {
+		int target, entry;
+
+		target = pxh->px_numrecords;
+		if(maxrecords >= 0 && maxrecords < target-pos->recno)
+			target = pos->recno+maxrecords;
+		if(target > pos->recno) {
+			if((entry = px_find_record_map(pxdoc, target)) >= 0) {
+				pos->blockcount = map[entry].entry;
+				pos->blocknumber = map[entry].blocknumber;
+				pos->recinblock = target-map[entry].recno;
+			} else {
+				/* All records have been skipped. */
+				pos->blockcount = map[pxdoc->px_recmaplen-1].entry+1;
+				pos->blocknumber = 0;
+				pos->recinblock = 0;
+			}
+			pos->recno = target;
+		}
+		return 0;
+	}
+
+	blocksize = pxh->px_maxtablesize*0x400;
+	recsperblock = (blocksize-(int)sizeof(TDataBlock))/pxh->px_recordsize;
+	/* With the builtin read function the blocks are taken directly from
+	 * the block cache or the memory mapping. Otherwise they are copied
+	 * into a buffer.
+	 */
+	buffer = NULL;
+	if(pxdoc->read != px_read) {
+		if((buffer = (unsigned char *) pxdoc->malloc(pxdoc, blocksize, _("Allocate memory for data block."))) == NULL) {
+			px_error(pxdoc, PX_MemoryError, _("Could not allocate memory for data block."));
+			return -1;
+		}
+	}
+
+	/* Use the blocks of the primary index if it exists. It has been
+	 * build by following the block list, so it has the same order.
+	 * Without an index the block list is followed directly.
+	 */
+	pindex = chain ? NULL : pxdoc->px_indexdata;
+	ret = 0;
+	passed = 0;
+	announced = 0;
+	if(!chain && pos->blockcount == 0)
+		pos->blocknumber = pxh->px_firstblock;
+	while((pos->recno < pxh->px_numrecords) && (maxrecords < 0 || passed < maxrecords)) {
+		TDataBlock *datablockhead;
+		int numrecords, count, next;
+
+		if(pindex) {
+			if(pos->blockcount >= pxdoc->px_indexdatalen)
+				break;
+			if(pindex[pos->blockcount].level != 1) {
+				pos->blockcount++;
+				continue;
+			}
+			pos->blocknumber = pindex[pos->blockcount].blocknumber;
+		} else if((pos->blockcount >= pxh->px_fileblocks) || (pos->blocknumber <= 0)) {
+			break;
+		} else if(chain && pos->blocknumber > (int) pxh->px_fileblocks) {
+			px_error(pxdoc, PX_RuntimeError, _("Block list refers to data block nr. %d, but file has only %d blocks."), pos->blocknumber, pxh->px_fileblocks);
+			ret = -1;
+			break;
+		}
+
+		if(callback == NULL && pindex) {
+			/* Skipping with an index does not need the block itself. */
+			numrecords = pindex[pos->blockcount].numrecords;
+			block = NULL;
+			datablockhead = NULL;
+		} else {
+			/* Announce the next blocks while half of the last ones are still ahead. */
+			if(pindex && pxdoc->readaheadblocks > 0 &&
+			   pos->blockcount+1+pxdoc->readaheadblocks/2 >= announced) {
+				announced = px_scan_readahead(pxdoc, max(announced, pos->blockcount+1));
+			}
+			if(NULL == (block = px_scan_get_block(pxdoc, pos->blocknumber, buffer))) {
+				ret = -1;
+				break;
+			}
+			datablockhead = (TDataBlock *) block;
+			numrecords = (get_short_le((char *) &datablockhead->addDataSize)/pxh->px_recordsize)+1;
+		}
+		if(numrecords > recsperblock)
+			numrecords = recsperblock;
+		if(numrecords > pxh->px_numrecords-(pos->recno-pos->recinblock))
+			numrecords = pxh->px_numrecords-(pos->recno-pos->recinblock);
+
+		count = numrecords - pos->recinblock;
+		if(maxrecords >= 0 && count > maxrecords-passed)
+			count = maxrecords-passed;
+		if(count > 0) {
+			if(callback)
+				ret = px_scan_call(pxdoc, callback, pos->recno, (char *) block+sizeof(TDataBlock)+pos->recinblock*pxh->px_recordsize, count, user_data);
+			pos->recinblock += count;
+			pos->recno += count;
+			passed += count;
+			if(ret != 0)
+				break;
+		}
+
+		/* Go to the next block once this one has been passed completely. */
+		if(pos->recinblock >= numrecords) {
+			next = datablockhead ? get_short_le((char *) &datablockhead->nextBlock) : 0;
+			/* Without an index only the next block is known. */
+			if(!pindex && next > 0 && pxdoc->readaheadblocks > 0)
+				px_readahead(pxdoc, next, 1);
+			pos->blockcount++;
+			pos->blocknumber = next;
+			pos->recinblock = 0;
+		}
+	}
+
+	if(buffer)
+		pxdoc->free(pxdoc, buffer);
+	return ret;
+}
+/* }}} */
+
+/* PX_scan_range() {{{
+ * Reads records of the database block by block, starting at the scan
+ * position pos. The data blocks are visited in the order of the block
+ * list, starting with px_firstblock and following the nextBlock field.
+ * Each block is read (and decrypted) only once and its records are
+ * passed to the callback function without copying as one chunk of
+ * numrecords * PX_get_recordsize() bytes. The first argument after the
+ * database is the number of the first record in the chunk, counting
+ * from 0, like for PX_retrieve_record().
+ * At most maxrecords records are passed in total, all remaining
+ * records if maxrecords is negative. The number of records never
+ * exceeds the number of records in the header. The scan position is
+ * advanced behind the last record passed, so a subsequent call will
+ * continue where this call has stopped.
+ * If callback is NULL the records are just skipped. If a primary
+ * index exists, skipping does not read any data block, and with the
+ * record map of a self build index it takes logarithmic time.
+ * While reading, the next readaheadblocks blocks are announced to the
+ * operating system, which can then read them in the background.
+ * The record data is only valid during the callback and must not be
+ * modified.
+ * If the callback returns a value != 0, the scan will be stopped and
+ * the value is returned.
+ * Returns 0 on success, otherwise -1 or the return value of the callback.
+ */
+PXLIB_API int PXLIB_CALL
+PX_scan_range(pxdoc_t *pxdoc, pxscanpos_t *pos, int maxrecords, px_scan_callback_t callback, void *user_data) {
+	return px_scan_range(pxdoc, pos, maxrecords, callback, user_data, 0);
+}
+/* }}} */
+
+/* PX_scan_chain() {{{
+ * Reads records like PX_scan_range(), but always follows the nextBlock
+ * fields of the data blocks, starting at the block pos->blocknumber,
+ * instead of using the primary index. The index is not built, so the
+ * scan can start at any block of the list without reading the blocks
+ * before it, e.g. at the last block of an earlier read to get the
+ * records appended since. pos->recno must be the number of the record
+ * at pos->recinblock in that block. pos->blockcount counts the blocks
+ * passed; at most px_fileblocks blocks are visited in total, which
+ * stops the scan on a block list with a cycle.
+ * Once the scan has passed the last block of the list, pos->blocknumber
+ * is 0.
+ * Returns 0 on success, otherwise -1 or the return value of the callback.
+ */
+PXLIB_API int PXLIB_CALL
+PX_scan_chain(pxdoc_t *pxdoc, pxscanpos_t *pos, int maxrecords, px_scan_callback_t callback, void *user_data) {
+	return px_scan_range(pxdoc, pos, maxrecords, callback, user_data, 1);
+}
+/* }}} */
+
+/* PX_scan_blocks() {{{
+ * Reads all records of the database block by block and passes them
+ * to the callback function. See PX_scan_range() for details.
+ * Returns 0 if all blocks could be read, otherwise -1 or the return
+ * value of the callback.
+ */
+PXLIB_API int PXLIB_CALL
+PX_scan_blocks(pxdoc_t *pxdoc, px_scan_callback_t callback, void *user_data) {
+	pxscanpos_t pos;
+
+	if(callback == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a callback function."));
+		return -1;
+	}
+	PX_scan_init(pxdoc, &pos);
+	return PX_scan_range(pxdoc, &pos, -1, callback, user_data);
+}
+/* }}} */
+
+/* PX_scan_plan() {{{
+ * Determines the data blocks PX_scan_range() would visit when reading
+ * maxrecords records from the scan position pos, without reading any
+ * of them. This requires the primary index. The blocks are returned in
+ * an array allocated with pxdoc->malloc(), which must be freed by the
+ * caller. Each entry holds the block number, the number of the first
+ * record read from the block, its position within the block and the
+ * number of records read. The scan position is advanced like by
+ * PX_scan_range().
+ * This allows the blocks to be read independently of each other, e.g.
+ * by several threads.
+ * Returns the number of blocks or -1 in case of an error.
+ */
+PXLIB_API int PXLIB_CALL
+PX_scan_plan(pxdoc_t *pxdoc, pxscanpos_t *pos, int maxrecords, pxscanblock_t **blocks) {
+	pxhead_t *pxh;
+	pxpindex_t *pindex;
+	pxscanblock_t *list;
+	int recsperblock, passed, numblocks;
+
+	if(pxdoc == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
+		return -1;
+	}
+
+	if(pxdoc->px_head == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("File has no header."));
+		return -1;
+	}
+	pxh = pxdoc->px_head;
+
+	if(PX_load_index(pxdoc) < 0) {
+		return -1;
+	}
+
+	if(pos == NULL || blocks == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a scan position or block list."));
+		return -1;
+	}
+
+	if((pindex = pxdoc->px_indexdata) == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Planning a scan requires the primary index."));
+		return -1;
+	}
+
+	*blocks = NULL;
+	if(pxh->px_recordsize <= 0 || pxh->px_numrecords <= 0) {
+		return 0;
+	}
+
+	/* There cannot be more blocks than index entries. */
+	if((list = (pxscanblock_t *) pxdoc->malloc(pxdoc, (pxdoc->px_indexdatalen+1)*sizeof(pxscanblock_t), _("Allocate memory for block list."))) == NULL) {
+		px_error(pxdoc, PX_MemoryError, _("Could not allocate memory for block list."));
+		return -1;
+	}
+
+	recsperblock = (pxh->px_maxtablesize*0x400-(int)sizeof(TDataBlock))/pxh->px_recordsize;
+	passed = 0;
+	numblocks = 0;
+	while((pos->recno < pxh->px_numrecords) && (maxrecords < 0 || passed < maxrecords)) {
+		int numrecords, count;
+
+		if(pos->blockcount >= pxdoc->px_indexdatalen)
+			break;
+		if(pindex[pos->blockcount].level != 1) {
+			pos->blockcount++;
+			continue;
+		}
+		pos->blocknumber = pindex[pos->blockcount].blocknumber;
+
+		/* Same limits as in PX_scan_range() */
+		numrecords = pindex[pos->blockcount].numrecords;
+		if(numrecords > recsperblock)
+			numrecords = recsperblock;
+		if(numrecords > pxh->px_numrecords-(pos->recno-pos->recinblock))
+			numrecords = pxh->px_numrecords-(pos->recno-pos->recinblock);
+
+		count = numrecords - pos->recinblock;
+		if(maxrecords >= 0 && count > maxrecords-passed)
+			count = maxrecords-passed;
+		if(count > 0) {
+			list[numblocks].blocknumber = pos->blocknumber;
+			list[numblocks].recno = pos->recno;
+			list[numblocks].recinblock = pos->recinblock;
+			list[numblocks].numrecords = count;
+			numblocks++;
+			pos->recinblock += count;
+			pos->recno += count;
+			passed += count;
+		}
+
+		if(pos->recinblock >= numrecords) {
+			pos->blockcount++;
+			pos->blocknumber = 0;
+			pos->recinblock = 0;
 		}
-		return data;
-	} else {
-		px_error(pxdoc, PX_RuntimeError, _("Could not find record in database."));
-		return NULL;
 	}
+
+	*blocks = list;
+	return numblocks;
 }
 /* }}} */
 
-/* PX_put_recordn() {{{
- * Store a record into the paradox file. The record can be saved at
- * any position. If the position is beyond the last datablock, then
- * new datablocks will be added until the position lies in a
- * datablock. You may use this function to end a datablock and
- * start a new one. If the position is in the middle of a data block
- * without any records before this position, the position will be
- * recalculated and the record is placed after the last record in
- * that datablock.
- * Returns the next postion or -1 in case of an error.
+/* PX_plan_key_range() {{{
+ * Determines the data blocks which can hold records with a primary key
+ * between keyfrom and keyto (both inclusive), using the primary index
+ * file set with PX_set_key_index_file(). keyfrom and keyto point to key
+ * data as stored in the records; the first keylen bytes are compared
+ * like Paradox sorts numbers, dates and times, byte by byte. Either of
+ * them may be NULL for an open end of the range.
+ * Each level 1 entry of the index holds the key of the first record of
+ * its block, and the entries are sorted by key. A block can therefore
+ * only hold keys from its own entry up to that of the next block, which
+ * is included as well, because keylen may cover just the first field of
+ * a compound key.
+ * The blocks are returned like by PX_scan_plan(), in the order of the
+ * index, each with all of its records; the records themselves have to
+ * be checked by the caller. The record numbers are those of the self
+ * build index.
+ * Returns the number of blocks or -1 in case of an error.
  */
 PXLIB_API int PXLIB_CALL
-PX_put_recordn(pxdoc_t *pxdoc, char *data, int recpos) {
-	pxhead_t *pxh;
-	unsigned itmp, datablocknr;
-	int recsperdatablock, recdatablocknr;
-	int update; /* Will be set by px_add_data_to_block() if an existing
-				   record is updated */
+PX_plan_key_range(pxdoc_t *pxdoc, const char *keyfrom, const char *keyto, int keylen, pxscanblock_t **blocks) {
+	pxdoc_t *pindex;
+	pxpindex_t *pindex_data;
+	pxrecmap_t *map;
+	pxscanblock_t *list;
+	int *entryofblock;
+	int i, j, k, numblocks, numentries, maxblocknumber;
 
 	if(pxdoc == NULL) {
 		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
 		return -1;
 	}
 
-	if(pxdoc->px_head == NULL) {
-		px_error(pxdoc, PX_RuntimeError, _("File has no header."));
+	if(blocks == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a block list."));
 		return -1;
 	}
-	pxh = pxdoc->px_head;
+	*blocks = NULL;
 
-//	fprintf(stderr, "Putting record at position %d\n", recpos);
+	if((pindex = pxdoc->px_keyindex) == NULL || pindex->px_data == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Key lookups require a primary index file."));
+		return -1;
+	}
 
-	/* All the following calculation assume sequentially writing of
-	 * records and filling a datablock first before starting a new one.
-	 * This should be fixed. Better would be, if we keep record
-	 * in px_data (like a primary index) which datablocks are available
-	 * an how much space they still have.
+	if(keylen <= 0 || keylen > pindex->px_head->px_recordsize-6) {
+		px_error(pxdoc, PX_RuntimeError, _("Length of key data is out of range."));
+		return -1;
+	}
+
+	/* The blocks are located in the record map of the self build index. */
+	if(PX_load_index(pxdoc) < 0) {
+		return -1;
+	}
+	if((map = pxdoc->px_recmap) == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Key lookups require the record map of the self build index."));
+		return -1;
+	}
+
+	/* Entry of the record map of each block number, or -1, so that the
+	 * blocks of the index are found in constant time.
 	 */
-	/* Check if record still fits into a existing data block */
-	recsperdatablock = (pxh->px_maxtablesize*0x400-sizeof(TDataBlock)) / pxh->px_recordsize;
-	/* Calculate the number of the data block for this record.
-	 * Datablock numbers start at 1. */
-	datablocknr = (recpos / recsperdatablock) + 1;
-	/* Calculate the position within the datablock */
-	recdatablocknr = recpos % recsperdatablock;
+	maxblocknumber = 0;
+	for(k=0; k<pxdoc->px_recmaplen; k++) {
+		if(map[k].blocknumber > maxblocknumber)
+			maxblocknumber = map[k].blocknumber;
+	}
+	if((entryofblock = (int *) pxdoc->malloc(pxdoc, (maxblocknumber+1)*sizeof(int), _("Allocate memory for block lookup."))) == NULL) {
+		px_error(pxdoc, PX_MemoryError, _("Could not allocate memory for block lookup."));
+		return -1;
+	}
+	for(k=0; k<=maxblocknumber; k++)
+		entryofblock[k] = -1;
+	for(k=0; k<pxdoc->px_recmaplen; k++) {
+		if(map[k].blocknumber >= 0)
+			entryofblock[map[k].blocknumber] = k;
+	}
 
-//	fprintf(stderr, "Data goes into block %d at record no %d (%d)\n", datablocknr, recdatablocknr, recsperdatablock);
-	/* add as many datablocks as require to store the record at the
-	 * desired position. */
-	itmp = datablocknr;
-	while(datablocknr > pxh->px_fileblocks) {
-//		fprintf(stderr, "We need an new datablock\n");
-		itmp = put_px_datablock(pxdoc, pxh, pxh->px_lastblock, pxdoc->px_stream);
-		if(itmp < 0) {
-			px_error(pxdoc, PX_RuntimeError, _("Could not write new data block."));
+	pindex_data = (pxpindex_t *) pindex->px_data;
+	numentries = pindex->px_datalen;
+	if((list = (pxscanblock_t *) pxdoc->malloc(pxdoc, (numentries+1)*sizeof(pxscanblock_t), _("Allocate memory for block list."))) == NULL) {
+		px_error(pxdoc, PX_MemoryError, _("Could not allocate memory for block list."));
+		pxdoc->free(pxdoc, entryofblock);
+		return -1;
+	}
+
+	numblocks = 0;
+	for(i=0; i<numentries; i++) {
+		if(pindex_data[i].level != 1)
+			continue;
+		/* All further blocks start behind the range. */
+		if(keyto && memcmp(pindex_data[i].data, keyto, keylen) > 0)
+			break;
+		for(j=i+1; j<numentries && pindex_data[j].level != 1; j++)
+			;
+		if(keyfrom && j<numentries && memcmp(pindex_data[j].data, keyfrom, keylen) < 0)
+			continue;
+
+		k = pindex_data[i].blocknumber;
+		if(k < 0 || k > maxblocknumber || (k = entryofblock[k]) < 0) {
+			px_error(pxdoc, PX_RuntimeError, _("Primary index refers to data block nr. %d, which is not in the block list."), pindex_data[i].blocknumber);
+			pxdoc->free(pxdoc, entryofblock);
+			pxdoc->free(pxdoc, list);
 			return -1;
 		}
-//		fprintf(stderr, "Added data block no. %d\n", itmp);
+		list[numblocks].blocknumber = map[k].blocknumber;
+		list[numblocks].recno = map[k].recno;
+		list[numblocks].recinblock = 0;
+		list[numblocks].numrecords = map[k].numrecords;
+		numblocks++;
 	}
-	/* The datablock number return by px_put_datablock() should be
-	 * the same as the calculated datablocknr after all datablocks
-	 * has been added.
-	 */
-	if(datablocknr != itmp) {
-		px_error(pxdoc, PX_RuntimeError, _("Inconsistency in writing data block. Expected data block nr. %d, but got %d."), datablocknr, itmp);
+	pxdoc->free(pxdoc, entryofblock);
+
+	*blocks = list;
+	return numblocks;
+}
+/* }}} */
+
+/* PX_scan_block_list() {{{
+ * Reads the data blocks of a list, as returned by PX_scan_plan() or
+ * PX_plan_key_range(), and passes the records of each entry to the
+ * callback function like PX_scan_range() does. The blocks following
+ * the current one are announced to the operating system in advance,
+ * see px_readahead().
+ * Returns 0 on success, otherwise -1 or the return value of the callback.
+ */
+PXLIB_API int PXLIB_CALL
+PX_scan_block_list(pxdoc_t *pxdoc, const pxscanblock_t *blocks, int numblocks, px_scan_callback_t callback, void *user_data) {
+	pxhead_t *pxh;
+	unsigned char *block, *buffer;
+	int b, ret, announced;
+
+	if(pxdoc == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
 		return -1;
 	}
 
-	/* write data */
-	itmp = px_add_data_to_block(pxdoc, pxh, datablocknr, recdatablocknr, data, pxdoc->px_stream, &update);
-
-	/* The record number within the data block must be the same
-	 * as the calculated one.
-	 */
-	if(itmp < 0) {
-		px_error(pxdoc, PX_RuntimeError, _("Inconsistency in writing record into data block. Expected record nr. %d, but got %d. %dth record. %dth data block. %d records per block."), recdatablocknr, itmp, pxh->px_numrecords+1, datablocknr, recsperdatablock);
+	if(pxdoc->px_head == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("File has no header."));
 		return -1;
 	}
-	
-	if(itmp != recdatablocknr) {
-		px_error(pxdoc, PX_Warning, _("Position of record has been recalculated. Requested position was %d, new position is %d."), recpos, (datablocknr-1) * recsperdatablock + itmp);
+	pxh = pxdoc->px_head;
+
+	if(callback == NULL || (blocks == NULL && numblocks > 0)) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a callback function or block list."));
+		return -1;
 	}
 
-	/* Update header:
-	 * Modify the last_postion only if a record was added at the end.
-	 * increment the record count only if a record was added not updated */
-	if(recpos >= pxh->px_numrecords) {
-		pxdoc->last_position = (datablocknr-1) * recsperdatablock + itmp;
+	buffer = NULL;
+	if(pxdoc->read != px_read) {
+		if((buffer = (unsigned char *) pxdoc->malloc(pxdoc, pxh->px_maxtablesize*0x400, _("Allocate memory for data block."))) == NULL) {
+			px_error(pxdoc, PX_MemoryError, _("Could not allocate memory for data block."));
+			return -1;
+		}
 	}
-	if(update == 0) {
-		pxh->px_numrecords++;
+
+	ret = 0;
+	announced = 0;
+	for(b=0; b<numblocks; b++) {
+		/* Announce the next blocks while half of the last ones are still ahead,
+		 * adjacent blocks as one range. */
+		if(pxdoc->readaheadblocks > 0 && b+1+pxdoc->readaheadblocks/2 >= announced) {
+			int first = max(announced, b+1);
+			int last = min(first+pxdoc->readaheadblocks, numblocks);
+			int len;
+			for(announced=first; announced<last; announced+=len) {
+				for(len=1; announced+len<last && blocks[announced+len].blocknumber == blocks[announced].blocknumber+len; len++)
+					;
+				px_readahead(pxdoc, blocks[announced].blocknumber, len);
+			}
+			announced = last;
+		}
+		if(NULL == (block = px_scan_get_block(pxdoc, blocks[b].blocknumber, buffer))) {
+			ret = -1;
+			break;
+		}
+		if(blocks[b].numrecords > 0) {
+			ret = px_scan_call(pxdoc, callback, blocks[b].recno, (char *) block+sizeof(TDataBlock)+blocks[b].recinblock*pxh->px_recordsize, blocks[b].numrecords, user_data);
+			if(ret != 0)
+				break;
+		}
 	}
 
-	put_px_head(pxdoc, pxh, pxdoc->px_stream);
-	return(pxdoc->last_position+1);
+	if(buffer)
+		pxdoc->free(pxdoc, buffer);
+	return ret;
 }
 /* }}} */
 
-/* PX_put_record() {{{
- * Stores a record into the paradox file. It uses the next free
- * slot in the database.
- * Returns the next postion (recpos+1) or -1 in case of an error.
+/* px_is_empty_record() {{{
+ * Checks whether all bytes of a record are zero, like those of the
+ * slots of a block that have never been written.
  */
-PXLIB_API int PXLIB_CALL
-PX_put_record(pxdoc_t *pxdoc, char *data) {
-	return(PX_put_recordn(pxdoc, data, pxdoc->last_position+1));
+static int px_is_empty_record(const unsigned char *record, int recordsize) {
+	int i;
+
+	for(i=0; i<recordsize; i++) {
+		if(record[i] != 0)
+			return 0;
+	}
+	return 1;
 }
 /* }}} */
 
-/* PX_retrieve_record() {{{
- * Get a record from the paradox file.
- * Returns an array of *pxval_t or NULL in case of an error.
+/* PX_scan_physical() {{{
+ * Reads all data blocks of the database in the order they are stored
+ * in the file, from block 1 to px_fileblocks, instead of following the
+ * block list. This reads the file sequentially and also finds the
+ * records the block list does not lead to, which makes it suitable for
+ * the recovery of damaged tables.
+ * Every slot of a block is passed to the callback together with its
+ * status. The records in the used part of a block on the block list
+ * are pxRecordLive, even if the header counts fewer records. The slots
+ * behind them are pxRecordDeleted, they hold deleted records or stale
+ * copies of records that have been moved. All slots of blocks that are
+ * not on the block list are pxRecordOrphaned. Slots with only zero bytes
+ * have never been written and are only passed if they are live.
+ * Consecutive slots of the same status are passed as one chunk with the
+ * number of the block and the position of the first slot within it.
+ * The block list is taken from the primary index, see PX_load_index().
+ * The record data is only valid during the callback and must not be
+ * modified. If the callback returns a value != 0, the scan will be
+ * stopped and the value is returned.
+ * Returns 0 on success, otherwise -1 or the return value of the callback.
  */
-PXLIB_API pxval_t ** PXLIB_CALL
-PX_retrieve_record(pxdoc_t *pxdoc, int recno) {
+PXLIB_API int PXLIB_CALL
+PX_scan_physical(pxdoc_t *pxdoc, px_scan_status_callback_t callback, void *user_data) {
 	pxhead_t *pxh;
-	char *data;
+	pxpindex_t *pindex;
+	unsigned char *block, *buffer, *onlist;
+	int blocksize, recsperblock, blocknumber, i, ret, announced;
 
 	if(pxdoc == NULL) {
 		px_error(pxdoc, PX_RuntimeError, _("Did not pass a paradox database."));
-		return NULL;
+		return -1;
 	}
 
 	if(pxdoc->px_head == NULL) {
 		px_error(pxdoc, PX_RuntimeError, _("File has no header."));
-		return NULL;
+		return -1;
 	}
 	pxh = pxdoc->px_head;
 
-	/* Allocate memory for record */
-	if((data = (char *) pxdoc->malloc(pxdoc, pxh->px_recordsize, _("Allocate memory for temporary record."))) == NULL) {
-		px_error(pxdoc, PX_RuntimeError, _("Could not allocate memory for temporary record."));
-		return NULL;
+	if(callback == NULL) {
+		px_error(pxdoc, PX_RuntimeError, _("Did not pass a callback function."));
+		return -1;
 	}
 
-	if(NULL != PX_get_record(pxdoc, recno, data)) {
-		int i, offset;
-		pxval_t **dataptr;
-		pxfield_t *pxf;
-
-		/* Allocate memory for return record */
-		if(NULL == (dataptr = (pxval_t **) pxdoc->malloc(pxdoc, pxh->px_numfields*sizeof(pxval_t *), _("Allocate memory for array of pointers to field values.")))) {
-			px_error(pxdoc, PX_RuntimeError, _("Could not allocate memory for array of pointers to field values."));
-			pxdoc->free(pxdoc, data);
-			return NULL;
+	if(PX_load_index(pxdoc) < 0) {
+		return -1;
+	}
+
+	if(pxh->px_recordsize <= 0 || pxh->px_fileblocks <= 0) {
+		return 0;
+	}
+	blocksize = pxh->px_maxtablesize*0x400;
+	recsperblock = (blocksize-(int)sizeof(TDataBlock))/pxh->px_recordsize;
+
+	/* Mark the blocks on the block list. */
+	if((onlist = (unsigned char *) pxdoc->malloc(pxdoc, pxh->px_fileblocks+1, _("Allocate memory for list of blocks."))) == NULL) {
+		px_error(pxdoc, PX_MemoryError, _("Could not allocate memory for list of blocks."));
+		return -1;
+	}
+	memset(onlist, 0, pxh->px_fileblocks+1);
+	pindex = pxdoc->px_indexdata;
+	for(i=0; pindex && i<pxdoc->px_indexdatalen; i++) {
+		if(pindex[i].level == 1 && pindex[i].blocknumber > 0 && pindex[i].blocknumber <= pxh->px_fileblocks)
+			onlist[pindex[i].blocknumber] = 1;
+	}
+
+	buffer = NULL;
+	if(pxdoc->read != px_read) {
+		if((buffer = (unsigned char *) pxdoc->malloc(pxdoc, blocksize, _("Allocate memory for data block."))) == NULL) {
+			px_error(pxdoc, PX_MemoryError, _("Could not allocate memory for data block."));
+			pxdoc->free(pxdoc, onlist);
+			return -1;
 		}
-		pxf = PX_get_fields(pxdoc);
-		offset = 0;
-		for(i=0; i<PX_get_num_fields(pxdoc); i++) {
-			MAKE_PXVAL(pxdoc, dataptr[i]);
-			dataptr[i]->type = pxf->px_ftype;
-			switch(pxf->px_ftype) {
-				case pxfAlpha: {
-					char *value;
-					int ret;
-					if(0 < (ret = PX_get_data_alpha(pxdoc, &data[offset], pxf->px_flen, &value))) {
-						dataptr[i]->value.str.val = value;
-						dataptr[i]->value.str.len = (int)strlen(value);
-					} else if(ret < 0) {
-						dataptr[i]->isnull = 1;
-						px_error(pxdoc, PX_RuntimeError, _("Could not read of field of type pxfAlpha."));
-					} else {
-						dataptr[i]->isnull = 1;
-					}
-					break;
-				}
-				case pxfShort: {
-					short int value;
-					if(0 < PX_get_data_short(pxdoc, &data[offset], pxf->px_flen, &value)) {
-						dataptr[i]->value.lval = (long) value;
-					} else {
-						dataptr[i]->isnull = 1;
-					}
-					break;
-					}
-				case pxfDate:
-				case pxfTime:
-				case pxfAutoInc:
-				case pxfLong: {
-					long value;
-					if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-						dataptr[i]->value.lval = value;
-					} else {
-						dataptr[i]->isnull = 1;
-					}
-					break;
-					}
-				case pxfTimestamp:
-				case pxfCurrency:
-				case pxfNumber: {
-					double value;
-					if(0 < PX_get_data_double(pxdoc, &data[offset], pxf->px_flen, &value)) {
-						dataptr[i]->value.dval = value;
-					} 
-					break;
-					} 
-				case pxfLogical: {
-					char value;
-					if(0 < PX_get_data_byte(pxdoc, &data[offset], pxf->px_flen, &value)) {
-						dataptr[i]->value.lval = (long) value;
-					} else {
-						dataptr[i]->isnull = 1;
-					}
-					break;
-					}
-				case pxfGraphic:
-				case pxfBLOb:
-				case pxfFmtMemoBLOb:
-				case pxfMemoBLOb:
-				case pxfOLE: {
-					char *blobdata;
-					int mod_nr, size, ret;
-					if(pxf->px_ftype == pxfGraphic)
-						ret = PX_get_data_graphic(pxdoc, &data[offset], pxf->px_flen, &mod_nr, &size, &blobdata);
-					else
-						ret = PX_get_data_blob(pxdoc, &data[offset], pxf->px_flen, &mod_nr, &size, &blobdata);
-					if(ret > 0) {
-						if(blobdata) {
-							dataptr[i]->value.str.val = blobdata;
-							dataptr[i]->value.str.len = size;
-						} else {
-							dataptr[i]->isnull = 1;
-							px_error(pxdoc, PX_RuntimeError, _("Could not read blob data."));
-						}
-					} else if(ret == 0) {
-						dataptr[i]->isnull = 1;
-					} else {
-						px_error(pxdoc, PX_RuntimeError, _("Could not read blob data."));
-					}
+	}
 
-					break;
-				}
-				case pxfBytes: {
-					char *value;
-					if(0 < PX_get_data_bytes(pxdoc, &data[offset], pxf->px_flen, &value)) {
-						dataptr[i]->value.str.val = value;
-						dataptr[i]->value.str.len = pxf->px_flen;
-					} else {
-						dataptr[i]->isnull = 1;
-					}
-					break;
-					}
-				case pxfBCD: {
-					char *value;
-					if(0 < PX_get_data_bcd(pxdoc, (unsigned char*) &data[offset], pxf->px_fdc, &value)) {
-						dataptr[i]->value.str.val = value;
-						dataptr[i]->value.str.len = (int)strlen(value);
-					} else {
-						dataptr[i]->isnull = 1;
-					}
-					break;
-				}
-				default:
-					dataptr[i]->isnull = 1;
-					break;
-			}
-			offset += pxf->px_flen;
-			pxf++;
+	ret = 0;
+	announced = 1;
+	for(blocknumber=1; blocknumber<=pxh->px_fileblocks && ret == 0; blocknumber++) {
+		TDataBlock *datablockhead;
+		unsigned char *records;
+		int datasize, numused, start, end, status;
+
+		/* Announce the next blocks while half of the last ones are still ahead. */
+		if(pxdoc->readaheadblocks > 0 && blocknumber+pxdoc->readaheadblocks/2 >= announced) {
+			int len = min(pxdoc->readaheadblocks, pxh->px_fileblocks-announced+1);
+			if(len > 0)
+				px_readahead(pxdoc, announced, len);
+			announced += pxdoc->readaheadblocks;
 		}
-/*
-		if(filetype == pxfFileTypPrimIndex) {
-			short int value;
-			if(0 < PX_get_data_short(pxdoc, &data[offset], 2, &value)) {
-				fprintf(outfp, "%d", value);
-			}
-			offset += 2;
-			if(0 < PX_get_data_short(pxdoc, &data[offset], 2, &value)) {
-				fprintf(outfp, "%d", value);
-				ireccounter += value;
+		if(NULL == (block = px_scan_get_block(pxdoc, blocknumber, buffer))) {
+			ret = -1;
+			break;
+		}
+		datablockhead = (TDataBlock *) block;
+		records = block+sizeof(TDataBlock);
+
+		/* A size beyond the last slot means that all records of the
+		 * block are deleted, see px_get_record_pos(). */
+		datasize = get_short_le((char *) &datablockhead->addDataSize);
+		if(!onlist[blocknumber] || datasize < 0 || datasize > blocksize-(int)sizeof(TDataBlock)-pxh->px_recordsize)
+			numused = 0;
+		else
+			numused = min(datasize/pxh->px_recordsize+1, recsperblock);
+
+		for(start=0; start<recsperblock && ret == 0; start=end) {
+			status = !onlist[blocknumber] ? pxRecordOrphaned : (start < numused ? pxRecordLive : pxRecordDeleted);
+			end = start+1;
+			if(status != pxRecordLive && px_is_empty_record(records+start*pxh->px_recordsize, pxh->px_recordsize))
+				continue;
+			if(status == pxRecordLive) {
+				end = numused;
+			} else {
+				while(end < recsperblock && !px_is_empty_record(records+end*pxh->px_recordsize, pxh->px_recordsize))
+					end++;
 			}
-			offset += 2;
-			if(0 < PX_get_data_short(pxdoc, &data[offset], 2, &value)) {
-				fprintf(outfp, "%d", value);
+			if(pxdoc->px_stats) {
+				double time = px_time_ns();
+				ret = callback(pxdoc, blocknumber, start, status, (char *) records+start*pxh->px_recordsize, end-start, user_data);
+				pxdoc->px_stats->nsdecode += px_time_ns() - time;
+				pxdoc->px_stats->recordsdecoded += end-start;
+			} else {
+				ret = callback(pxdoc, blocknumber, start, status, (char *) records+start*pxh->px_recordsize, end-start, user_data);
 			}
-			fprintf(outfp, "%d", pxdbinfo.number);
 		}
-		if(markdeleted) {
-			fprintf(outfp, "%d", isdeleted);
-		}
-*/
-		pxdoc->free(pxdoc, data);
-		return(dataptr);
-	} else {
-		px_error(pxdoc, PX_RuntimeError, _("Could not read data for record with number %d."), recno);
-		pxdoc->free(pxdoc, data);
-		return NULL;
 	}
+
+	if(buffer)
+		pxdoc->free(pxdoc, buffer);
+	pxdoc->free(pxdoc, onlist);
+	return ret;
 }
 /* }}} */
 
@@ -2116,6 +3413,10 @@ PX_insert_record(pxdoc_t *pxdoc, pxval_t **dataptr) {
 	}
 	pxh = pxdoc->px_head;
 
+	if(PX_load_index(pxdoc) < 0) {
+		return -1;
+	}
+
 	/* Check for a free record in the exiting file */
 	if(pxdoc->px_indexdata)
 		found = px_find_slot_with_index(pxdoc, &tmppxdbinfo);
@@ -2166,6 +3467,7 @@ PX_insert_record(pxdoc_t *pxdoc, pxval_t **dataptr) {
 		recno = tmppxdbinfo.recno;
 		newrecpos = found-1;
 	}
+	px_free_record_map(pxdoc);
 	/* The datablock number return by px_put_datablock() should be
 	 * the same as the calculated datablocknr after all datablocks
 	 * has been added.
@@ -2325,6 +3627,10 @@ PX_update_record(pxdoc_t *pxdoc, pxval_t **dataptr, int recno) {
 	}
 	pxh = pxdoc->px_head;
 
+	if(PX_load_index(pxdoc) < 0) {
+		return -1;
+	}
+
 	if((recno < 0) || (recno >= pxh->px_numrecords)) {
 		px_error(pxdoc, PX_RuntimeError, _("Record number out of range."));
 		return -1;
@@ -2387,6 +3693,10 @@ PX_delete_record(pxdoc_t *pxdoc, int recno) {
 		return -1;
 	}
 	pxh = pxdoc->px_head;
+
+	if(PX_load_index(pxdoc) < 0) {
+		return -1;
+	}
 	pxs = pxdoc->px_stream;
 	pxblob = pxdoc->px_blob;
 
@@ -2423,6 +3733,7 @@ PX_delete_record(pxdoc_t *pxdoc, int recno) {
 			if(pxdoc->px_indexdata) {
 				pxpindex_t *pindex = pxdoc->px_indexdata;
 				pindex[datablocknr-1].numrecords = ret;
+				px_free_record_map(pxdoc);
 			}
 
 		} else {
@@ -2463,6 +3774,10 @@ PX_pack(pxdoc_t *pxdoc) {
 	}
 	pxh = pxdoc->px_head;
 	pxs = pxdoc->px_stream;
+
+	if(PX_load_index(pxdoc) < 0) {
+		return -1;
+	}
 	pindex_data = pxdoc->px_indexdata;
 	recsperblock = (pxh->px_maxtablesize*0x400-sizeof(TDataBlock)) / pxh->px_recordsize;
 
@@ -2520,9 +3835,8 @@ PX_close(pxdoc_t *pxdoc) {
 		pxdoc->px_blob = NULL;
 	}
 
-	if(pxdoc->px_stream && pxdoc->px_stream->close && (pxdoc->px_stream->s.fp != NULL)){
-		fclose(pxdoc->px_stream->s.fp);
-	}
+	/* Close the file or release the memory mapping */
+	px_stream_close(pxdoc, pxdoc->px_stream);
 
 	/* Free memory for io stream */
 	if(pxdoc->px_stream) {
@@ -2554,8 +3868,9 @@ PX_delete(pxdoc_t *pxdoc) {
 	 */
 	PX_close(pxdoc);
 
-	if(pxdoc->out_iconvcd != (Riconv_t)(-1))
-	  Riconv_close(pxdoc->out_iconvcd);
+	px_delete_key_index(pxdoc);
+
+	px_free_targetencoding(pxdoc);
 	if(pxdoc->in_iconvcd != (Riconv_t)(-1))
 	  Riconv_close(pxdoc->in_iconvcd);
 
@@ -2563,6 +3878,8 @@ PX_delete(pxdoc_t *pxdoc) {
 		pxdoc->free(pxdoc, pxdoc->targetencoding);
 	if(pxdoc->inputencoding)
 		pxdoc->free(pxdoc, pxdoc->inputencoding);
+	if(pxdoc->sourceencoding)
+		pxdoc->free(pxdoc, pxdoc->sourceencoding);
 	if(pxdoc->px_name)
 		pxdoc->free(pxdoc, pxdoc->px_name);
 
@@ -2595,11 +3912,26 @@ PX_delete(pxdoc_t *pxdoc) {
 		pxdoc->free(pxdoc, pxdoc->px_indexdata);
 		pxdoc->px_indexdatalen = 0;
 	}
+	px_free_record_map(pxdoc);
 
 	/* Free the memory for the block cache */
 	if(pxdoc->curblock) {
 		pxdoc->free(pxdoc, pxdoc->curblock);
 	}
+	if(pxdoc->px_cryptkey) {
+		pxdoc->free(pxdoc, pxdoc->px_cryptkey);
+	}
+	if(pxdoc->px_recbuf) {
+		pxdoc->free(pxdoc, pxdoc->px_recbuf);
+	}
+	if(pxdoc->px_stats) {
+		pxdoc->free(pxdoc, pxdoc->px_stats);
+	}
+	if(pxdoc->px_arena) {
+		pxarena_t *arena = pxdoc->px_arena;
+		pxdoc->px_arena = NULL;
+		px_arena_delete(pxdoc, arena);
+	}
 
 	pxdoc->free(pxdoc, pxdoc);
 }
@@ -2913,6 +4245,10 @@ PX_new_blob(pxdoc_t *pxdoc) {
 
 	memset(pxblob, 0, sizeof(pxblob_t));
 	pxblob->pxdoc = pxdoc;
+	if(0 > px_mb_cache_resize(pxblob, PX_MB_CACHESIZE)) {
+		pxdoc->free(pxdoc, pxblob);
+		return(NULL);
+	}
 	pxdoc->px_blob = pxblob;
 	return(pxblob);
 }
@@ -2950,6 +4286,9 @@ PX_open_blob_fp(pxblob_t *pxblob, FILE *fp) {
 
 	build_mb_block_list(pxblob);
 	pxblob->used_datablocks = pxblob->blocklistlen-1;
+	/* Only count the reads of blob data */
+	pxblob->blockcachehits = 0;
+	pxblob->blockcachemisses = 0;
 
 	return(0);
 }
@@ -3086,8 +4425,7 @@ PX_close_blob(pxblob_t *pxblob) {
 PXLIB_API void PXLIB_CALL
 PX_delete_blob(pxblob_t *pxblob) {
 	PX_close_blob(pxblob);
-	if(pxblob->blockcache.data)
-		pxblob->pxdoc->free(pxblob->pxdoc, pxblob->blockcache.data);
+	px_mb_cache_free(pxblob);
 	if(pxblob->blocklist)
 		pxblob->pxdoc->free(pxblob->pxdoc, pxblob->blocklist);
 	pxblob->pxdoc->free(pxblob->pxdoc, pxblob);
@@ -3382,7 +4720,7 @@ PX_get_data_alpha(pxdoc_t *pxdoc, char *data, int len, char **value) {
   
   // Allocate memory for the raw string using pxlib's memory manager
   // The memory will be freed later by the caller (in interface.c)
-  buffer = (char *) pxdoc->malloc(pxdoc, actual_len + 1, _("Allocate memory for raw alpha field data."));
+  buffer = (char *) px_arena_malloc(pxdoc, actual_len + 1, _("Allocate memory for raw alpha field data."));
   if(!buffer) {
     *value = NULL;
     return -1; // Return -1 on memory allocation failure
@@ -3409,7 +4747,7 @@ PX_get_data_bytes(pxdoc_t *pxdoc, char *data, int len, char **value) {
 		return 0;
 	}
 
-	buffer = (char *) pxdoc->malloc(pxdoc, len, _("Allocate memory for field data."));
+	buffer = (char *) px_arena_malloc(pxdoc, len, _("Allocate memory for field data."));
 	if(!buffer) {
 		*value = NULL;
 		return -1;
@@ -3525,7 +4863,13 @@ PX_get_data_bcd(pxdoc_t *pxdoc, unsigned char *data, int len, char **value) {
 		*value = NULL;
 		return 0;
 	}
-	buffer = (char *) pxdoc->malloc(pxdoc, 34+3, _("Allocate memory for field data."));
+	/* Check the size before allocating, the buffer would be lost otherwise */
+	size = data[0] & 0x3f;
+	if(size != len) {
+		*value = NULL;
+		return -1;
+	}
+	buffer = (char *) px_arena_malloc(pxdoc, 34+3, _("Allocate memory for field data."));
 	if(!buffer) {
 		*value = NULL;
 		return -1;
@@ -3538,11 +4882,6 @@ PX_get_data_bcd(pxdoc_t *pxdoc, unsigned char *data, int len, char **value) {
 		buffer[j++] = '-';
 		sign = 0x0F;
 	}
-	size = data[0] & 0x3f;
-	if(size != len) {
-		*value = NULL;
-		return -1;
-	}
 	lz = 1;
 	for(i=2; i<34-size; i++) {
 		if(i%2)
@@ -3618,7 +4957,7 @@ _px_get_data_blob(pxdoc_t *pxdoc, const char *data, int len, int hsize, int *mod
 
 	/* First check if the blob data is included in the record itself */
 	if(*blobsize <= leader) {
-		blobdata = pxdoc->malloc(pxdoc, *blobsize, _("Allocate memory for blob data."));
+		blobdata = px_arena_malloc(pxdoc, *blobsize, _("Allocate memory for blob data."));
 		if(!blobdata) {
 			px_error(pxdoc, PX_RuntimeError, _("Could not allocate memory for blob data."));
 			*value = NULL;
@@ -3689,7 +5028,7 @@ _px_get_data_blob(pxdoc_t *pxdoc, const char *data, int len, int hsize, int *mod
 		 * was passed to PX_read_blobdata()
 		 */
 
-		blobdata = pxdoc->malloc(pxdoc, *blobsize, _("Allocate memory for blob data."));
+		blobdata = px_arena_malloc(pxdoc, *blobsize, _("Allocate memory for blob data."));
 		if(!blobdata) {
 			px_error(pxdoc, PX_RuntimeError, _("Could not allocate memory for blob data."));
 			*value = NULL;
@@ -3699,7 +5038,7 @@ _px_get_data_blob(pxdoc_t *pxdoc, const char *data, int len, int hsize, int *mod
 		if((ret = (int)pxblob->read(pxblob, pxblob->mb_stream, *blobsize, blobdata)) < 0) {
 			px_error(pxdoc, PX_RuntimeError, _("Could not read all blob data."));
 			*value = NULL;
-			pxdoc->free(pxdoc, blobdata);
+			px_arena_free(pxdoc, blobdata);
 			return -1;
 		}
 	} else if(head[0] == 3) { /* Reading data from a block type 3 */
@@ -3726,7 +5065,7 @@ _px_get_data_blob(pxdoc_t *pxdoc, const char *data, int len, int hsize, int *mod
 			*value = NULL;
 			return -1;
 		}
-		blobdata = pxdoc->malloc(pxdoc, size, _("Allocate memory for blob data."));
+		blobdata = px_arena_malloc(pxdoc, size, _("Allocate memory for blob data."));
 		if(!blobdata) {
 			px_error(pxdoc, PX_RuntimeError, _("Could not allocate memory for blob data."));
 			*value = NULL;
@@ -3736,13 +5075,13 @@ _px_get_data_blob(pxdoc_t *pxdoc, const char *data, int len, int hsize, int *mod
 		if((ret = pxblob->seek(pxblob, pxblob->mb_stream, (long)offset+head[0]*16, SEEK_SET)) < 0) {
 			px_error(pxdoc, PX_RuntimeError, _("Could not fseek start of blob."));
 			*value = NULL;
-			pxdoc->free(pxdoc, blobdata);
+			px_arena_free(pxdoc, blobdata);
 			return -1;
 		}
 		if((ret = (int)pxblob->read(pxblob, pxblob->mb_stream, size, blobdata)) < 0) {
 			px_error(pxdoc, PX_RuntimeError, _("Could not read all blob data."));
 			*value = NULL;
-			pxdoc->free(pxdoc, blobdata);
+			px_arena_free(pxdoc, blobdata);
 			return -1;
 		}
 	}
@@ -3916,7 +5255,7 @@ PX_put_data_bcd(pxdoc_t *pxdoc, char *data, int len, char *value) {
 	unsigned char obuf[17];
 	unsigned char sign;
 	char *dpptr;
-	size_t i, j;
+	int i, j;
 
 	memset(obuf, 0, 17);
 	if(NULL != value) {
@@ -3953,9 +5292,9 @@ PX_put_data_bcd(pxdoc_t *pxdoc, char *data, int len, char *value) {
 				j++;
 			}
 		} else {
-			dpptr = value + len;
+			dpptr = value + strlen(value);
 		}
-		j = dpptr-value-1;
+		j = (int) (dpptr-value)-1;
 		i = 34-len-1;
 		while(i>1 && j>=0) {
 			char nibble;
@@ -4035,6 +5374,16 @@ _px_put_data_blob(pxdoc_t *pxdoc, const char *data, int len, char *value, int va
         px_error(pxdoc, PX_RuntimeError, _("Could not write blob data to file."));
         return -1;
       }
+      /* Fill up the last block, the blob file must consist of whole blocks */
+      {
+        char zeros[4096];
+        size_t fill = (size_t) used_blocks*4096 - sizeof(TMbBlockHeader2) - valuelen;
+        memset(zeros, 0, sizeof(zeros));
+        if(fill > 0 && pxblob->write(pxblob, pxs, fill, zeros) < 1) {
+          px_error(pxdoc, PX_RuntimeError, _("Could not write remaining of a type 2 block."));
+          return -1;
+        }
+      }
       put_long_le((char *) &data[leader], (pxblob->used_datablocks+1)*4096 + 0xff);
       put_short_le((char *) &data[leader+8], pxblob->mb_head->modcount);
       pxblob->used_datablocks += used_blocks;
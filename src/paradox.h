@@ -48,6 +48,7 @@ typedef SSIZE_T ssize_t;
 #define pxfIOFile 1
 /* pxfIOGsf is defined as 2 in paradox-gsf.h */
 #define pxfIOStream 3
+#define pxfIOMmap 4
 
 /* Field types */
 #define pxfAlpha        0x01
@@ -142,14 +143,24 @@ typedef struct px_pindex pxpindex_t;
 typedef struct px_stream pxstream_t;
 typedef struct px_val pxval_t;
 typedef struct mb_head mbhead_t;
+typedef struct px_scanpos pxscanpos_t;
+typedef struct px_scanblock pxscanblock_t;
+typedef struct px_recmap pxrecmap_t;
+typedef struct px_arena pxarena_t;
+typedef struct px_stats pxstats_t;
 
 struct px_stream {
-	int type;        /* set to pxfIOFile | pxfIOGsf | pxfIOStream*/
+	int type;        /* set to pxfIOFile | pxfIOGsf | pxfIOStream | pxfIOMmap */
 	int mode;        /* set to pxfFileRead | pxfFileWrite */
 	int close;       /* set to true if stream must be closed */
 	union {
 		FILE *fp;
 		void *stream;
+		struct {
+			unsigned char *data; /* start of the mapped file */
+			long size;           /* size of the mapped file */
+			long pos;            /* current read position */
+		} mm;
 #if HAVE_GSF
 		GsfInput *gsfin;
 		GsfOutput *gsfout;
@@ -161,6 +172,34 @@ struct px_stream {
 	ssize_t (*write)(pxdoc_t *p, pxstream_t *stream, size_t numbytes, void *buffer);
 };
 
+/* Position of a block sequential scan, see PX_scan_range() */
+struct px_scanpos {
+	int blockcount;    /* index of the current block in the block list (0-n) */
+	int blocknumber;   /* number of the current block (first block is 1) */
+	int recinblock;    /* number of records of the current block already read */
+	int recno;         /* number of records already read in total */
+};
+
+/* Part of a data block visited by a scan, see PX_scan_plan() and
+ * PX_plan_key_range() */
+struct px_scanblock {
+	int blocknumber;   /* number of the block (first block is 1) */
+	int recno;         /* number of the first record read from the block */
+	int recinblock;    /* position of that record within the block */
+	int numrecords;    /* number of records read from the block */
+};
+
+/* Location of the records of a data block, see px_get_record_pos_with_index() */
+struct px_recmap {
+	int recno;         /* number of the first record in the block (0-n) */
+	int numrecords;    /* number of records in the block */
+	int entry;         /* index of the block in px_indexdata */
+	int blocknumber;   /* number of the block (first block is 1) */
+	int prev;          /* number of the previous block as stored in the block */
+	int next;          /* number of the next block as stored in the block */
+	long blockpos;     /* file offset of the block */
+};
+
 struct px_doc {
 	/* database file */
 //	FILE *px_fp;       /* File pointer of file */
@@ -175,9 +214,20 @@ struct px_doc {
 	int px_datalen;    /* length of data field in number of units */
 	void *px_indexdata;/* Pointer to index data */
 	int px_indexdatalen; /* number of index data records */
+	pxrecmap_t *px_recmap; /* blocks of the self build index with their first
+						* record, NULL if the index has been modified */
+	int px_recmaplen;  /* number of entries in px_recmap */
+	int px_recmaplast; /* entry found by the last lookup in px_recmap */
+	int deferindex;    /* set to px_true to build the self build index on
+						* first access instead of when opening a file */
+	int px_indexdeferred; /* set if the self build index has not been built
+						* yet, see PX_load_index() */
 
 	/* primary index file */
 	pxdoc_t *px_pindex;
+	/* primary index file used for key lookups only, the self build index
+	 * in px_indexdata stays in place, see PX_set_key_index_file() */
+	pxdoc_t *px_keyindex;
 
 	/* blob file */
 	pxblob_t *px_blob;
@@ -210,18 +260,50 @@ struct px_doc {
 
 	char *targetencoding;
 	char *inputencoding;
+	char *sourceencoding;   /* Replaces the codepage of the header when reading */
 	Riconv_t out_iconvcd;   /* Encoding of written data */
 	Riconv_t in_iconvcd;    /* Encoding of read data */
+	struct px_codetable *out_codetable; /* Table for out_iconvcd of single-byte codepages */
+
+	struct px_crypt_key *px_cryptkey; /* Decryption tables of px_encryption */
+
+	pxscanpos_t px_cursor; /* Read position of chunked reads */
+	int readaheadblocks;   /* Number of data blocks a scan announces ahead, 0 to disable */
 
 	long curblocknr;      /* Number of current block in cache (0-n) */
 	int curblockdirty;    /* Set to px_true if the block needs to be written */
 	unsigned char *curblock;       /* Data of block in read cache */
+
+	pxarena_t *px_arena;  /* Memory of field values, see PX_arena_begin() */
+	char *px_recbuf;      /* Record buffer reused by PX_retrieve_record() */
+	pxstats_t *px_stats;  /* Counters of the read path, NULL unless enabled
+						   * with PX_set_value("stats") */
+};
+
+/* Counters of the read path, see PX_get_stats(). The times are in
+ * nanoseconds. Blob reads made while decoding records are part of
+ * nsdecode as well as of nsblob. */
+struct px_stats {
+	long long blocksread;       /* data blocks read from the file or mapping */
+	long long blockcachehits;   /* data blocks found in the block cache */
+	long long blockcachemisses; /* data blocks not found in the block cache */
+	long long bytesread;        /* bytes of the data blocks read */
+	long long bytesdecrypted;   /* bytes of data and blob blocks decrypted */
+	long long mbseeks;          /* seeks in the blob file */
+	long long mbreads;          /* reads from the blob file */
+	long long mbbytesread;      /* bytes read from the blob file */
+	long long recordsdecoded;   /* records passed to scan callbacks */
+	double nsio;                /* reading data blocks */
+	double nsdecrypt;           /* decrypting data blocks */
+	double nsblob;              /* reading and decrypting blob data */
+	double nsdecode;            /* scan callbacks decoding the records */
 };
 
 struct px_blockcache {
-	long start;
+	long start;            /* Offset of the block in the file, -1 if unused */
 	size_t size;
 	unsigned char *data;
+	unsigned long lastused; /* Value of the clock of the cache when last used */
 };
 typedef struct px_blockcache pxblockcache_t;
 
@@ -249,8 +331,12 @@ struct px_blob {
 	int (*seek)(pxblob_t *p, pxstream_t *stream, long offset, int whence);
 	long (*tell)(pxblob_t *p, pxstream_t *stream);
 	ssize_t (*write)(pxblob_t *p, pxstream_t *stream, size_t numbytes, void *buffer);
-	/* Cache for the last read block */
-	pxblockcache_t blockcache;
+	/* LRU cache of the last read (and decrypted) 4kB blocks */
+	pxblockcache_t *blockcache;
+	int blockcachelen;     /* Number of blocks in the cache, 0 to disable it */
+	unsigned long blockcacheclock;
+	unsigned long blockcachehits;
+	unsigned long blockcachemisses;
 	/* Index of all blocks in the blob file */
 	pxmbblockinfo_t *blocklist;
 	int blocklistlen;
@@ -281,6 +367,24 @@ struct px_pindex {
 						* data block in the database file. */
 };
 
+/* Callback of PX_scan_blocks(). It is called once for each data block
+ * with the number of the first record in the block and the raw data of
+ * numrecords consecutive records. Returning a value != 0 stops the scan.
+ */
+typedef int (*px_scan_callback_t)(pxdoc_t *pxdoc, int recno, char *records, int numrecords, void *user_data);
+
+/* Status of the records passed by PX_scan_physical() */
+#define pxRecordLive     0 /* used part of a block on the block list */
+#define pxRecordDeleted  1 /* unused part of a block on the block list */
+#define pxRecordOrphaned 2 /* block that is not on the block list */
+
+/* Callback of PX_scan_physical(). It is called with the raw data of
+ * numrecords consecutive slots of a data block starting at slot
+ * recinblock, all with the same status. Returning a value != 0 stops
+ * the scan.
+ */
+typedef int (*px_scan_status_callback_t)(pxdoc_t *pxdoc, int blocknumber, int recinblock, int status, char *records, int numrecords, void *user_data);
+
 #define MAKE_PXVAL(pxdoc, pxval) \
 	(pxval) = (pxval_t *) (pxdoc)->malloc((pxdoc), sizeof(pxval_t), "Allocate memory for pxval_t"); \
 	memset((void *) (pxval), 0, sizeof(pxval_t));
@@ -337,6 +441,9 @@ PX_open_fp(pxdoc_t *pxdoc, FILE *fp);
 PXLIB_API int PXLIB_CALL
 PX_open_file(pxdoc_t *pxdoc, const char *filename);
 
+PXLIB_API int PXLIB_CALL
+PX_open_file_mmap(pxdoc_t *pxdoc, const char *filename);
+
 PXLIB_API int PXLIB_CALL
 PX_create_file(pxdoc_t *pxdoc, pxfield_t *pxf, int numfields, const char *filename, int type);
 
@@ -355,6 +462,9 @@ PX_read_primary_index(pxdoc_t *pindex);
 PXLIB_API int PXLIB_CALL
 PX_add_primary_index(pxdoc_t *pxdoc, pxdoc_t *pindex);
 
+PXLIB_API int PXLIB_CALL
+PX_set_key_index_file(pxdoc_t *pxdoc, const char *filename);
+
 PXLIB_API char * PXLIB_CALL
 PX_get_record(pxdoc_t *pxdoc, int recno, char *data);
 
@@ -379,6 +489,48 @@ PX_delete_record(pxdoc_t *pxdoc, int recno);
 PXLIB_API pxval_t ** PXLIB_CALL
 PX_retrieve_record(pxdoc_t *pxdoc, int recno);
 
+PXLIB_API void PXLIB_CALL
+PX_convert_field(pxdoc_t *pxdoc, pxfield_t *pxf, char *data, pxval_t *val);
+
+PXLIB_API pxval_t ** PXLIB_CALL
+PX_convert_record(pxdoc_t *pxdoc, char *data);
+
+PXLIB_API int PXLIB_CALL
+PX_arena_begin(pxdoc_t *pxdoc);
+
+PXLIB_API void PXLIB_CALL
+PX_arena_end(pxdoc_t *pxdoc);
+
+PXLIB_API void PXLIB_CALL
+PX_arena_free(pxdoc_t *pxdoc, void *ptr);
+
+PXLIB_API int PXLIB_CALL
+PX_load_index(pxdoc_t *pxdoc);
+
+PXLIB_API void PXLIB_CALL
+PX_scan_init(pxdoc_t *pxdoc, pxscanpos_t *pos);
+
+PXLIB_API int PXLIB_CALL
+PX_scan_range(pxdoc_t *pxdoc, pxscanpos_t *pos, int maxrecords, px_scan_callback_t callback, void *user_data);
+
+PXLIB_API int PXLIB_CALL
+PX_scan_chain(pxdoc_t *pxdoc, pxscanpos_t *pos, int maxrecords, px_scan_callback_t callback, void *user_data);
+
+PXLIB_API int PXLIB_CALL
+PX_scan_blocks(pxdoc_t *pxdoc, px_scan_callback_t callback, void *user_data);
+
+PXLIB_API int PXLIB_CALL
+PX_scan_plan(pxdoc_t *pxdoc, pxscanpos_t *pos, int maxrecords, pxscanblock_t **blocks);
+
+PXLIB_API int PXLIB_CALL
+PX_plan_key_range(pxdoc_t *pxdoc, const char *keyfrom, const char *keyto, int keylen, pxscanblock_t **blocks);
+
+PXLIB_API int PXLIB_CALL
+PX_scan_block_list(pxdoc_t *pxdoc, const pxscanblock_t *blocks, int numblocks, px_scan_callback_t callback, void *user_data);
+
+PXLIB_API int PXLIB_CALL
+PX_scan_physical(pxdoc_t *pxdoc, px_scan_status_callback_t callback, void *user_data);
+
 PXLIB_API void PXLIB_CALL
 PX_close(pxdoc_t *pxdoc);
 
@@ -415,6 +567,9 @@ PX_set_value(pxdoc_t *pxdoc, const char *name, float value);
 PXLIB_API int PXLIB_CALL
 PX_get_value(pxdoc_t *pxdoc, const char *name, float *value);
 
+PXLIB_API pxstats_t* PXLIB_CALL
+PX_get_stats(pxdoc_t *pxdoc);
+
 PXLIB_API int PXLIB_CALL
 PX_set_targetencoding(pxdoc_t *pxdoc, const char *encoding);
 
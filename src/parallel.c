@@ -0,0 +1,259 @@
+/**
+ * @file parallel.c
+ * @brief Multi-threaded scan of the data blocks of a Paradox file.
+ *
+ * Data blocks are independent units of `px_maxtablesize * 0x400` bytes. Once
+ * `PX_scan_plan()` has listed the blocks and the number of their first record
+ * from the primary index, every block can be read, decrypted and decoded on
+ * its own. The blocks of a file are split into one contiguous range per
+ * thread. The threads, the calling thread among them, take the ranges of
+ * all files being read from a common queue, largest first.
+ *
+ * Neither the R API nor `px_error()` (which ends up in the R API) is used
+ * by the worker threads. Errors are only flagged and reported by the caller.
+ * If the statistics of a document are enabled, each range counts its reads
+ * on its own and the counters are added to those of the document at the end,
+ * so the times are summed over the threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "paradox.h"
+#include "px_intern.h"
+#include "px_io.h"
+#include "parallel.h"
+
+// Work of a single thread.
+typedef struct {
+  pxdoc_t* pxdoc;
+  const pxscanblock_t* blocks; // The blocks of this thread.
+  int num_blocks;
+  px_scan_callback_t callback;
+  void* user_data;
+  int job;                     // The index of the job the blocks belong to.
+  int status;                  // 0, -1 for a read error, or the callback's return value.
+  pxstats_t stats;             // The reads of this range, if the document counts them.
+} px_worker_t;
+
+/**
+ * @brief Announces up to `readaheadblocks` blocks from `blocks[first]` on,
+ *   adjacent blocks as one range, see `px_readahead()`.
+ * @return The index behind the last block announced.
+ */
+static int readahead_blocks(pxdoc_t* pxdoc, const pxscanblock_t* blocks, int num_blocks, int first) {
+  int last = first + pxdoc->readaheadblocks;
+  if (last > num_blocks) last = num_blocks;
+  int b = first;
+  while (b < last) {
+    int len = 1;
+    while (b + len < last && blocks[b + len].blocknumber == blocks[b].blocknumber + len) len++;
+    px_readahead(pxdoc, blocks[b].blocknumber, len);
+    b += len;
+  }
+  return last;
+}
+
+static void* scan_worker(void* arg) {
+  px_worker_t* w = (px_worker_t*) arg;
+  pxhead_t* pxh = w->pxdoc->px_head;
+  pxstream_t* pxs = w->pxdoc->px_stream;
+  size_t offset = sizeof(TDataBlock);
+  FILE* fp = NULL;
+  unsigned char* buffer;
+  pxstats_t* stats = w->pxdoc->px_stats != NULL ? &w->stats : NULL;
+
+  w->status = 0;
+  if (w->num_blocks <= 0) return NULL;
+
+  buffer = (unsigned char*) malloc((size_t) pxh->px_maxtablesize * 0x400);
+  if (buffer == NULL) {
+    w->status = -1;
+    return NULL;
+  }
+  // A memory mapped file can be read by all threads at once, others need their own handle.
+  if (pxs->type != pxfIOMmap && (fp = fopen(w->pxdoc->px_name, "rb")) == NULL) {
+    free(buffer);
+    w->status = -1;
+    return NULL;
+  }
+
+  int announced = 0;
+  for (int b = 0; b < w->num_blocks; b++) {
+    const pxscanblock_t* block = &w->blocks[b];
+    // Announce the next blocks of this thread while half of the last ones are still ahead.
+    if (w->pxdoc->readaheadblocks > 0 && b + 1 + w->pxdoc->readaheadblocks / 2 >= announced) {
+      announced = readahead_blocks(w->pxdoc, w->blocks, w->num_blocks, announced > b + 1 ? announced : b + 1);
+    }
+    unsigned char* data = px_read_block_r(w->pxdoc, fp, block->blocknumber, buffer, stats);
+    if (data == NULL) {
+      w->status = -1;
+      break;
+    }
+    char* records = (char*) data + offset + (size_t) block->recinblock * pxh->px_recordsize;
+    double start = stats != NULL ? px_time_ns() : 0;
+    w->status = w->callback(w->pxdoc, block->recno, records, block->numrecords, w->user_data);
+    if (stats != NULL) {
+      stats->nsdecode += px_time_ns() - start;
+      stats->recordsdecoded += block->numrecords;
+    }
+    if (w->status != 0) {
+      break;
+    }
+  }
+
+  if (fp != NULL) fclose(fp);
+  free(buffer);
+  return NULL;
+}
+
+// The ranges of blocks of all jobs, taken by the threads one after the other.
+typedef struct {
+  px_worker_t* ranges;
+  int num_ranges;
+  int next;                    // The first range no thread has taken yet.
+  pthread_mutex_t lock;
+} px_queue_t;
+
+static void* queue_worker(void* arg) {
+  px_queue_t* queue = (px_queue_t*) arg;
+  for (;;) {
+    pthread_mutex_lock(&queue->lock);
+    int r = queue->next < queue->num_ranges ? queue->next++ : -1;
+    pthread_mutex_unlock(&queue->lock);
+    if (r < 0) break;
+    scan_worker(&queue->ranges[r]);
+  }
+  return NULL;
+}
+
+// Larger ranges go first, so that the threads finish at about the same time.
+static int compare_ranges(const void* a, const void* b) {
+  const px_worker_t* x = (const px_worker_t*) a;
+  const px_worker_t* y = (const px_worker_t*) b;
+  return (y->num_blocks > x->num_blocks) - (y->num_blocks < x->num_blocks);
+}
+
+/**
+ * @brief Whether the blocks of a document can be read by the worker threads.
+ */
+static int can_scan_parallel(pxdoc_t* pxdoc) {
+  // Without an index the blocks can only be found by following the block list.
+  return pxdoc->px_indexdata != NULL && pxdoc->px_stream != NULL &&
+    (pxdoc->px_stream->type == pxfIOMmap || pxdoc->px_name != NULL);
+}
+
+int px_scan_parallel_jobs(px_scan_job_t* jobs, int num_jobs, int num_threads) {
+  pxscanblock_t** plans = (pxscanblock_t**) calloc(num_jobs > 0 ? num_jobs : 1, sizeof(pxscanblock_t*));
+  int* num_blocks = (int*) calloc(num_jobs > 0 ? num_jobs : 1, sizeof(int));
+  if (plans == NULL || num_blocks == NULL) {
+    free(plans);
+    free(num_blocks);
+    return -1;
+  }
+
+  // The blocks are planned on this thread, which also scans the documents the threads cannot read.
+  int num_ranges = 0;
+  for (int i = 0; i < num_jobs; i++) {
+    px_scan_job_t* job = &jobs[i];
+    job->status = 0;
+    // A file opened with a deferred index gets it now, the threads need it.
+    if (job->pxdoc == NULL || PX_load_index(job->pxdoc) < 0) {
+      job->status = -1;
+      continue;
+    }
+    if (num_threads <= 1 || !can_scan_parallel(job->pxdoc)) {
+      job->status = PX_scan_range(job->pxdoc, job->pos, job->maxrecords, job->callback, job->user_data);
+      continue;
+    }
+    num_blocks[i] = PX_scan_plan(job->pxdoc, job->pos, job->maxrecords, &plans[i]);
+    if (num_blocks[i] < 0) {
+      job->status = -1;
+      num_blocks[i] = 0;
+    }
+    num_ranges += num_blocks[i] < num_threads ? num_blocks[i] : num_threads;
+  }
+
+  // Each job is split into one contiguous range of blocks per thread.
+  px_queue_t queue;
+  queue.ranges = (px_worker_t*) calloc(num_ranges > 0 ? num_ranges : 1, sizeof(px_worker_t));
+  queue.num_ranges = 0;
+  queue.next = 0;
+  int ret = queue.ranges == NULL ? -1 : 0;
+  for (int i = 0; i < num_jobs && ret == 0; i++) {
+    int parts = num_blocks[i] < num_threads ? num_blocks[i] : num_threads;
+    for (int t = 0; t < parts; t++) {
+      int first = (int) ((long long) num_blocks[i] * t / parts);
+      int last = (int) ((long long) num_blocks[i] * (t + 1) / parts);
+      px_worker_t* range = &queue.ranges[queue.num_ranges++];
+      range->pxdoc = jobs[i].pxdoc;
+      range->blocks = plans[i] + first;
+      range->num_blocks = last - first;
+      range->callback = jobs[i].callback;
+      range->user_data = jobs[i].user_data;
+      range->job = i;
+    }
+  }
+
+  if (ret == 0 && queue.num_ranges > 0) {
+    qsort(queue.ranges, (size_t) queue.num_ranges, sizeof(px_worker_t), compare_ranges);
+    pthread_mutex_init(&queue.lock, NULL);
+    int num_workers = num_threads < queue.num_ranges ? num_threads : queue.num_ranges;
+    pthread_t* threads = (pthread_t*) calloc(num_workers, sizeof(pthread_t));
+    int* started = (int*) calloc(num_workers, sizeof(int));
+    for (int t = 1; threads != NULL && started != NULL && t < num_workers; t++) {
+      started[t] = pthread_create(&threads[t], NULL, queue_worker, &queue) == 0;
+    }
+    // The calling thread takes ranges as well, and all of them if no thread could be started.
+    queue_worker(&queue);
+    for (int t = 1; threads != NULL && started != NULL && t < num_workers; t++) {
+      if (started[t]) pthread_join(threads[t], NULL);
+    }
+    free(threads);
+    free(started);
+    pthread_mutex_destroy(&queue.lock);
+
+    for (int r = 0; r < queue.num_ranges; r++) {
+      if (queue.ranges[r].pxdoc->px_stats != NULL) {
+        px_stats_add(queue.ranges[r].pxdoc->px_stats, &queue.ranges[r].stats);
+      }
+    }
+
+    // A job fails with the first failure of its ranges, in the order of the blocks.
+    for (int i = 0; i < num_jobs; i++) {
+      const pxscanblock_t* failed = NULL;
+      for (int r = 0; r < queue.num_ranges; r++) {
+        const px_worker_t* range = &queue.ranges[r];
+        if (range->job == i && range->status != 0 && (failed == NULL || range->blocks < failed)) {
+          failed = range->blocks;
+          jobs[i].status = range->status;
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < num_jobs; i++) {
+    if (plans[i]) jobs[i].pxdoc->free(jobs[i].pxdoc, plans[i]);
+    if (ret != 0 && num_blocks[i] > 0) jobs[i].status = -1;
+  }
+  free(queue.ranges);
+  free(plans);
+  free(num_blocks);
+
+  for (int i = 0; i < num_jobs && ret == 0; i++) {
+    if (jobs[i].status != 0) ret = -1;
+  }
+  return ret;
+}
+
+int px_scan_parallel(pxdoc_t* pxdoc, pxscanpos_t* pos, int maxrecords, int num_threads,
+                     px_scan_callback_t callback, void* user_data) {
+  px_scan_job_t job;
+  job.pxdoc = pxdoc;
+  job.pos = pos;
+  job.maxrecords = maxrecords;
+  job.callback = callback;
+  job.user_data = user_data;
+  px_scan_parallel_jobs(&job, 1, num_threads);
+  return job.status;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file parallel.h
+ * @brief Multi-threaded scan of the data blocks of a Paradox file.
+ */
+
+#ifndef RPARADOX_PARALLEL_H
+#define RPARADOX_PARALLEL_H
+
+#include "paradox.h"
+
+/**
+ * @brief Reads records block by block with several threads.
+ *
+ * Works like `PX_scan_range()`, but the data blocks are split into
+ * `num_threads` contiguous ranges, which are read, decrypted and passed to
+ * `callback` by separate threads. The callback is therefore called
+ * concurrently and in no particular order. It must not call the R API or
+ * any pxlib function that may report an error.
+ *
+ * Each thread reads through its own file handle, or straight from the
+ * mapping if the file is memory mapped. Without a primary index, or with a
+ * single thread, the records are scanned on the calling thread.
+ *
+ * @param pxdoc The open Paradox document. It must not be modified meanwhile.
+ * @param pos The scan position to start at. It is advanced behind the last record.
+ * @param maxrecords The maximum number of records, or a negative value for all.
+ * @param num_threads The number of threads to use.
+ * @param callback The thread-safe block callback.
+ * @param user_data Passed to the callback.
+ * @return 0 on success, otherwise -1 or the first non-zero return value of
+ *   the callback.
+ */
+int px_scan_parallel(pxdoc_t* pxdoc, pxscanpos_t* pos, int maxrecords, int num_threads,
+                     px_scan_callback_t callback, void* user_data);
+
+/**
+ * @brief A scan of one document, see `px_scan_parallel_jobs()`.
+ */
+typedef struct {
+  pxdoc_t* pxdoc;              // The open Paradox document.
+  pxscanpos_t* pos;            // The scan position to start at, advanced behind the last record.
+  int maxrecords;              // The maximum number of records, or a negative value for all.
+  px_scan_callback_t callback; // The thread-safe block callback.
+  void* user_data;             // Passed to the callback.
+  int status;                  // Set to the result of the scan, like that of `px_scan_parallel()`.
+} px_scan_job_t;
+
+/**
+ * @brief Scans several documents at once with a common pool of threads.
+ *
+ * Works like `px_scan_parallel()` for each job, but the data blocks of all
+ * documents are read by the same `num_threads` threads, so that small files
+ * are read concurrently as well and no thread waits for another while blocks
+ * remain. The documents must be distinct. Those that cannot be read by the
+ * threads are scanned on the calling thread first.
+ *
+ * @param jobs The scans, their `status` is set on return.
+ * @param num_jobs The number of jobs.
+ * @param num_threads The number of threads to use.
+ * @return 0 if all scans succeeded, otherwise -1.
+ */
+int px_scan_parallel_jobs(px_scan_job_t* jobs, int num_jobs, int num_threads);
+
+#endif /* RPARADOX_PARALLEL_H */
@@ -2,18 +2,16 @@
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "paradox.h"
+#include "px_intern.h"
 #include "px_crypt.h"
 
 static void px_encrypt_chunk(unsigned char src[256], unsigned char dst[256],
                              unsigned char a, unsigned char b,
                              unsigned char c, unsigned char d);
 
-static void px_decrypt_chunk(unsigned char src[256], unsigned char dst[256],
-                             unsigned char a, unsigned char b,
-                             unsigned char c, unsigned char d);
-
 static void px_encrypt_chunk2(unsigned char src[256], unsigned char dst[256],
                        int lenpassw);
 
@@ -192,60 +190,205 @@ void px_encrypt_mb_block(unsigned char *src, unsigned char *dest,
 /* }}} */
 
 
-/* px_decrypt_chunk(src, dst, a, b, c, d) {{{
+/* px_crypt_key_init() {{{
+ *
+ * Precomputes the tables for decrypting with the given key. Decrypting
+ * byte x of a 256 byte chunk reads
+ *   src[y] ^ table_a[x+a] ^ table_b[y+b] ^ table_c[y+c]
+ * with y = table_c[x]-d (all indices mod 256), where a and b are taken
+ * from the key. c and d are the chunk and block number for db blocks
+ * and fixed for mb blocks, so everything but src can be computed in
+ * advance for mb blocks and everything but the c term once per block
+ * for db blocks.
  */
-static void px_decrypt_chunk(unsigned char src[256], unsigned char dst[256],
-                             unsigned char a, unsigned char b,
-                             unsigned char c, unsigned char d)
-{
-	unsigned char tmp[256];
-	register int x, y;
+void px_crypt_key_init(pxcryptkey_t *key, unsigned long encryption) {
+	unsigned char a, b, c, d;
+	int x, y;
 
+	key->encryption = encryption;
+	a = encryption & 0xff;
+	b = (encryption >> 8) & 0xff;
+	for (x = 0; x < 256; ++x) {
+		key->a_table[x] = encryption_table_a[(x + a) & 0xff];
+		key->c_table2[x] = encryption_table_c[x];
+		key->c_table2[x + 256] = encryption_table_c[x];
+	}
+
+	c = a + 1;
+	d = b + 1;
 	for (x = 0; x < 256; ++x) {
 		y = (encryption_table_c[x] - d) & 0xff;
-		tmp[x] = src[y] ^
-			encryption_table_a[(x + a) & 0xff] ^
+		key->mb_perm[x] = y;
+		key->mb_mask[x] = key->a_table[x] ^
 			encryption_table_b[(y + b) & 0xff] ^
 			encryption_table_c[(y + c) & 0xff];
 	}
-	memcpy(dst, tmp, 256);
 }
 /* }}} */
 
-/* px_decrypt_db_block(src, dest, encryption, blocksize, blockno) {{{
+/* px_xor_chunk() {{{
+ *
+ * dst = src ^ mask for a 256 byte chunk, 64 bits at a time. The
+ * compiler turns this into SIMD instructions where available.
  */
-void px_decrypt_db_block(unsigned char *src, unsigned char *dest,
-                         unsigned long encryption, unsigned long blocksize,
-                         unsigned long blockno)
+static void px_xor_chunk(unsigned char *dst, const unsigned char *src, const unsigned char *mask) {
+	uint64_t s, m;
+	int i;
+
+	for (i = 0; i < 256; i += 8) {
+		memcpy(&s, src + i, 8);
+		memcpy(&m, mask + i, 8);
+		s ^= m;
+		memcpy(dst + i, &s, 8);
+	}
+}
+/* }}} */
+
+/* px_decrypt_db_block_key(key, src, dest, blocksize, blockno) {{{
+ *
+ * Same as px_decrypt_db_block() with tables precomputed by
+ * px_crypt_key_init(). src and dest may be the same.
+ */
+void px_decrypt_db_block_key(const pxcryptkey_t *key, unsigned char *src,
+                             unsigned char *dest, unsigned long blocksize,
+                             unsigned long blockno)
 {
+	unsigned char perm[256], mask[256], tmp[256];
 	unsigned int chunk;
-	unsigned char a,b;
+	unsigned char b, d;
+	int x, y;
+
+	b = (key->encryption >> 8) & 0xff;
+	d = (unsigned char) blockno;
+	for (x = 0; x < 256; ++x) {
+		y = (encryption_table_c[x] - d) & 0xff;
+		perm[x] = y;
+		mask[x] = key->a_table[x] ^ encryption_table_b[(y + b) & 0xff];
+	}
 
-	a = encryption & 0xff;
-	b = (encryption >> 8) & 0xff;
 	blocksize >>= 8;
+	for (chunk = 0; chunk < blocksize; ++chunk) {
+		unsigned char *out = dest + (chunk << 8);
+		/* The c term only depends on the source position. */
+		px_xor_chunk(tmp, src + (chunk << 8), key->c_table2 + (chunk & 0xff));
+		for (x = 0; x < 256; ++x) {
+			out[x] = tmp[perm[x]] ^ mask[x];
+		}
+	}
+}
+/* }}} */
+
+/* px_decrypt_mb_block_key(key, src, dest, blocksize) {{{
+ *
+ * Same as px_decrypt_mb_block() with tables precomputed by
+ * px_crypt_key_init(). src and dest may be the same.
+ */
+void px_decrypt_mb_block_key(const pxcryptkey_t *key, unsigned char *src,
+                             unsigned char *dest, unsigned long blocksize)
+{
+	unsigned char tmp[256];
+	unsigned int chunk;
+	int x;
 
+	blocksize >>= 8;
 	for (chunk = 0; chunk < blocksize; ++chunk) {
-		px_decrypt_chunk(src + (chunk << 8), dest + (chunk << 8), a, b, chunk, (unsigned char)blockno);
+		unsigned char *out = dest + (chunk << 8);
+		memcpy(tmp, src + (chunk << 8), 256);
+		for (x = 0; x < 256; ++x) {
+			out[x] = tmp[key->mb_perm[x]] ^ key->mb_mask[x];
+		}
 	}
 }
 /* }}} */
 
+/* px_decrypt_db_block(src, dest, encryption, blocksize, blockno) {{{
+ */
+void px_decrypt_db_block(unsigned char *src, unsigned char *dest,
+                         unsigned long encryption, unsigned long blocksize,
+                         unsigned long blockno)
+{
+	pxcryptkey_t key;
+
+	px_crypt_key_init(&key, encryption);
+	px_decrypt_db_block_key(&key, src, dest, blocksize, blockno);
+}
+/* }}} */
+
 /* px_decrypt_mb_block(src, dest, encryption, blocksize) {{{
  */
 void px_decrypt_mb_block(unsigned char *src, unsigned char *dest,
                          unsigned long encryption, unsigned long blocksize)
 {
-	unsigned int chunk;
-	unsigned char a,b;
+	pxcryptkey_t key;
 
-	a = encryption & 0xFF;
-	b = (encryption >> 8) & 0xFF;
-	blocksize >>= 8;
+	px_crypt_key_init(&key, encryption);
+	px_decrypt_mb_block_key(&key, src, dest, blocksize);
+}
+/* }}} */
 
-	for (chunk = 0; chunk < blocksize; ++chunk) {
-		px_decrypt_chunk(src + (chunk << 8), dest + (chunk << 8), a, b, a+1, b+1);
+/* px_set_crypt_key() {{{
+ *
+ * Precomputes the decryption tables of a document for the given key.
+ * It is called when the header is read, before the document is read
+ * by several threads.
+ * Returns 0 on success or -1 if no memory could be allocated.
+ */
+int px_set_crypt_key(pxdoc_t *pxdoc, unsigned long encryption) {
+	if(encryption == 0)
+		return 0;
+	if(pxdoc->px_cryptkey == NULL) {
+		pxdoc->px_cryptkey = pxdoc->malloc(pxdoc, sizeof(pxcryptkey_t), _("Allocate memory for decryption tables."));
+		if(pxdoc->px_cryptkey == NULL)
+			return -1;
 	}
+	px_crypt_key_init(pxdoc->px_cryptkey, encryption);
+	return 0;
+}
+/* }}} */
+
+/* px_doc_crypt_key() {{{
+ *
+ * Returns the precomputed tables of a document if they match the key
+ * in its header, otherwise NULL.
+ */
+static const pxcryptkey_t *px_doc_crypt_key(pxdoc_t *pxdoc) {
+	const pxcryptkey_t *key = pxdoc->px_cryptkey;
+
+	if(key == NULL || key->encryption != (unsigned long) pxdoc->px_head->px_encryption)
+		return NULL;
+	return key;
+}
+/* }}} */
+
+/* px_decrypt_db_block_doc(pxdoc, src, dest, blocksize, blockno) {{{
+ *
+ * Decrypts a data block of a document with its precomputed tables.
+ * The tables are not modified, so several threads may call this at
+ * the same time.
+ */
+void px_decrypt_db_block_doc(pxdoc_t *pxdoc, unsigned char *src, unsigned char *dest,
+                             unsigned long blocksize, unsigned long blockno) {
+	const pxcryptkey_t *key = px_doc_crypt_key(pxdoc);
+
+	if(key)
+		px_decrypt_db_block_key(key, src, dest, blocksize, blockno);
+	else
+		px_decrypt_db_block(src, dest, pxdoc->px_head->px_encryption, blocksize, blockno);
+}
+/* }}} */
+
+/* px_decrypt_mb_block_doc(pxdoc, src, dest, blocksize) {{{
+ *
+ * Decrypts blob data of a document with its precomputed tables.
+ */
+void px_decrypt_mb_block_doc(pxdoc_t *pxdoc, unsigned char *src, unsigned char *dest,
+                             unsigned long blocksize) {
+	const pxcryptkey_t *key = px_doc_crypt_key(pxdoc);
+
+	if(key)
+		px_decrypt_mb_block_key(key, src, dest, blocksize);
+	else
+		px_decrypt_mb_block(src, dest, pxdoc->px_head->px_encryption, blocksize);
 }
 /* }}} */
 
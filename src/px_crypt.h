@@ -1,6 +1,16 @@
 #ifndef __PX_CRYPT_H
 #define __PX_CRYPT_H 1
 
+/* Decryption tables of a key, see px_crypt_key_init() */
+typedef struct px_crypt_key pxcryptkey_t;
+struct px_crypt_key {
+	unsigned long encryption;    /* the key the tables were computed for */
+	unsigned char a_table[256];  /* encryption_table_a rotated by the key */
+	unsigned char c_table2[512]; /* encryption_table_c twice */
+	unsigned char mb_perm[256];  /* source position of each byte of mb chunks */
+	unsigned char mb_mask[256];  /* key bytes of mb chunks */
+};
+
 void px_encrypt_db_block(unsigned char *src, unsigned char *dest,
                          unsigned long encryption, unsigned long blocksize,
                          unsigned long blockno);
@@ -15,6 +25,23 @@ void px_decrypt_db_block(unsigned char *src, unsigned char *dest,
 void px_decrypt_mb_block(unsigned char *src, unsigned char *dest,
                          unsigned long encryption, unsigned long blocksize);
 
+void px_crypt_key_init(pxcryptkey_t *key, unsigned long encryption);
+
+void px_decrypt_db_block_key(const pxcryptkey_t *key, unsigned char *src,
+                             unsigned char *dest, unsigned long blocksize,
+                             unsigned long blockno);
+
+void px_decrypt_mb_block_key(const pxcryptkey_t *key, unsigned char *src,
+                             unsigned char *dest, unsigned long blocksize);
+
+int px_set_crypt_key(pxdoc_t *pxdoc, unsigned long encryption);
+
+void px_decrypt_db_block_doc(pxdoc_t *pxdoc, unsigned char *src, unsigned char *dest,
+                             unsigned long blocksize, unsigned long blockno);
+
+void px_decrypt_mb_block_doc(pxdoc_t *pxdoc, unsigned char *src, unsigned char *dest,
+                             unsigned long blocksize);
+
 long px_passwd_checksum(const char *aPsw);
 
 #endif /* __PX_CRYPT_H */
@@ -1,6 +1,17 @@
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include "px_intern.h"
 #include "paradox.h"
+#include "px_encode.h"
+
+/* Conversion table of a single-byte codepage. Each byte maps to at most
+ * 4 bytes of the target encoding, a length of 0 marks undefined bytes.
+ */
+struct px_codetable {
+  unsigned char len[256];
+  char seq[256][4];
+};
 
 void px_init_targetencoding(pxdoc_t *pxdoc) {
   pxdoc->out_iconvcd = (Riconv_t) -1;
@@ -10,17 +21,62 @@ void px_init_inputencoding(pxdoc_t *pxdoc) {
   pxdoc->in_iconvcd = (Riconv_t) -1;
 }
 
+/* px_build_codetable() {{{
+ * Converts every byte on its own with out_iconvcd. If each one is either a
+ * complete character or undefined, the codepage is a single-byte one and
+ * the table replaces iconv for the data. Returns NULL otherwise.
+ */
+static struct px_codetable *px_build_codetable(pxdoc_t *pxdoc) {
+  struct px_codetable *table;
+
+  table = (struct px_codetable *) pxdoc->malloc(pxdoc, sizeof(struct px_codetable), _("Allocate memory for codepage table."));
+  if(table == NULL)
+    return NULL;
+  memset(table, 0, sizeof(struct px_codetable));
+  /* Zero bytes are kept as they are */
+  table->len[0] = 1;
+
+  for(int b = 1; b < 256; b++) {
+    char in = (char) b;
+    const char *inbuf = &in;
+    size_t inleft = 1;
+    char *outbuf = table->seq[b];
+    size_t outleft = sizeof(table->seq[b]);
+
+    if((size_t)(-1) == Riconv(pxdoc->out_iconvcd, &inbuf, &inleft, &outbuf, &outleft)) {
+      int err = errno;
+      Riconv(pxdoc->out_iconvcd, NULL, NULL, NULL, NULL);
+      if(err == EILSEQ)
+        continue;
+      /* Lead byte of a multi-byte character, or a too long sequence */
+      pxdoc->free(pxdoc, table);
+      return NULL;
+    }
+    table->len[b] = (unsigned char) (sizeof(table->seq[b]) - outleft);
+  }
+  return table;
+}
+/* }}} */
+
+/* px_set_targetencoding() {{{
+ * Opens the conversion from the codepage of the file, or sourceencoding
+ * if set, to targetencoding.
+ */
 int px_set_targetencoding(pxdoc_t *pxdoc) {
   if(pxdoc->targetencoding) {
     char buffer[30];
-    snprintf(buffer, sizeof(buffer), "CP%d", pxdoc->px_head->px_doscodepage);
+    const char *source = buffer;
+    if(pxdoc->sourceencoding)
+      source = pxdoc->sourceencoding;
+    else
+      snprintf(buffer, sizeof(buffer), "CP%d", pxdoc->px_head->px_doscodepage);
     
-    if(pxdoc->out_iconvcd != (Riconv_t)(-1))
-      Riconv_close(pxdoc->out_iconvcd);
+    px_free_targetencoding(pxdoc);
     
-    if((Riconv_t)(-1) == (pxdoc->out_iconvcd = Riconv_open(pxdoc->targetencoding, buffer))) {
+    if((Riconv_t)(-1) == (pxdoc->out_iconvcd = Riconv_open(pxdoc->targetencoding, source))) {
       return -1;
     } else {
+      pxdoc->out_codetable = px_build_codetable(pxdoc);
       return 0;
     }
   } else {
@@ -28,6 +84,77 @@ int px_set_targetencoding(pxdoc_t *pxdoc) {
   }
   return 0;
 }
+/* }}} */
+
+/* px_free_targetencoding() {{{
+ * Closes the conversion opened by px_set_targetencoding().
+ */
+void px_free_targetencoding(pxdoc_t *pxdoc) {
+  if(pxdoc->out_iconvcd != (Riconv_t)(-1))
+    Riconv_close(pxdoc->out_iconvcd);
+  pxdoc->out_iconvcd = (Riconv_t)(-1);
+  if(pxdoc->out_codetable)
+    pxdoc->free(pxdoc, pxdoc->out_codetable);
+  pxdoc->out_codetable = NULL;
+}
+/* }}} */
+
+/* px_recode_target() {{{
+ * Converts len bytes of field data to the target encoding. Writes at most
+ * outsize bytes to out and returns their number; 4 * len bytes are always
+ * enough. Undefined characters become U+FFFD, or '?' if the target is not
+ * UTF-8. Must not be called before px_set_targetencoding() succeeded.
+ */
+size_t px_recode_target(pxdoc_t *pxdoc, const char *in, size_t len, char *out, size_t outsize) {
+  static const char utf8_replacement[] = "\xEF\xBF\xBD";
+  const char *repl = "?";
+  size_t repllen = 1;
+  char *outbuf = out;
+  size_t outleft = outsize;
+
+  if(strcmp(pxdoc->targetencoding, "UTF-8") == 0) {
+    repl = utf8_replacement;
+    repllen = 3;
+  }
+
+  if(pxdoc->out_codetable) {
+    const struct px_codetable *table = pxdoc->out_codetable;
+    for(size_t i = 0; i < len; i++) {
+      unsigned char b = (unsigned char) in[i];
+      const char *seq = table->seq[b];
+      size_t n = table->len[b];
+      if(n == 0) {
+        seq = repl;
+        n = repllen;
+      }
+      if(n > outleft)
+        break;
+      memcpy(outbuf, seq, n);
+      outbuf += n;
+      outleft -= n;
+    }
+    return outsize - outleft;
+  }
+
+  const char *inbuf = in;
+  size_t inleft = len;
+  while(inleft > 0) {
+    if((size_t)(-1) != Riconv(pxdoc->out_iconvcd, &inbuf, &inleft, &outbuf, &outleft))
+      break;
+    if(errno == E2BIG || repllen > outleft)
+      break;
+    /* Skip an invalid or incomplete character */
+    memcpy(outbuf, repl, repllen);
+    outbuf += repllen;
+    outleft -= repllen;
+    inbuf++;
+    inleft--;
+  }
+  /* Flush the shift state of stateful encodings */
+  Riconv(pxdoc->out_iconvcd, NULL, NULL, &outbuf, &outleft);
+  return outsize - outleft;
+}
+/* }}} */
 
 int px_set_inputencoding(pxdoc_t *pxdoc) {
   if(pxdoc->inputencoding) {
@@ -1,7 +1,10 @@
 #ifndef __PX_ENCODE_H__
 #define __PX_ENCODE_H__
+#include <stddef.h>
 void px_init_targetencoding(pxdoc_t *pxdoc);
 void px_init_inputencoding(pxdoc_t *pxdoc);
 int px_set_inputencoding(pxdoc_t *pxdoc);
 int px_set_targetencoding(pxdoc_t *pxdoc);
+void px_free_targetencoding(pxdoc_t *pxdoc);
+size_t px_recode_target(pxdoc_t *pxdoc, const char *in, size_t len, char *out, size_t outsize);
 #endif
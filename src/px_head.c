@@ -13,6 +13,7 @@
 #include "px_io.h"
 #include "px_error.h"
 #include "px_misc.h"
+#include "px_crypt.h"
 
 /* TMPBUFFSIZE must be larger than 261 because the tablename must fit into
  * the buffer. It is also the maximum length of a field name. Field names
@@ -143,6 +144,11 @@ pxhead_t *get_px_head(pxdoc_t *pxdoc, pxstream_t *pxs)
 	if ((pxh->px_encryption & 0xFFFFFFFF) == 0xFF00FF00) {
 		pxh->px_encryption = get_long_le((const char*)&pxdatahead.encryption2);
 	}
+	if(px_set_crypt_key(pxdoc, pxh->px_encryption) < 0) {
+		px_error(pxdoc, PX_MemoryError, _("Could not allocate memory for decryption tables."));
+		pxdoc->free(pxdoc, pxh);
+		return NULL;
+	}
 
 	/* The theoretical number of records is calculated from the number
 	 * of data blocks and the number of records that fit into a data
@@ -530,10 +536,11 @@ int put_px_head(pxdoc_t *pxdoc, pxhead_t *pxh, pxstream_t *pxs) {
 int get_datablock_head(pxdoc_t *pxdoc, pxstream_t *pxs, int datablocknr, TDataBlock *datablockhead)
 {
 	pxhead_t *pxh;
-	int position, ret;
+	long position;
+	int ret;
 
 	pxh = pxdoc->px_head;
-	position = pxh->px_headersize+(datablocknr-1)*pxh->px_maxtablesize*0x400;
+	position = pxh->px_headersize+(long) (datablocknr-1)*pxh->px_maxtablesize*0x400;
 	if((ret = pxdoc->seek(pxdoc, pxs, position, SEEK_SET)) < 0) {
 		return -1;
 	}
@@ -551,10 +558,11 @@ int get_datablock_head(pxdoc_t *pxdoc, pxstream_t *pxs, int datablocknr, TDataBl
 int put_datablock_head(pxdoc_t *pxdoc, pxstream_t *pxs, int datablocknr, TDataBlock *datablockhead)
 {
 	pxhead_t *pxh;
-	int position, ret;
+	long position;
+	int ret;
 
 	pxh = pxdoc->px_head;
-	position =  pxh->px_headersize+(datablocknr-1)*pxh->px_maxtablesize*0x400;
+	position =  pxh->px_headersize+(long) (datablocknr-1)*pxh->px_maxtablesize*0x400;
 	if((ret = pxdoc->seek(pxdoc, pxs, position, SEEK_SET)) < 0) {
 		return -1;
 	}
@@ -737,7 +745,7 @@ int px_add_data_to_block(pxdoc_t *pxdoc, pxhead_t *pxh, int datablocknr, int rec
 	}
 
 	/* Goto start of record data */
-	if((ret = pxdoc->seek(pxdoc, pxs, pxh->px_headersize+(datablocknr-1)*pxh->px_maxtablesize*0x400+sizeof(TDataBlock)+pos*pxh->px_recordsize, SEEK_SET)) < 0) {
+	if((ret = pxdoc->seek(pxdoc, pxs, pxh->px_headersize+(long) (datablocknr-1)*pxh->px_maxtablesize*0x400+sizeof(TDataBlock)+pos*pxh->px_recordsize, SEEK_SET)) < 0) {
 		px_error(pxdoc, PX_RuntimeError, _("Could not fseek to start of new record."));
 		return -1;
 	}
@@ -849,7 +857,7 @@ int _px_add_data_to_block(pxdoc_t *pxdoc, pxhead_t *pxh, int datablocknr, int re
 	pos = recnr;
 
 	/* Goto start of record data */
-	if((ret = pxdoc->seek(pxdoc, pxs, pxh->px_headersize+(datablocknr-1)*pxh->px_maxtablesize*0x400+sizeof(TDataBlock)+pos*pxh->px_recordsize, SEEK_SET)) < 0) {
+	if((ret = pxdoc->seek(pxdoc, pxs, pxh->px_headersize+(long) (datablocknr-1)*pxh->px_maxtablesize*0x400+sizeof(TDataBlock)+pos*pxh->px_recordsize, SEEK_SET)) < 0) {
 		px_error(pxdoc, PX_RuntimeError, _("Could not fseek to start of new record."));
 		return -1;
 	}
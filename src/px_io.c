@@ -6,12 +6,76 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <stdint.h>
 #include "px_intern.h"
 #include "paradox-gsf.h"
 #include "px_error.h"
 #include "px_crypt.h"
 #include "px_io.h"
 
+#if defined(_WIN32)
+#include <windows.h>
+#define PX_HAVE_MMAP 1
+#elif defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define PX_HAVE_MMAP 1
+/* Positions in the stream are longs, and the mapping length a size_t. */
+#if LONG_MAX < SIZE_MAX
+#define PX_MMAP_MAXSIZE ((unsigned long long) LONG_MAX)
+#else
+#define PX_MMAP_MAXSIZE ((unsigned long long) SIZE_MAX)
+#endif
+#endif
+
+/* px_time_ns() {{{
+ *
+ * Returns the time of a monotonic clock in nanoseconds, for the
+ * counters of the read path. Only differences are meaningful.
+ */
+double px_time_ns(void) {
+#if defined(_WIN32)
+	LARGE_INTEGER count, freq;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&freq);
+	return((double) count.QuadPart * 1e9 / (double) freq.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((double) ts.tv_sec * 1e9 + (double) ts.tv_nsec);
+#else
+	return((double) clock() * 1e9 / CLOCKS_PER_SEC);
+#endif
+}
+/* }}} */
+
+/* px_stats_add() {{{
+ *
+ * Adds the counters of from to those of to, e.g. the counters of a
+ * thread to those of the document.
+ */
+void px_stats_add(pxstats_t *to, const pxstats_t *from) {
+	to->blocksread += from->blocksread;
+	to->blockcachehits += from->blockcachehits;
+	to->blockcachemisses += from->blockcachemisses;
+	to->bytesread += from->bytesread;
+	to->bytesdecrypted += from->bytesdecrypted;
+	to->mbseeks += from->mbseeks;
+	to->mbreads += from->mbreads;
+	to->mbbytesread += from->mbbytesread;
+	to->recordsdecoded += from->recordsdecoded;
+	to->nsio += from->nsio;
+	to->nsdecrypt += from->nsdecrypt;
+	to->nsblob += from->nsblob;
+	to->nsdecode += from->nsdecode;
+}
+/* }}} */
+
 /* px_stream_new() {{{
  *
  * Create a new stream
@@ -81,6 +145,342 @@ pxstream_t *px_stream_new_file(pxdoc_t *pxdoc, int mode, int close, FILE *fp) {
 /* }}} */
 
 /* Generic file access functions for .db and .px files */
+/* px_stream_new_mmap() {{{
+ *
+ * Create a stream reading from a memory mapped file. The file is
+ * mapped read only as a whole. Returns NULL if the file cannot be
+ * mapped, e.g. because it is empty or the platform does not support
+ * memory mapped files. In that case the caller should fall back to
+ * a file stream. As stream positions are longs, files of 2 GB or more
+ * can only be mapped where long has 64 bits, i.e. not on Windows.
+ */
+pxstream_t *px_stream_new_mmap(pxdoc_t *pxdoc, int mode, int closestream, const char *filename) {
+#if PX_HAVE_MMAP
+	pxstream_t *pxs;
+	unsigned char *data;
+	long size;
+#if defined(_WIN32)
+	HANDLE fh, mh;
+	LARGE_INTEGER fsize;
+
+	if(mode != pxfFileRead)
+		return(NULL);
+	fh = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(fh == INVALID_HANDLE_VALUE)
+		return(NULL);
+	if(!GetFileSizeEx(fh, &fsize) || fsize.QuadPart <= 0 || fsize.QuadPart > 0x7fffffffL) {
+		CloseHandle(fh);
+		return(NULL);
+	}
+	size = (long) fsize.QuadPart;
+	mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(fh);
+	if(mh == NULL)
+		return(NULL);
+	/* The view keeps the mapping alive after its handle is closed. */
+	data = (unsigned char *) MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mh);
+	if(data == NULL)
+		return(NULL);
+#else
+	int fd;
+	struct stat st;
+	void *map;
+
+	if(mode != pxfFileRead)
+		return(NULL);
+	if((fd = open(filename, O_RDONLY)) < 0)
+		return(NULL);
+	if(fstat(fd, &st) < 0 || st.st_size <= 0 || (unsigned long long) st.st_size > PX_MMAP_MAXSIZE) {
+		close(fd);
+		return(NULL);
+	}
+	size = (long) st.st_size;
+	map = mmap(NULL, (size_t) size, PROT_READ, MAP_PRIVATE, fd, 0);
+	/* The mapping stays valid after the file descriptor is closed. */
+	close(fd);
+	if(map == MAP_FAILED)
+		return(NULL);
+#ifdef POSIX_MADV_SEQUENTIAL
+	posix_madvise(map, (size_t) size, POSIX_MADV_SEQUENTIAL);
+#endif
+	data = (unsigned char *) map;
+#endif
+
+	if(NULL == (pxs = px_stream_new(pxdoc))) {
+		px_stream_unmap(pxdoc, data, size);
+		return(NULL);
+	}
+
+	pxs->type = pxfIOMmap;
+	pxs->mode = mode;
+	pxs->close = closestream;
+	pxs->s.mm.data = data;
+	pxs->s.mm.size = size;
+	pxs->s.mm.pos = 0;
+
+	pxs->read = px_mmread;
+	pxs->seek = px_mmseek;
+	pxs->tell = px_mmtell;
+	pxs->write = px_mmwrite;
+	return(pxs);
+#else
+	return(NULL);
+#endif
+}
+/* }}} */
+
+/* px_stream_unmap() {{{
+ *
+ * Release a mapping created by px_stream_new_mmap()
+ */
+void px_stream_unmap(pxdoc_t *pxdoc, unsigned char *data, long size) {
+	(void) pxdoc;
+#if PX_HAVE_MMAP
+	if(data == NULL)
+		return;
+#if defined(_WIN32)
+	UnmapViewOfFile(data);
+#else
+	munmap(data, (size_t) size);
+#endif
+#else
+	(void) data;
+	(void) size;
+#endif
+}
+/* }}} */
+
+/* px_stream_close() {{{
+ *
+ * Close the file or mapping of a stream if it is owned by the stream.
+ * The stream itself is not freed.
+ */
+void px_stream_close(pxdoc_t *pxdoc, pxstream_t *pxs) {
+	if(pxs == NULL || !pxs->close)
+		return;
+	if(pxs->type == pxfIOMmap) {
+		px_stream_unmap(pxdoc, pxs->s.mm.data, pxs->s.mm.size);
+		pxs->s.mm.data = NULL;
+	} else if(pxs->type == pxfIOFile && pxs->s.fp != NULL) {
+		fclose(pxs->s.fp);
+		pxs->s.fp = NULL;
+	}
+}
+/* }}} */
+
+/* px_load_block() {{{
+ *
+ * Read a data block into the block cache of the document and decrypt
+ * it if needed. A modified block in the cache is written back first.
+ * Returns 0 on success and -1 on error.
+ */
+static int px_load_block(pxdoc_t *p, long blocknr) {
+	long blocksize;
+	pxhead_t *pxh;
+	pxstream_t *pxs;
+	pxstats_t *stats = p->px_stats;
+	double start = 0;
+
+	pxh = p->px_head;
+	pxs = p->px_stream;
+	blocksize = pxh->px_maxtablesize * 0x400;
+
+	if(p->curblock == NULL) {
+//		fprintf(stderr, "Allocate memory for cache block.\n");
+		p->curblock = p->malloc(p, blocksize, _("Allocate memory for block cache."));
+		if(p->curblock == NULL) {
+			return(-1);
+		}
+	}
+	if(p->curblocknr != blocknr) {
+//		fprintf(stderr, "Read block %d into cache.\n", blocknr);
+		if(p->curblockdirty == px_true) {
+			pxs->seek(p, pxs, pxh->px_headersize + ((p->curblocknr-1)*blocksize), SEEK_SET);
+			if(pxh->px_encryption != 0) {
+//				fprintf(stderr, "Encrypting block %d\n", p->curblocknr);
+				px_encrypt_db_block(p->curblock, p->curblock, pxh->px_encryption, blocksize, p->curblocknr);
+			}
+			pxs->write(p, pxs, blocksize, p->curblock);
+		}
+		if(stats)
+			start = px_time_ns();
+		memset(p->curblock, 0, blocksize);
+		pxs->seek(p, pxs, pxh->px_headersize + ((blocknr-1)*blocksize), SEEK_SET);
+		pxs->read(p, pxs, blocksize, p->curblock);
+		p->curblocknr = blocknr;
+		if(stats) {
+			stats->nsio += px_time_ns() - start;
+			stats->blocksread++;
+			stats->bytesread += blocksize;
+			stats->blockcachemisses++;
+		}
+		if(pxh->px_encryption != 0) {
+//			fprintf(stderr, "Decrypting block %d\n", blocknr);
+			if(stats)
+				start = px_time_ns();
+			px_decrypt_db_block_doc(p, p->curblock, p->curblock, blocksize, blocknr);
+			if(stats) {
+				stats->nsdecrypt += px_time_ns() - start;
+				stats->bytesdecrypted += blocksize;
+			}
+		}
+	} else {
+//		fprintf(stderr, "block %d already in cache.\n", blocknr);
+		if(stats)
+			stats->blockcachehits++;
+	}
+	return(0);
+}
+/* }}} */
+
+/* px_get_block() {{{
+ *
+ * Returns a pointer to the decrypted data of a data block (the first
+ * block has number 1). Unencrypted blocks of a memory mapped file are
+ * not copied at all, the pointer points into the mapping. Otherwise
+ * the block is read into the block cache. The data is only valid
+ * until the next read from the document and must not be modified.
+ * Returns NULL in case of an error.
+ */
+unsigned char *px_get_block(pxdoc_t *p, long blocknr) {
+	long blocksize, blockstart;
+	pxhead_t *pxh;
+	pxstream_t *pxs;
+
+	pxh = p->px_head;
+	pxs = p->px_stream;
+	if(pxh == NULL || pxs == NULL || blocknr < 1)
+		return(NULL);
+
+	blocksize = pxh->px_maxtablesize * 0x400;
+	blockstart = pxh->px_headersize + (blocknr-1)*blocksize;
+	if(pxs->type == pxfIOMmap && pxh->px_encryption == 0 &&
+	   blockstart + blocksize <= pxs->s.mm.size) {
+		if(p->px_stats) {
+			p->px_stats->blocksread++;
+			p->px_stats->bytesread += blocksize;
+		}
+		return(pxs->s.mm.data + blockstart);
+	}
+	if(px_load_block(p, blocknr) < 0)
+		return(NULL);
+	return(p->curblock);
+}
+/* }}} */
+
+/* px_read_block_r() {{{
+ *
+ * Like px_get_block() but reentrant. The block is read into buffer,
+ * which must be large enough for a complete block, and decrypted there.
+ * Unencrypted blocks of a memory mapped file are again not copied.
+ * Files which are not memory mapped are read through fp, a file handle
+ * of the caller opened on the same file, so the stream and the block
+ * cache of the document are not touched. No errors are reported.
+ * Several threads can therefore read blocks of the same document at
+ * the same time, each with its own fp and buffer, as long as the
+ * document is not modified. The read is counted in stats, which
+ * belongs to the caller as well, unless it is NULL.
+ * Returns a pointer to the block data or NULL in case of an error.
+ */
+unsigned char *px_read_block_r(pxdoc_t *p, FILE *fp, long blocknr, unsigned char *buffer, pxstats_t *stats) {
+	long blocksize, blockstart;
+	pxhead_t *pxh;
+	pxstream_t *pxs;
+	double start = 0;
+
+	pxh = p->px_head;
+	pxs = p->px_stream;
+	if(pxh == NULL || pxs == NULL || blocknr < 1)
+		return(NULL);
+
+	blocksize = pxh->px_maxtablesize * 0x400;
+	blockstart = pxh->px_headersize + (blocknr-1)*blocksize;
+	if(stats) {
+		stats->blocksread++;
+		stats->bytesread += blocksize;
+		start = px_time_ns();
+	}
+	if(pxs->type == pxfIOMmap) {
+		if(blockstart + blocksize > pxs->s.mm.size)
+			return(NULL);
+		if(pxh->px_encryption == 0)
+			return(pxs->s.mm.data + blockstart);
+		memcpy(buffer, pxs->s.mm.data + blockstart, blocksize);
+	} else {
+		if(fp == NULL || fseek(fp, blockstart, SEEK_SET) < 0)
+			return(NULL);
+		/* The last block may be truncated, like in px_load_block(). */
+		memset(buffer, 0, blocksize);
+		if(fread(buffer, 1, blocksize, fp) == 0)
+			return(NULL);
+	}
+	if(pxh->px_encryption != 0) {
+		if(stats) {
+			double now = px_time_ns();
+			stats->nsio += now - start;
+			start = now;
+		}
+		px_decrypt_db_block_doc(p, buffer, buffer, blocksize, blocknr);
+		if(stats) {
+			stats->nsdecrypt += px_time_ns() - start;
+			stats->bytesdecrypted += blocksize;
+		}
+	} else if(stats) {
+		stats->nsio += px_time_ns() - start;
+	}
+	return(buffer);
+}
+/* }}} */
+
+/* px_readahead() {{{
+ *
+ * Tells the operating system that numblocks data blocks starting with
+ * block blocknr are going to be read soon, so it can read them in the
+ * background while the current block is decoded. This matters most on
+ * network file systems, where every read waits for a round trip.
+ * Neither the stream nor the document are modified, so several threads
+ * may call this at the same time. Does nothing for streams or
+ * platforms without such a hint.
+ */
+void px_readahead(pxdoc_t *p, long blocknr, int numblocks) {
+	long blocksize, start, len;
+	pxhead_t *pxh;
+	pxstream_t *pxs;
+
+	pxh = p->px_head;
+	pxs = p->px_stream;
+	if(pxh == NULL || pxs == NULL || blocknr < 1 || numblocks <= 0)
+		return;
+
+	blocksize = pxh->px_maxtablesize * 0x400;
+	start = pxh->px_headersize + (blocknr-1)*blocksize;
+	len = numblocks*blocksize;
+	if(pxs->type == pxfIOFile && pxs->s.fp != NULL) {
+#if defined(POSIX_FADV_WILLNEED)
+		posix_fadvise(fileno(pxs->s.fp), (off_t) start, (off_t) len, POSIX_FADV_WILLNEED);
+#elif defined(F_RDADVISE)
+		struct radvisory ra;
+		ra.ra_offset = (off_t) start;
+		ra.ra_count = (int) len;
+		fcntl(fileno(pxs->s.fp), F_RDADVISE, &ra);
+#endif
+	} else if(pxs->type == pxfIOMmap) {
+#if PX_HAVE_MMAP && defined(POSIX_MADV_WILLNEED)
+		long offset;
+
+		if(start >= pxs->s.mm.size)
+			return;
+		if(start + len > pxs->s.mm.size)
+			len = pxs->s.mm.size - start;
+		/* The address must be aligned to a page */
+		offset = start % sysconf(_SC_PAGESIZE);
+		posix_madvise(pxs->s.mm.data + start - offset, (size_t) (len + offset), POSIX_MADV_WILLNEED);
+#endif
+	}
+}
+/* }}} */
+
 /* px_read() {{{
  *
  * Generic read function doing decryption if needed.
@@ -92,6 +492,7 @@ ssize_t px_read(pxdoc_t *p, pxstream_t *dummy, size_t len, void *buffer) {
 	long blocknr, blockpos, curpos, blocksize;
 	pxhead_t *pxh;
 	pxstream_t *pxs;
+	unsigned char *block;
 
 	pxh = p->px_head;
 	pxs = p->px_stream;
@@ -106,36 +507,10 @@ ssize_t px_read(pxdoc_t *p, pxstream_t *dummy, size_t len, void *buffer) {
 			px_error(p, PX_RuntimeError, _("Trying to read data from file exceeds block boundary."));
 			return(0);
 		}
-		if(p->curblock == NULL) {
-//			fprintf(stderr, "Allocate memory for cache block.\n");
-			p->curblock = p->malloc(p, blocksize, _("Allocate memory for block cache."));
-			if(p->curblock == NULL) {
-				return(0);
-			}
-			
-		}
-		if(p->curblocknr != blocknr) {
-//			fprintf(stderr, "Read block %d into cache.\n", blocknr);
-			if(p->curblockdirty == px_true) {
-				pxs->seek(p, pxs, pxh->px_headersize + ((p->curblocknr-1)*blocksize), SEEK_SET);
-				if(pxh->px_encryption != 0) {
-	//				fprintf(stderr, "Encrypting block %d\n", p->curblocknr);
-					px_encrypt_db_block(p->curblock, p->curblock, pxh->px_encryption, blocksize, p->curblocknr);
-				}
-				pxs->write(p, pxs, blocksize, p->curblock);
-			}
-			memset(p->curblock, 0, blocksize);
-			pxs->seek(p, pxs, pxh->px_headersize + ((blocknr-1)*blocksize), SEEK_SET);
-			pxs->read(p, pxs, blocksize, p->curblock);
-			p->curblocknr = blocknr;
-			if(pxh->px_encryption != 0) {
-//				fprintf(stderr, "Decrypting block %d\n", blocknr);
-				px_decrypt_db_block(p->curblock, p->curblock, pxh->px_encryption, blocksize, blocknr);
-			}
-		} else {
-//			fprintf(stderr, "block %d already in cache.\n", blocknr);
+		if(NULL == (block = px_get_block(p, blocknr))) {
+			return(0);
 		}
-		memcpy(buffer, p->curblock+blockpos, len);
+		memcpy(buffer, block+blockpos, len);
 		pxs->seek(p, pxs, curpos + (long)len, SEEK_SET);
 		ret = len;
 	} else {
@@ -207,7 +582,7 @@ ssize_t px_write(pxdoc_t *p, pxstream_t *dummy, size_t len, void *buffer) {
 			pxs->seek(p, pxs, pxh->px_headersize + ((blocknr-1)*blocksize), SEEK_SET);
 			pxs->read(p, pxs, blocksize, p->curblock);
 			if(pxh->px_encryption != 0) {
-				px_decrypt_db_block(p->curblock, p->curblock, pxh->px_encryption, blocksize, blocknr);
+				px_decrypt_db_block_doc(p, p->curblock, p->curblock, blocksize, blocknr);
 			}
 		} else {
 //			fprintf(stderr, "block %d already in cache.\n", blocknr);
@@ -251,14 +626,137 @@ int px_flush(pxdoc_t *p, pxstream_t *dummy) {
 /* }}} */
 
 /* Generic file access functions for .mb */
-/* px_mb_read() {{{
+#define BLOCKSIZEEXP 8 /* Each encrypted block has 2^BLOCKSIZEEXP bytes */
+#define MBCACHEBLOCKSIZE 4096 /* Size of the blocks in the cache of px_mb_read() */
+
+/* px_mb_cache_resize() {{{
+ *
+ * Sets the number of blocks kept in the block cache of a blob file.
+ * The cache is emptied. A size of 0 disables the cache.
+ */
+int px_mb_cache_resize(pxblob_t *p, int size) {
+	pxdoc_t *pxdoc = p->pxdoc;
+	pxblockcache_t *cache = NULL;
+	int i;
+
+	if(size < 0)
+		return -1;
+	if(size > 0) {
+		if(NULL == (cache = pxdoc->malloc(pxdoc, size*sizeof(pxblockcache_t), _("Allocate memory for block cache of blob file.")))) {
+			px_error(pxdoc, PX_MemoryError, _("Could not allocate memory for block cache of blob file."));
+			return -1;
+		}
+		for(i=0; i<size; i++) {
+			cache[i].start = -1;
+			cache[i].size = 0;
+			cache[i].data = NULL;
+			cache[i].lastused = 0;
+		}
+	}
+	px_mb_cache_free(p);
+	p->blockcache = cache;
+	p->blockcachelen = size;
+	return 0;
+}
+/* }}} */
+
+/* px_mb_cache_free() {{{
+ *
+ * Frees all blocks of the block cache of a blob file.
+ */
+void px_mb_cache_free(pxblob_t *p) {
+	pxdoc_t *pxdoc = p->pxdoc;
+	int i;
+
+	if(p->blockcache == NULL)
+		return;
+	for(i=0; i<p->blockcachelen; i++) {
+		if(p->blockcache[i].data)
+			pxdoc->free(pxdoc, p->blockcache[i].data);
+	}
+	pxdoc->free(pxdoc, p->blockcache);
+	p->blockcache = NULL;
+	p->blockcachelen = 0;
+}
+/* }}} */
+
+/* px_mb_cache_invalidate() {{{
+ *
+ * Marks all blocks in the cache as unused, e.g. after the file was
+ * modified. The memory of the blocks is kept for reuse.
+ */
+static void px_mb_cache_invalidate(pxblob_t *p) {
+	int i;
+
+	for(i=0; i<p->blockcachelen; i++)
+		p->blockcache[i].start = -1;
+}
+/* }}} */
+
+/* px_mb_cache_get() {{{
+ *
+ * Returns the cache entry of the block starting at blockoffset. If the
+ * block is not in the cache, the least recently used entry is replaced
+ * by the block read from the file and decrypted if needed.
+ * Returns NULL if the block could not be read.
+ */
+static pxblockcache_t *px_mb_cache_get(pxblob_t *p, long blockoffset) {
+	pxdoc_t *pxdoc = p->pxdoc;
+	pxstream_t *pxs = p->mb_stream;
+	pxblockcache_t *entry = &p->blockcache[0];
+	ssize_t ret;
+	int i;
+
+	for(i=0; i<p->blockcachelen; i++) {
+		pxblockcache_t *e = &p->blockcache[i];
+		if(e->start == blockoffset) {
+			e->lastused = ++p->blockcacheclock;
+			p->blockcachehits++;
+			return e;
+		}
+		/* Unused entries have a start of -1 and are taken first */
+		if(entry->start != -1 && (e->start == -1 || e->lastused < entry->lastused))
+			entry = e;
+	}
+	p->blockcachemisses++;
+
+	if(entry->data == NULL) {
+		if(NULL == (entry->data = pxdoc->malloc(pxdoc, MBCACHEBLOCKSIZE, _("Allocate memory for block of blob file.")))) {
+			return NULL;
+		}
+	}
+	entry->start = -1;
+	if(pxs->seek(pxdoc, pxs, blockoffset, SEEK_SET) < 0) {
+		return NULL;
+	}
+	ret = pxs->read(pxdoc, pxs, MBCACHEBLOCKSIZE, entry->data);
+	if(ret <= 0) {
+		return NULL;
+	}
+	if(pxdoc->px_head->px_encryption != 0) {
+		/* Only complete 2^BLOCKSIZEEXP bytes blocks can be decrypted */
+		ret = (ret >> BLOCKSIZEEXP) << BLOCKSIZEEXP;
+		px_decrypt_mb_block_doc(pxdoc, entry->data, entry->data, (unsigned long) ret);
+		if(pxdoc->px_stats)
+			pxdoc->px_stats->bytesdecrypted += ret;
+	}
+	entry->start = blockoffset;
+	entry->size = (size_t) ret;
+	entry->lastused = ++p->blockcacheclock;
+	return entry;
+}
+/* }}} */
+
+/* px_mb_read_data() {{{
  *
  * Generic read function doing decryption if needed.
  * It calls the read function from px_stream_t to actually get the
  * file data.
+ * Reads within a single 4kB block are served from the block cache,
+ * which is needed most for the many small reads of blobs in
+ * suballocated blocks.
  */
-#define BLOCKSIZEEXP 8 /* Each encrypted block has 2^BLOCKSIZEEXP bytes */
-ssize_t px_mb_read(pxblob_t *p, pxstream_t *dummy, size_t len, void *buffer) {
+static ssize_t px_mb_read_data(pxblob_t *p, pxstream_t *dummy, size_t len, void *buffer) {
 	pxdoc_t *pxdoc;
 	pxhead_t *pxh;
 	pxstream_t *pxs;
@@ -271,7 +769,7 @@ ssize_t px_mb_read(pxblob_t *p, pxstream_t *dummy, size_t len, void *buffer) {
 	pxh = pxdoc->px_head;
 	pxs = p->mb_stream;
 
-	if (pxh->px_encryption == 0)
+	if (p->blockcachelen <= 0 && pxh->px_encryption == 0)
 		return pxs->read(pxdoc, pxs, len, buffer);
 
 	pos = pxs->tell(pxdoc, pxs);
@@ -279,6 +777,29 @@ ssize_t px_mb_read(pxblob_t *p, pxstream_t *dummy, size_t len, void *buffer) {
 		return pos;
 	}
 
+	if (p->blockcachelen > 0 && (pos % MBCACHEBLOCKSIZE) + len <= MBCACHEBLOCKSIZE) {
+		pxblockcache_t *entry;
+		long cacheoffset = pos - (pos % MBCACHEBLOCKSIZE);
+
+		if (NULL == (entry = px_mb_cache_get(p, cacheoffset))) {
+			return -1;
+		}
+		/* The file may end before the data */
+		if ((size_t) (pos - cacheoffset) + len > entry->size) {
+			len = (size_t) (pos - cacheoffset) < entry->size ? entry->size - (size_t) (pos - cacheoffset) : 0;
+		}
+		memcpy(buffer, entry->data + (pos - cacheoffset), len);
+		ret = pxs->seek(pxdoc, pxs, pos + (long)len, SEEK_SET);
+		if (ret < 0) {
+			return ret;
+		}
+		return len;
+	}
+
+	/* Reads across blocks are not cached */
+	if (pxh->px_encryption == 0)
+		return pxs->read(pxdoc, pxs, len, buffer);
+
 	/* pos can be in the middle of a 2^BLOCKSIZEEXP bytes block.
 	 * Make sure we start reading at the beginning of the block.
 	 */
@@ -306,37 +827,21 @@ ssize_t px_mb_read(pxblob_t *p, pxstream_t *dummy, size_t len, void *buffer) {
 		return ret;
 	}
 
-	if(NULL == p->blockcache.data) {
-		p->blockcache.data = (unsigned char *) malloc(blockslen);
-	} else {
-		if(blockoffset == p->blockcache.start && blockslen <= p->blockcache.size) {
-//			fprintf(stderr, "Reading block at position 0x%X from cache.\n", blockoffset);
-			memcpy(buffer, p->blockcache.data + (pos - blockoffset), len);
-			ret = pxs->seek(pxdoc, pxs, pos + (long)len, SEEK_SET);
-			if (ret < 0) {
-				return ret;
-			}
-			return len;
-		}
-		p->blockcache.data = (unsigned char *) realloc(p->blockcache.data, blockslen);
-	}
-	if (p->blockcache.data == NULL) {
+	if (NULL == (tmpbuf = pxdoc->malloc(pxdoc, blockslen, _("Allocate memory for blob data.")))) {
 		return -ENOMEM;
 	}
 //	fprintf(stderr, "Reading block at position 0x%X from file.\n", blockoffset);
-	tmpbuf = p->blockcache.data;
 
 	ret = (int)pxs->read(pxdoc, pxs, blockslen, tmpbuf);
 	if (ret <= 0) {
-		free(tmpbuf);
-		p->blockcache.data = NULL;
+		pxdoc->free(pxdoc, tmpbuf);
 		return ret;
 	}
-	px_decrypt_mb_block(tmpbuf, tmpbuf, pxh->px_encryption, blockslen);
+	px_decrypt_mb_block_doc(pxdoc, tmpbuf, tmpbuf, blockslen);
+	if(pxdoc->px_stats)
+		pxdoc->px_stats->bytesdecrypted += blockslen;
 	memcpy(buffer, tmpbuf + (pos - blockoffset), len);
-	p->blockcache.start = blockoffset;
-	p->blockcache.size = blockslen;
-//	free(tmpbuf);
+	pxdoc->free(pxdoc, tmpbuf);
 
 	ret = pxs->seek(pxdoc, pxs, pos + (long)len, SEEK_SET);
 	if (ret < 0) {
@@ -348,9 +853,33 @@ ssize_t px_mb_read(pxblob_t *p, pxstream_t *dummy, size_t len, void *buffer) {
 }
 /* }}} */
 
+/* px_mb_read() {{{
+ *
+ * Reads from the blob file with px_mb_read_data() and counts the read
+ * if the statistics of the document are enabled.
+ */
+ssize_t px_mb_read(pxblob_t *p, pxstream_t *dummy, size_t len, void *buffer) {
+	pxstats_t *stats = p->pxdoc->px_stats;
+	double start;
+	ssize_t ret;
+
+	if(stats == NULL)
+		return px_mb_read_data(p, dummy, len, buffer);
+	start = px_time_ns();
+	ret = px_mb_read_data(p, dummy, len, buffer);
+	stats->nsblob += px_time_ns() - start;
+	stats->mbreads++;
+	if(ret > 0)
+		stats->mbbytesread += ret;
+	return ret;
+}
+/* }}} */
+
 /* px_mb_seek() {{{
  */
 int px_mb_seek(pxblob_t *p, pxstream_t *dummy, long offset, int whence) {
+	if(p->pxdoc->px_stats)
+		p->pxdoc->px_stats->mbseeks++;
 	return(p->mb_stream->seek(p->pxdoc, p->mb_stream, offset, whence));
 }
 /* }}} */
@@ -365,6 +894,7 @@ long px_mb_tell(pxblob_t *p, pxstream_t *dummy) {
 /* px_mb_write() {{{
  */
 ssize_t px_mb_write(pxblob_t *p, pxstream_t *dummy, size_t len, void *buffer) {
+	px_mb_cache_invalidate(p);
 	return(p->mb_stream->write(p->pxdoc, p->mb_stream, len, buffer));
 }
 /* }}} */
@@ -398,6 +928,62 @@ ssize_t px_fwrite(pxdoc_t *p, pxstream_t *stream, size_t len, void *buffer) {
 }
 /* }}} */
 
+/* memory mapped file */
+/* px_mmread() {{{
+ */
+ssize_t px_mmread(pxdoc_t *p, pxstream_t *stream, size_t len, void *buffer) {
+	long avail = stream->s.mm.size - stream->s.mm.pos;
+	if(avail <= 0)
+		return(0);
+	if((long) len > avail)
+		len = (size_t) avail;
+	memcpy(buffer, stream->s.mm.data + stream->s.mm.pos, len);
+	stream->s.mm.pos += (long) len;
+	return((ssize_t) len);
+}
+/* }}} */
+
+/* px_mmseek() {{{
+ */
+int px_mmseek(pxdoc_t *p, pxstream_t *stream, long offset, int whence) {
+	long pos;
+	switch(whence) {
+		case SEEK_SET:
+			pos = offset;
+			break;
+		case SEEK_CUR:
+			pos = stream->s.mm.pos + offset;
+			break;
+		case SEEK_END:
+			pos = stream->s.mm.size + offset;
+			break;
+		default:
+			return(-1);
+	}
+	/* Like fseek() allow positions behind the end of the file. */
+	if(pos < 0)
+		return(-1);
+	stream->s.mm.pos = pos;
+	return(0);
+}
+/* }}} */
+
+/* px_mmtell() {{{
+ */
+long px_mmtell(pxdoc_t *p, pxstream_t *stream) {
+	return(stream->s.mm.pos);
+}
+/* }}} */
+
+/* px_mmwrite() {{{
+ * Memory mapped files are read only.
+ */
+ssize_t px_mmwrite(pxdoc_t *p, pxstream_t *stream, size_t len, void *buffer) {
+	px_error(p, PX_RuntimeError, _("Cannot write into a memory mapped file."));
+	return(-1);
+}
+/* }}} */
+
 /* gsf */
 #if HAVE_GSF
 /* px_gsfread() {{{
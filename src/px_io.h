@@ -1,10 +1,20 @@
 #ifndef __PX_IO_H__
 #define __PX_IO_H__
+double px_time_ns(void);
+void px_stats_add(pxstats_t *to, const pxstats_t *from);
+
 pxstream_t *px_stream_new(pxdoc_t *pxdoc);
 #if HAVE_GSF
 pxstream_t *px_stream_new_gsf(pxdoc_t *pxdoc, int mode, int close, GsfInput *gsf);
 #endif
 pxstream_t *px_stream_new_file(pxdoc_t *pxdoc, int mode, int close, FILE *fp);
+pxstream_t *px_stream_new_mmap(pxdoc_t *pxdoc, int mode, int closestream, const char *filename);
+void px_stream_unmap(pxdoc_t *pxdoc, unsigned char *data, long size);
+void px_stream_close(pxdoc_t *pxdoc, pxstream_t *pxs);
+
+unsigned char *px_get_block(pxdoc_t *p, long blocknr);
+unsigned char *px_read_block_r(pxdoc_t *p, FILE *fp, long blocknr, unsigned char *buffer, pxstats_t *stats);
+void px_readahead(pxdoc_t *p, long blocknr, int numblocks);
 
 ssize_t px_read(pxdoc_t *p, pxstream_t *dummy, size_t len, void *buffer);
 int px_seek(pxdoc_t *p, pxstream_t *dummy, long offset, int whence);
@@ -16,12 +26,19 @@ ssize_t px_mb_read(pxblob_t *p, pxstream_t *dummy, size_t len, void *buffer);
 int px_mb_seek(pxblob_t *p, pxstream_t *dummy, long offset, int whence);
 long px_mb_tell(pxblob_t *p, pxstream_t *dummy);
 ssize_t px_mb_write(pxblob_t *p, pxstream_t *dummy, size_t len, void *buffer);
+int px_mb_cache_resize(pxblob_t *p, int size);
+void px_mb_cache_free(pxblob_t *p);
 
 ssize_t px_fread(pxdoc_t *p, pxstream_t *stream, size_t len, void *buffer);
 int px_fseek(pxdoc_t *p, pxstream_t *stream, long offset, int whence);
 long px_ftell(pxdoc_t *p, pxstream_t *stream);
 ssize_t px_fwrite(pxdoc_t *p, pxstream_t *stream, size_t len, void *buffer);
 
+ssize_t px_mmread(pxdoc_t *p, pxstream_t *stream, size_t len, void *buffer);
+int px_mmseek(pxdoc_t *p, pxstream_t *stream, long offset, int whence);
+long px_mmtell(pxdoc_t *p, pxstream_t *stream);
+ssize_t px_mmwrite(pxdoc_t *p, pxstream_t *stream, size_t len, void *buffer);
+
 #ifdef HAVE_GSF
 ssize_t px_gsfread(pxdoc_t *p, pxstream_t *stream, size_t len, void *buffer);
 int px_gsfseek(pxdoc_t *p, pxstream_t *stream, long offset, int whence);
@@ -7,6 +7,7 @@
 #include "px_intern.h"
 #include "paradox-gsf.h"
 #include "px_error.h"
+#include "px_memory.h"
 
 void *_px_malloc(pxdoc_t *p, size_t len, const char *caller) {
 	return((void *) malloc(len));
@@ -21,6 +22,160 @@ void _px_free(pxdoc_t *p, void *ptr) {
 	ptr = NULL;
 }
 
+/* Arena of short lived allocations {{{
+ *
+ * The arena hands out memory from chunks of ARENACHUNKSIZE bytes by
+ * moving a pointer forward. Chunks are never given back until the arena
+ * is deleted; a reset just starts again at the first chunk, which takes
+ * constant time however many allocations were made. Values too large
+ * for a chunk are allocated one by one and kept in a list, which is
+ * freed by the reset. Memory of a scope is never passed to free().
+ */
+#define ARENACHUNKSIZE 0x10000
+#define ARENAMAXALLOC (ARENACHUNKSIZE/4)
+#define ARENAALIGN 16
+
+struct px_arenachunk {
+	struct px_arenachunk *next;
+	size_t used;               /* bytes of data already handed out */
+	unsigned char *data;       /* ARENACHUNKSIZE bytes behind the header */
+};
+
+struct px_arenalarge {
+	struct px_arenalarge *next;
+};
+
+struct px_arena {
+	struct px_arenachunk *first;
+	struct px_arenachunk *current;
+	struct px_arenalarge *large; /* large values of the current scope */
+	int scope;                 /* set if allocations are taken from the arena */
+};
+
+#define ARENAHEADER(type) ((sizeof(type) + ARENAALIGN - 1) & ~((size_t) ARENAALIGN - 1))
+
+/* px_arena_free_large() {{{
+ * Frees the large values of the current scope.
+ */
+static void px_arena_free_large(pxdoc_t *p, pxarena_t *arena) {
+	struct px_arenalarge *large, *next;
+
+	for(large=arena->large; large; large=next) {
+		next = large->next;
+		p->free(p, large);
+	}
+	arena->large = NULL;
+}
+/* }}} */
+/* }}} */
+
+/* px_arena_new() {{{
+ * Creates an empty arena, allocated with the memory functions of p.
+ */
+pxarena_t *px_arena_new(pxdoc_t *p) {
+	pxarena_t *arena;
+
+	if(NULL == (arena = p->malloc(p, sizeof(pxarena_t), _("Allocate memory for arena.")))) {
+		px_error(p, PX_MemoryError, _("Could not allocate memory for arena."));
+		return(NULL);
+	}
+	memset(arena, 0, sizeof(pxarena_t));
+	return(arena);
+}
+/* }}} */
+
+/* px_arena_delete() {{{
+ * Frees an arena with all its chunks.
+ */
+void px_arena_delete(pxdoc_t *p, pxarena_t *arena) {
+	struct px_arenachunk *chunk, *next;
+
+	px_arena_free_large(p, arena);
+	for(chunk=arena->first; chunk; chunk=next) {
+		next = chunk->next;
+		p->free(p, chunk);
+	}
+	p->free(p, arena);
+}
+/* }}} */
+
+/* px_arena_set_scope() {{{
+ * Starts or ends a scope of the arena. Both release all memory taken
+ * from the arena so far. Within a scope px_arena_malloc() serves from
+ * the arena, otherwise from p->malloc().
+ */
+void px_arena_set_scope(pxdoc_t *p, pxarena_t *arena, int scope) {
+	px_arena_free_large(p, arena);
+	arena->current = arena->first;
+	if(arena->current)
+		arena->current->used = 0;
+	arena->scope = scope;
+}
+/* }}} */
+
+/* px_arena_free() {{{
+ * Frees memory of px_arena_malloc(). Within a scope of the arena this
+ * does nothing, the memory is released with the scope.
+ */
+void px_arena_free(pxdoc_t *p, void *ptr) {
+	if(p->px_arena != NULL && p->px_arena->scope)
+		return;
+	p->free(p, ptr);
+}
+/* }}} */
+
+/* px_arena_malloc() {{{
+ * Allocates memory for a value which is only needed until the end of
+ * the current scope of the arena of p, see PX_arena_begin(). It must
+ * be freed with px_arena_free(), never with p->free().
+ * Without an open scope p->malloc() is used.
+ */
+void *px_arena_malloc(pxdoc_t *p, size_t len, const char *caller) {
+	pxarena_t *arena = p->px_arena;
+	struct px_arenachunk *chunk;
+	void *mem;
+
+	if(arena == NULL || !arena->scope)
+		return(p->malloc(p, len, caller));
+	if(len > ARENAMAXALLOC) {
+		struct px_arenalarge *large;
+		if(NULL == (large = p->malloc(p, ARENAHEADER(struct px_arenalarge) + len, caller)))
+			return(NULL);
+		large->next = arena->large;
+		arena->large = large;
+		return((unsigned char *) large + ARENAHEADER(struct px_arenalarge));
+	}
+
+	len = (len + ARENAALIGN - 1) & ~((size_t) ARENAALIGN - 1);
+	chunk = arena->current;
+	if(chunk == NULL || chunk->used + len > ARENACHUNKSIZE) {
+		/* Go on with the next chunk, which is allocated the first time
+		 * the arena grows that large.
+		 */
+		if(chunk != NULL && chunk->next != NULL) {
+			chunk = chunk->next;
+		} else {
+			struct px_arenachunk *newchunk;
+			size_t hsize = ARENAHEADER(struct px_arenachunk);
+			if(NULL == (newchunk = p->malloc(p, hsize + ARENACHUNKSIZE, _("Allocate memory for chunk of arena."))))
+				return(NULL);
+			newchunk->next = NULL;
+			newchunk->data = (unsigned char *) newchunk + hsize;
+			if(chunk == NULL)
+				arena->first = newchunk;
+			else
+				chunk->next = newchunk;
+			chunk = newchunk;
+		}
+		chunk->used = 0;
+		arena->current = chunk;
+	}
+	mem = chunk->data + chunk->used;
+	chunk->used += len;
+	return(mem);
+}
+/* }}} */
+
 size_t px_strlen(const char *str) {
 	return(strlen(str));
 }
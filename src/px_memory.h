@@ -3,6 +3,11 @@
 void *_px_malloc(pxdoc_t *p, size_t len, const char *caller);
 void *_px_realloc(pxdoc_t *p, void *mem, size_t len, const char *caller);
 void _px_free(pxdoc_t *p, void *ptr);
+pxarena_t *px_arena_new(pxdoc_t *p);
+void px_arena_delete(pxdoc_t *p, pxarena_t *arena);
+void px_arena_set_scope(pxdoc_t *p, pxarena_t *arena, int scope);
+void px_arena_free(pxdoc_t *p, void *ptr);
+void *px_arena_malloc(pxdoc_t *p, size_t len, const char *caller);
 size_t px_strlen(const char *str);
 char *px_strdup(pxdoc_t *p, const char *str);
 #endif